@@ -0,0 +1,39 @@
+#
+# Standalone benchmarks of the library and of playlists, not built with the player.
+# Build it after the player: qmake src/benchmark/benchmark.pro && make, in a shadow build with the same layout.
+#
+QT += multimedia sql widgets
+
+TEMPLATE = app
+
+SOURCES += main.cpp
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+CONFIG(debug, debug|release) {
+    win32: LIBS += -L$$OUT_PWD/../core/debug/ -lmiam-core -L$$OUT_PWD/../library/debug/ -lmiam-library \
+        -L$$OUT_PWD/../tabplaylists/debug/ -lmiam-tabplaylists
+    OBJECTS_DIR = debug/.obj
+    MOC_DIR = debug/.moc
+}
+
+CONFIG(release, debug|release) {
+    win32: LIBS += -L$$OUT_PWD/../core/release/ -lmiam-core -L$$OUT_PWD/../library/release/ -lmiam-library \
+        -L$$OUT_PWD/../tabplaylists/release/ -lmiam-tabplaylists
+    OBJECTS_DIR = release/.obj
+    MOC_DIR = release/.moc
+}
+
+TARGET = miam-benchmark
+
+unix {
+    LIBS += -L$$OUT_PWD/../core/ -lmiam-core -L$$OUT_PWD/../library/ -lmiam-library -L$$OUT_PWD/../tabplaylists/ -lmiam-tabplaylists
+}
+macx {
+    QMAKE_MACOSX_DEPLOYMENT_TARGET = 10.9
+}
+
+3rdpartyDir  = $$PWD/../core/3rdparty
+INCLUDEPATH += $$3rdpartyDir
+INCLUDEPATH += $$PWD/../core/ $$PWD/../library/ $$PWD/../tabplaylists/
+DEPENDPATH += $$PWD/../core $$PWD/../library/ $$PWD/../tabplaylists/
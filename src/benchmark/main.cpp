@@ -0,0 +1,211 @@
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMap>
+#include <QStandardPaths>
+#include <QTextStream>
+
+#include <filehelper.h>
+#include <model/batchwriter.h>
+#include <model/sqldatabase.h>
+#include <model/trackdao.h>
+#include <playlistmodel.h>
+
+#include <functional>
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+namespace {
+
+QTextStream out(stdout);
+
+/** Resident memory of this process in bytes, or -1 if it can't be read on this platform. */
+qint64 residentMemory()
+{
+#ifdef Q_OS_LINUX
+	QFile statm("/proc/self/statm");
+	if (statm.open(QIODevice::ReadOnly)) {
+		QList<QByteArray> fields = statm.readAll().split(' ');
+		if (fields.size() > 1) {
+			return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+		}
+	}
+#endif
+	return -1;
+}
+
+/** Inserts synthetic tracks in table "cache" with one BatchWriter, like the writer of a scan: 10 tracks per album, 10 albums per artist. */
+void benchmarkInsert(int rowCount)
+{
+	if (rowCount <= 0) {
+		return;
+	}
+	SqlDatabase db;
+	db.reset();
+
+	CacheRow row;
+	row.length = "240";
+	row.disc = 1;
+	row.year = "2000";
+
+	QElapsedTimer timer;
+	timer.start();
+	{
+		BatchWriter writer(&db);
+		for (int i = 0; i < rowCount; i++) {
+			row.artist = QString("Artist %1").arg(i / 100);
+			row.artistAlbum = row.artist;
+			row.artistNormalized = SqlDatabase::normalizeField(row.artist);
+			row.album = QString("Album %1").arg(i / 10);
+			row.albumNormalized = SqlDatabase::normalizeField(row.album);
+			row.trackNumber = i % 10 + 1;
+			row.title = QString("Track %1").arg(i);
+			row.uri = QString("/benchmark/%1/%2/%3.mp3").arg(row.artist, row.album, row.title);
+			row.stamp.size = 4 * 1024 * 1024;
+			row.stamp.lastModified = i;
+			row.stamp.inode = static_cast<quint64>(i);
+			writer.saveFileRef(row);
+		}
+		writer.flush();
+	}
+	qint64 elapsed = qMax(Q_INT64_C(1), timer.elapsed());
+	out << "insert: " << rowCount << " rows in " << elapsed << " ms, " << rowCount * 1000 / elapsed << " rows/s" << endl;
+
+	db.reset();
+}
+
+/** Fills a playlist with tracks which aren't read from files, and measures the resident memory it needs. */
+void benchmarkPlaylist(int rowCount)
+{
+	if (rowCount <= 0) {
+		return;
+	}
+	PlaylistModel *model = new PlaylistModel(nullptr);
+	qint64 before = residentMemory();
+
+	// Tracks are inserted by blocks, so that the list of tracks given to the model isn't measured
+	const int blockSize = 10000;
+	for (int i = 0; i < rowCount; i += blockSize) {
+		QList<TrackDAO> tracks;
+		for (int j = i; j < qMin(rowCount, i + blockSize); j++) {
+			TrackDAO track;
+			track.setUri(QString("/benchmark/Artist %1/Album %2/Track %3.mp3").arg(j / 100).arg(j / 10).arg(j));
+			track.setTitle(QString("Track %1").arg(j));
+			track.setArtist(QString("Artist %1").arg(j / 100));
+			track.setAlbum(QString("Album %1").arg(j / 10));
+			track.setTrackNumber(QString::number(j % 10 + 1));
+			track.setLength("240");
+			track.setYear("2000");
+			tracks.append(track);
+		}
+		model->insertReadTracks(-1, tracks);
+	}
+
+	qint64 after = residentMemory();
+	if (before < 0 || after < 0) {
+		out << "playlist: " << rowCount << " rows, resident memory isn't available on this platform" << endl;
+	} else {
+		out << "playlist: " << rowCount << " rows, " << (after - before) / rowCount << " bytes/row" << endl;
+	}
+	delete model;
+}
+
+/** Reads tags of every audio file in a folder, with readAll() then with one getter per field, grouped by format. */
+void benchmarkTags(const QString &folder)
+{
+	QMap<QString, QStringList> filesBySuffix;
+	QStringList suffixes = FileHelper::suffixes();
+	QDirIterator dirIterator(folder, QDir::Files, QDirIterator::Subdirectories);
+	while (dirIterator.hasNext()) {
+		QString file = dirIterator.next();
+		QString suffix = dirIterator.fileInfo().suffix().toLower();
+		if (suffixes.contains(suffix)) {
+			filesBySuffix[suffix].append(file);
+		}
+	}
+
+	auto readAll = [](const QString &file) {
+		FileHelper fh(file, FileHelper::OM_TagsAndDuration);
+		if (fh.isValid()) {
+			fh.readAll();
+		}
+	};
+
+	// Same fields as SqlDatabase::readFileRef before readAll() was added
+	auto readFields = [](const QString &file) {
+		FileHelper fh(file, FileHelper::OM_TagsAndDuration);
+		if (fh.isValid()) {
+			fh.trackNumber();
+			fh.title();
+			fh.artist();
+			fh.artistAlbum();
+			fh.album();
+			fh.year();
+			fh.length();
+			fh.discNumber();
+			fh.hasCover();
+			fh.rating();
+		}
+	};
+
+	auto measure = [](const QStringList &files, const std::function<void(const QString&)> &read) -> double {
+		QElapsedTimer timer;
+		timer.start();
+		for (const QString &file : files) {
+			read(file);
+		}
+		return static_cast<double>(timer.nsecsElapsed()) / 1000.0 / files.size();
+	};
+
+	for (auto it = filesBySuffix.cbegin(); it != filesBySuffix.cend(); ++it) {
+		// Files are read once before measuring, so that both methods find them in the cache of the filesystem
+		measure(it.value(), readAll);
+		double allAtOnce = measure(it.value(), readAll);
+		double fieldByField = measure(it.value(), readFields);
+		out << "tags: " << it.key() << ", " << it.value().size() << " files, readAll " << allAtOnce << " us/file, getters "
+			<< fieldByField << " us/file" << endl;
+	}
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	QApplication app(argc, argv);
+	app.setOrganizationName("MmeMiamMiam");
+	app.setApplicationName("MiamPlayer");
+
+	// The library and the settings of the player aren't touched: databases and settings are created in test locations
+	QStandardPaths::setTestModeEnabled(true);
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Benchmarks of Miam-Player");
+	parser.addHelpOption();
+	QCommandLineOption insertOption("insert", "Inserts <rows> synthetic tracks in the library.", "rows");
+	QCommandLineOption playlistOption("playlist", "Measures memory of playlists of <rows> tracks, comma separated.", "rows");
+	QCommandLineOption tagsOption("tags", "Reads tags of audio files below <folder>, grouped by format.", "folder");
+	parser.addOption(insertOption);
+	parser.addOption(playlistOption);
+	parser.addOption(tagsOption);
+	parser.process(app);
+
+	bool hasOption = parser.isSet(insertOption) || parser.isSet(playlistOption) || parser.isSet(tagsOption);
+	if (parser.isSet(insertOption) || !hasOption) {
+		benchmarkInsert(parser.isSet(insertOption) ? parser.value(insertOption).toInt() : 1000000);
+	}
+	if (parser.isSet(playlistOption) || !hasOption) {
+		QString sizes = parser.isSet(playlistOption) ? parser.value(playlistOption) : QString("10000,100000,1000000");
+		// Memory freed by a playlist can be reused by the next one: sizes are better measured from the smallest
+		for (QString size : sizes.split(',', QString::SkipEmptyParts)) {
+			benchmarkPlaylist(size.toInt());
+		}
+	}
+	if (parser.isSet(tagsOption)) {
+		benchmarkTags(parser.value(tagsOption));
+	}
+	return 0;
+}
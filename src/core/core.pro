@@ -58,6 +58,7 @@ SOURCES += library/jumptowidget.cpp \
     mediabuttons/playbackmodebutton.cpp \
     mediabuttons/playbutton.cpp \
     mediabuttons/stopbutton.cpp \
+    model/batchwriter.cpp \
     model/genericdao.cpp \
     model/playlistdao.cpp \
     model/selectedtracksmodel.cpp \
@@ -71,18 +72,26 @@ SOURCES += library/jumptowidget.cpp \
     widgets/timelabel.cpp \
     widgets/volumeslider.cpp \
     cover.cpp \
+    covercache.cpp \
+    directorywalker.cpp \
     filehelper.cpp \
     flowlayout.cpp \
+    librarywatcher.cpp \
+    mappedfilestream.cpp \
     mediaplayer.cpp \
     mediaplaylist.cpp \
     miamsortfilterproxymodel.cpp \
     musicsearchengine.cpp \
+    playlistchecksum.cpp \
     plugininfo.cpp \
     quickstartsearchengine.cpp \
+    scanpipeline.cpp \
     scrollbar.cpp \
     settings.cpp \
     settingsprivate.cpp \
+    settingssnapshot.cpp \
     starrating.cpp \
+    thumbnailstore.cpp \
     treeview.cpp
 
 HEADERS += interfaces/basicplugin.h \
@@ -94,6 +103,7 @@ HEADERS += interfaces/basicplugin.h \
     mediabuttons/playbackmodebutton.h \
     mediabuttons/playbutton.h \
     mediabuttons/stopbutton.h \
+    model/batchwriter.h \
     model/genericdao.h \
     model/playlistdao.h \
     model/selectedtracksmodel.h \
@@ -111,21 +121,29 @@ HEADERS += interfaces/basicplugin.h \
     abstractsearchdialog.h \
     abstractview.h \
     cover.h \
+    covercache.h \
+    directorywalker.h \
     filehelper.h \
     flowlayout.h \
     imediaplayer.h \
+    librarywatcher.h \
+    mappedfilestream.h \
     mediaplayer.h \
     mediaplaylist.h \
     miamcore_global.h \
     miamsortfilterproxymodel.h \
     musicsearchengine.h \
+    playlistchecksum.h \
     plugininfo.h \
     quickstartsearchengine.h \
+    scanpipeline.h \
     scrollbar.h \
     searchbar.h \
     settings.h \
     settingsprivate.h \
+    settingssnapshot.h \
     starrating.h \
+    thumbnailstore.h \
     treeview.h
 
 RESOURCES += core.qrc
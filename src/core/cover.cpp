@@ -7,19 +7,44 @@
 #include <QImageReader>
 #include <QHash>
 
+#include <taglib/tbytevector.h>
+
+namespace {
+
+/** Like "JPG" (for QClasses), from "image/jpeg" (for TagLib). */
+QString formatFromMimeType(const QString &mimeType)
+{
+	if (mimeType == "image/png") {
+		return "PNG";
+	} else if (mimeType == "image/bmp") {
+		return "BMP";
+	} else if (mimeType == "image/gif") {
+		return "GIF";
+	} else {
+		// default format is assumed to be jpg
+		return "JPG";
+	}
+}
+
+}
+
 Cover::Cover(const QByteArray &byteArray, const QString &mimeType)
 	: _hasChanged(false)
 {
 	_data = byteArray;
 	_mimeType = mimeType;
-	if (mimeType == "image/jpeg") {
-		_format = "JPG";
-	} else if (mimeType == "image/png") {
-		_format = "PNG";
-	} else {
-		// default format is assumed to be jpg
-		_format = "JPG";
-	}
+	_format = formatFromMimeType(mimeType);
+}
+
+/** Constructor used when extracting a picture embedded in a track, without copying it. */
+Cover::Cover(const TagLib::ByteVector &picture, const QString &mimeType)
+	: _picture(new TagLib::ByteVector(picture))
+	, _hasChanged(false)
+{
+	// ByteVector shares its buffer between copies, but non-const data() would detach it
+	_data = QByteArray::fromRawData(_picture->data(), _picture->size());
+	_mimeType = mimeType;
+	_format = formatFromMimeType(mimeType);
 }
 
 /** Constructor used when loading pictures directly from the filesystem (drag & drop or with the context menu). */
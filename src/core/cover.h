@@ -1,13 +1,22 @@
 #ifndef COVER_H
 #define COVER_H
 
+#include <QSharedPointer>
 #include <QString>
 #include <QUrl>
 
 #include "miamcore_global.h"
 
+/// Forward declaration
+namespace TagLib {
+	class ByteVector;
+}
+
 /**
  * \brief		The Cover class
+ * \details		A cover extracted from a track doesn't copy the picture: it keeps a reference on the buffer of TagLib, which
+ *				is shared and reference-counted, and byteArray() is a view over it. Copies of byteArray() are only valid while a
+ *				Cover built on the same picture exists, they must be detached to be kept longer.
  * \author      Matthieu Bachelier
  * \copyright   GNU General Public License v3
  */
@@ -22,11 +31,17 @@ private:
 
 	QByteArray _data;
 
+	/** Picture embedded in a track, which owns the memory of _data. Null if _data owns its memory. */
+	QSharedPointer<const TagLib::ByteVector> _picture;
+
 	bool _hasChanged;
 
 public:
 	Cover(const QByteArray &byteArray, const QString &mimeType = QString());
 
+	/** Constructor used when extracting a picture embedded in a track, without copying it. */
+	Cover(const TagLib::ByteVector &picture, const QString &mimeType);
+
 	/** Constructor used when loading pictures directly from the filesystem (drag & drop or with the context menu). */
 	Cover(const QString &fileName);
 
@@ -0,0 +1,167 @@
+#include "covercache.h"
+
+#include "thumbnailstore.h"
+
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+
+#include <climits>
+
+#include <QtDebug>
+
+namespace {
+
+/** Around 500 thumbnails of 128x128 pixels. */
+const int maxCostInKiB = 32 * 1024;
+
+/** Prefetched covers are decoded after every visible one. */
+const int prefetchPriority = 0;
+
+inline QString thumbnailKey(const QString &coverPath, int size)
+{
+	return QString::number(size) + ':' + coverPath;
+}
+
+/** Reads a thumbnail from the store on disk, or creates it from the picture on disk or inside a track. */
+class CoverLoader : public QRunnable
+{
+private:
+	CoverCache *_cache;
+	QString _coverPath;
+	int _size;
+
+public:
+	CoverLoader(CoverCache *cache, const QString &coverPath, int size)
+		: QRunnable()
+		, _cache(cache)
+		, _coverPath(coverPath)
+		, _size(size)
+	{}
+
+	virtual void run() override
+	{
+		QImage image = ThumbnailStore::thumbnail(_coverPath, _size);
+		QMetaObject::invokeMethod(_cache, "insert", Qt::QueuedConnection,
+								  Q_ARG(QString, _coverPath), Q_ARG(int, _size), Q_ARG(QImage, image));
+	}
+};
+
+}
+
+CoverCache* CoverCache::coverCache = nullptr;
+
+/** Private constructor. */
+CoverCache::CoverCache(QObject *parent)
+	: QObject(parent)
+	, _pool(new QThreadPool(this))
+	, _thumbnails(maxCostInKiB)
+	, _lastPriority(prefetchPriority)
+{
+	// Keep one core for the user interface, reading covers is mostly limited by disks anyway
+	_pool->setMaxThreadCount(qBound(1, QThread::idealThreadCount() - 1, 4));
+}
+
+/** Singleton pattern to share thumbnails between views. */
+CoverCache* CoverCache::instance()
+{
+	if (coverCache == nullptr) {
+		coverCache = new CoverCache;
+	}
+	return coverCache;
+}
+
+CoverCache::~CoverCache()
+{
+	_pool->clear();
+	_pool->waitForDone();
+}
+
+/** Removes every thumbnail, for example when the size of covers has changed. */
+void CoverCache::clear()
+{
+	_pool->clear();
+	_pendingKeys.clear();
+	_thumbnails.clear();
+	_failedPaths.clear();
+}
+
+/** Returns the thumbnail if it's ready, otherwise starts to decode it and returns a null pixmap. */
+QPixmap CoverCache::cover(const QString &coverPath, int size)
+{
+	if (QPixmap *thumbnail = _thumbnails.object(thumbnailKey(coverPath, size))) {
+		return *thumbnail;
+	}
+	if (_lastPriority == INT_MAX) {
+		_lastPriority = prefetchPriority;
+	}
+	this->load(coverPath, size, ++_lastPriority);
+	return QPixmap();
+}
+
+/** Returns true if the picture couldn't be read the last time it was requested. */
+bool CoverCache::hasFailed(const QString &coverPath) const
+{
+	return _failedPaths.contains(coverPath);
+}
+
+/** Decodes a thumbnail which isn't visible yet, with a lower priority than visible ones. */
+void CoverCache::prefetch(const QString &coverPath, int size)
+{
+	if (!_thumbnails.contains(thumbnailKey(coverPath, size))) {
+		this->load(coverPath, size, prefetchPriority);
+	}
+}
+
+/** Removes thumbnails of tracks which were modified or removed, covers will be read again. */
+void CoverCache::removeCovers(const QStringList &coverPaths)
+{
+	if (coverPaths.isEmpty()) {
+		return;
+	}
+	QSet<QString> paths = coverPaths.toSet();
+	for (QString key : _thumbnails.keys()) {
+		if (paths.contains(key.mid(key.indexOf(':') + 1))) {
+			_thumbnails.remove(key);
+		}
+	}
+	for (QString coverPath : coverPaths) {
+		_failedPaths.remove(coverPath);
+	}
+}
+
+/** Removes a path from failed covers, once views have handled it. */
+void CoverCache::forget(const QString &coverPath)
+{
+	_failedPaths.remove(coverPath);
+}
+
+void CoverCache::load(const QString &coverPath, int size, int priority)
+{
+	if (coverPath.isEmpty() || size <= 0 || _failedPaths.contains(coverPath)) {
+		return;
+	}
+	QString key = thumbnailKey(coverPath, size);
+	if (_pendingKeys.contains(key)) {
+		return;
+	}
+	_pendingKeys.insert(key);
+	_pool->start(new CoverLoader(this, coverPath, size), priority);
+}
+
+/** Called in the thread of the cache, a QPixmap can't be created elsewhere. */
+void CoverCache::insert(const QString &coverPath, int size, const QImage &image)
+{
+	QString key = thumbnailKey(coverPath, size);
+	// Cache was cleared while this cover was decoded: it may have been scaled with an old size
+	if (!_pendingKeys.remove(key)) {
+		return;
+	}
+	if (image.isNull()) {
+		_failedPaths.insert(coverPath);
+	} else {
+		QPixmap *thumbnail = new QPixmap(QPixmap::fromImage(image));
+		_thumbnails.insert(key, thumbnail, qMax(1, image.byteCount() / 1024));
+	}
+	emit coverLoaded(coverPath);
+}
@@ -0,0 +1,86 @@
+#ifndef COVERCACHE_H
+#define COVERCACHE_H
+
+#include <QCache>
+#include <QImage>
+#include <QObject>
+#include <QPixmap>
+#include <QSet>
+#include <QStringList>
+
+#include "miamcore_global.h"
+
+/// Forward declaration
+class QThreadPool;
+
+/**
+ * \brief		The CoverCache class provides thumbnails of covers to views without blocking the user interface.
+ * \details		Covers are read and scaled in a thread pool, either from a picture on disk or from a picture embedded in a track.
+ *				Thumbnails are kept on disk by ThumbnailStore, so that a cover is extracted and decoded only once.
+ *				When a thumbnail isn't ready yet, a null pixmap is returned immediately and coverLoaded() is emitted later,
+ *				so that the view can draw a placeholder then repaint the row. Most recent requests are decoded first: rows
+ *				which are still visible win against rows which were scrolled past. Thumbnails are kept in a LRU cache which is
+ *				bounded in memory.
+ * \author      Matthieu Bachelier
+ * \copyright   GNU General Public License v3
+ */
+class MIAMCORE_LIBRARY CoverCache : public QObject
+{
+	Q_OBJECT
+private:
+	static CoverCache *coverCache;
+
+	QThreadPool *_pool;
+
+	/** Key is made of the size and the path of the cover. Cost is in KiB. */
+	QCache<QString, QPixmap> _thumbnails;
+
+	/** Thumbnails which are currently decoded in the pool. */
+	QSet<QString> _pendingKeys;
+
+	/** Paths which couldn't be decoded, views can then remove them from the library. */
+	QSet<QString> _failedPaths;
+
+	/** Gives a higher priority to each new request. */
+	int _lastPriority;
+
+	explicit CoverCache(QObject *parent = nullptr);
+
+public:
+	/** Singleton pattern to share thumbnails between views. */
+	static CoverCache* instance();
+
+	virtual ~CoverCache();
+
+	/** Removes every thumbnail, for example when the size of covers has changed. */
+	void clear();
+
+	/** Returns the thumbnail if it's ready, otherwise starts to decode it and returns a null pixmap. */
+	QPixmap cover(const QString &coverPath, int size);
+
+	/** Returns true if the picture couldn't be read the last time it was requested. */
+	bool hasFailed(const QString &coverPath) const;
+
+	/** Decodes a thumbnail which isn't visible yet, with a lower priority than visible ones. */
+	void prefetch(const QString &coverPath, int size);
+
+	/** Removes a path from failed covers, once views have handled it. */
+	void forget(const QString &coverPath);
+
+public slots:
+	/** Removes thumbnails of tracks which were modified or removed, covers will be read again. */
+	void removeCovers(const QStringList &coverPaths);
+
+private:
+	void load(const QString &coverPath, int size, int priority);
+
+private slots:
+	/** Called in the thread of the cache, a QPixmap can't be created elsewhere. */
+	void insert(const QString &coverPath, int size, const QImage &image);
+
+signals:
+	/** Sent when a thumbnail is ready or when a picture couldn't be read. */
+	void coverLoaded(const QString &coverPath);
+};
+
+#endif // COVERCACHE_H
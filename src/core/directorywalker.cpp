@@ -0,0 +1,94 @@
+#include "directorywalker.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+
+#if defined(Q_OS_UNIX)
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** Reads entries of an opened folder then recursively its subfolders. Takes ownership of dirFd. */
+static int walkFd(int dirFd, const QByteArray &path, const DirectoryWalker::Visitor &visitor)
+{
+	DIR *dir = fdopendir(dirFd);
+	if (dir == nullptr) {
+		::close(dirFd);
+		return 0;
+	}
+
+	int entries = 0;
+	while (struct dirent *entry = readdir(dir)) {
+		const char *name = entry->d_name;
+		if (qstrcmp(name, ".") == 0 || qstrcmp(name, "..") == 0) {
+			continue;
+		}
+		QByteArray childPath = path + '/' + name;
+
+		bool isDir = false;
+		bool isLink = false;
+		struct stat st;
+		switch (entry->d_type) {
+		case DT_DIR:
+			isDir = true;
+			break;
+		case DT_LNK:
+			isLink = true;
+			break;
+		case DT_UNKNOWN:
+			// Some filesystems (old NFS or XFS) don't fill d_type
+			if (fstatat(dirfd(dir), name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+				isDir = S_ISDIR(st.st_mode);
+				isLink = S_ISLNK(st.st_mode);
+			}
+			break;
+		default:
+			break;
+		}
+		if (isLink) {
+			isDir = fstatat(dirfd(dir), name, &st, 0) == 0 && S_ISDIR(st.st_mode);
+		}
+
+		entries++;
+		visitor(QFile::decodeName(childPath), isDir);
+
+		if (isDir && !isLink) {
+			int childFd = openat(dirfd(dir), name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			if (childFd >= 0) {
+				entries += walkFd(childFd, childPath, visitor);
+			}
+		}
+	}
+	// Also closes dirFd
+	closedir(dir);
+	return entries;
+}
+#endif
+
+/** Calls visitor for each entry below root (root itself is not reported). Returns the number of entries. */
+int DirectoryWalker::walk(const QString &root, const Visitor &visitor)
+{
+	QString rootPath = QDir::cleanPath(QDir(root).absolutePath());
+#if defined(Q_OS_UNIX)
+	QByteArray encodedRoot = QFile::encodeName(rootPath);
+	int rootFd = ::open(encodedRoot.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (rootFd < 0) {
+		return 0;
+	}
+	if (encodedRoot.endsWith('/')) {
+		encodedRoot.chop(1);
+	}
+	return walkFd(rootFd, encodedRoot, visitor);
+#else
+	int entries = 0;
+	QDirIterator it(rootPath, QDir::AllEntries | QDir::Hidden | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+	while (it.hasNext()) {
+		it.next();
+		entries++;
+		visitor(it.filePath(), it.fileInfo().isDir());
+	}
+	return entries;
+#endif
+}
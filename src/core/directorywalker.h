@@ -0,0 +1,28 @@
+#ifndef DIRECTORYWALKER_H
+#define DIRECTORYWALKER_H
+
+#include <QString>
+
+#include <functional>
+
+#include "miamcore_global.h"
+
+/**
+ * \brief		The DirectoryWalker class visits every entry below a folder in a single pass.
+ * \details		Entries are reported depth-first, a folder being reported right before its content, like QDirIterator with
+ *				Subdirectories flag. Hidden entries are included and symbolic links to folders are reported but not followed.
+ *				On Unix, the walk uses file descriptors relative to their parent (openat/readdir) and the type returned by
+ *				readdir, so no stat() is needed for most entries.
+ * \author      Matthieu Bachelier
+ * \copyright   GNU General Public License v3
+ */
+class MIAMCORE_LIBRARY DirectoryWalker
+{
+public:
+	typedef std::function<void(const QString &absFilePath, bool isDir)> Visitor;
+
+	/** Calls visitor for each entry below root (root itself is not reported). Returns the number of entries. */
+	static int walk(const QString &root, const Visitor &visitor);
+};
+
+#endif // DIRECTORYWALKER_H
@@ -1,8 +1,10 @@
 #include "filehelper.h"
 #include "cover.h"
+#include "mappedfilestream.h"
 
 #include <algorithm>
 #include <map>
+#include <memory>
 
 #include <QDateTime>
 #include <QDir>
@@ -12,8 +14,11 @@
 #include <taglib/taglib.h>
 #include <taglib/fileref.h>
 #include <taglib/apefile.h>
+#include <taglib/apeitem.h>
 #include <taglib/apetag.h>
 #include <taglib/asffile.h>
+#include <taglib/asfpicture.h>
+#include <taglib/asftag.h>
 #include <taglib/flacfile.h>
 #include <taglib/modfile.h>
 #include <taglib/mpcfile.h>
@@ -22,6 +27,7 @@
 #include <taglib/opusfile.h>
 #include <taglib/vorbisfile.h>
 
+#include <taglib/id3v2framefactory.h>
 #include <taglib/id3v2tag.h>
 #include <taglib/id3v2frame.h>
 
@@ -35,14 +41,244 @@
 #include <taglib/tmap.h>
 #include <taglib/tpropertymap.h>
 #include <taglib/mp4tag.h>
+#include <taglib/mp4coverart.h>
 #include <taglib/mp4item.h>
+#include <taglib/xiphcomment.h>
 
 #include <QtDebug>
 
-FileHelper::FileHelper(const QMediaContent &track)
+namespace {
+
+/** Converts a Popularimeter frame into a smaller range from 1 to 5. */
+int ratingFromPopularimeter(const TagLib::ID3v2::FrameList &l)
+{
+	int r = -1;
+	if (l.isEmpty()) {
+		return r;
+	}
+	if (TagLib::ID3v2::PopularimeterFrame *pf = static_cast<TagLib::ID3v2::PopularimeterFrame*>(l.front())) {
+		switch (pf->rating()) {
+		case 1:
+			r = 1;
+			break;
+		case 64:
+			r = 2;
+			break;
+		case 128:
+			r = 3;
+			break;
+		case 196:
+			r = 4;
+			break;
+		case 255:
+			r = 5;
+			break;
+		}
+	}
+	return r;
+}
+
+QString firstValue(const TagLib::StringList &list)
+{
+	if (list.isEmpty()) {
+		return QString();
+	}
+	return QString(list.front().toCString(true));
+}
+
+QString firstValue(const TagLib::ID3v2::FrameList &l)
+{
+	if (l.isEmpty()) {
+		return QString();
+	}
+	return QString(l.front()->toString().toCString(true));
+}
+
+/** Works for PropertyMap and for fields of a XiphComment, without copying the map nor inserting the key. */
+QString firstValue(const TagLib::Map<TagLib::String, TagLib::StringList> &map, const char *key)
+{
+	auto it = map.find(key);
+	if (it == map.end()) {
+		return QString();
+	}
+	return firstValue(it->second);
+}
+
+/** It's possible to have more than one picture per file! Only sizes from frame headers are checked, pictures aren't touched. */
+bool hasPicture(const TagLib::ID3v2::FrameList &pictureFrames)
+{
+	for (TagLib::ID3v2::FrameList::ConstIterator it = pictureFrames.begin(); it != pictureFrames.end(); it++) {
+		if (*it != nullptr && (*it)->size() > 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/** Front cover if there's one, otherwise the first picture which isn't empty. */
+Cover* coverFromFrames(const TagLib::ID3v2::FrameList &pictureFrames)
+{
+	TagLib::ID3v2::AttachedPictureFrame *picture = nullptr;
+	for (TagLib::ID3v2::FrameList::ConstIterator it = pictureFrames.begin(); it != pictureFrames.end(); it++) {
+		TagLib::ID3v2::AttachedPictureFrame *pictureFrame = dynamic_cast<TagLib::ID3v2::AttachedPictureFrame*>(*it);
+		if (pictureFrame == nullptr || pictureFrame->picture().isEmpty()) {
+			continue;
+		}
+		if (picture == nullptr || pictureFrame->type() == TagLib::ID3v2::AttachedPictureFrame::FrontCover) {
+			picture = pictureFrame;
+		}
+		if (picture->type() == TagLib::ID3v2::AttachedPictureFrame::FrontCover) {
+			break;
+		}
+	}
+	if (picture == nullptr) {
+		return nullptr;
+	}
+	return new Cover(picture->picture(), QString(picture->mimeType().toCString(true)));
+}
+
+/** Same as above for FLAC metadata blocks and for METADATA_BLOCK_PICTURE fields of Ogg files. */
+Cover* coverFromPictures(const TagLib::List<TagLib::FLAC::Picture*> &pictures)
+{
+	TagLib::FLAC::Picture *picture = nullptr;
+	for (auto it = pictures.begin(); it != pictures.end(); it++) {
+		TagLib::FLAC::Picture *p = *it;
+		if (p == nullptr || p->data().isEmpty()) {
+			continue;
+		}
+		if (picture == nullptr || p->type() == TagLib::FLAC::Picture::FrontCover) {
+			picture = p;
+		}
+		if (picture->type() == TagLib::FLAC::Picture::FrontCover) {
+			break;
+		}
+	}
+	if (picture == nullptr) {
+		return nullptr;
+	}
+	return new Cover(picture->data(), QString(picture->mimeType().toCString(true)));
+}
+
+/** MP4 files only store the format of their pictures in atom "covr". */
+Cover* coverFromMp4Tag(const TagLib::MP4::Tag *mp4Tag)
+{
+	const TagLib::MP4::ItemMap &items = mp4Tag->itemMap();
+	auto it = items.find("covr");
+	if (it == items.end()) {
+		return nullptr;
+	}
+	TagLib::MP4::CoverArtList coverArts = it->second.toCoverArtList();
+	for (auto coverArt = coverArts.begin(); coverArt != coverArts.end(); coverArt++) {
+		if (coverArt->data().isEmpty()) {
+			continue;
+		}
+		QString mimeType;
+		switch (coverArt->format()) {
+		case TagLib::MP4::CoverArt::PNG:
+			mimeType = "image/png";
+			break;
+		case TagLib::MP4::CoverArt::BMP:
+			mimeType = "image/bmp";
+			break;
+		case TagLib::MP4::CoverArt::GIF:
+			mimeType = "image/gif";
+			break;
+		default:
+			mimeType = "image/jpeg";
+			break;
+		}
+		return new Cover(coverArt->data(), mimeType);
+	}
+	return nullptr;
+}
+
+/** APE items are a file name terminated by a null byte, followed by the picture. */
+Cover* coverFromApeTag(const TagLib::APE::Tag *apeTag)
+{
+	const TagLib::APE::ItemListMap &items = apeTag->itemListMap();
+	auto it = items.find("COVER ART (FRONT)");
+	if (it == items.end() || it->second.type() != TagLib::APE::Item::Binary) {
+		return nullptr;
+	}
+	TagLib::ByteVector data = it->second.binaryData();
+	int pos = data.find('\0');
+	if (pos < 0 || static_cast<unsigned int>(pos) + 1 >= data.size()) {
+		return nullptr;
+	}
+	// Unlike other containers, the picture isn't described: Qt will guess its format from its content
+	return new Cover(data.mid(pos + 1), QString());
+}
+
+/** ASF files store pictures in attributes "WM/Picture". */
+Cover* coverFromAsfTag(const TagLib::ASF::Tag *asfTag)
+{
+	const TagLib::ASF::AttributeListMap &attributes = asfTag->attributeListMap();
+	auto it = attributes.find("WM/Picture");
+	if (it == attributes.end()) {
+		return nullptr;
+	}
+	// A default picture is valid, one which couldn't be parsed isn't
+	TagLib::ASF::Picture picture;
+	bool found = false;
+	for (auto attribute = it->second.begin(); attribute != it->second.end(); attribute++) {
+		TagLib::ASF::Picture p = attribute->toPicture();
+		if (!p.isValid() || p.picture().isEmpty()) {
+			continue;
+		}
+		if (!found || p.type() == TagLib::ASF::Picture::FrontCover) {
+			picture = p;
+			found = true;
+		}
+		if (picture.type() == TagLib::ASF::Picture::FrontCover) {
+			break;
+		}
+	}
+	if (!found) {
+		return nullptr;
+	}
+	return new Cover(picture.picture(), QString(picture.mimeType().toCString(true)));
+}
+
+/** Dispatches to the right kind of tag, or returns null if the file has no picture. */
+Cover* embeddedCover(TagLib::File *file, int fileType)
+{
+	switch (fileType) {
+	case FileHelper::EXT_APE: {
+		TagLib::APE::File *apeFile = static_cast<TagLib::APE::File*>(file);
+		return apeFile->hasAPETag() ? coverFromApeTag(apeFile->APETag()) : nullptr;
+	}
+	case FileHelper::EXT_ASF:
+		return coverFromAsfTag(static_cast<TagLib::ASF::File*>(file)->tag());
+	case FileHelper::EXT_FLAC:
+		return coverFromPictures(static_cast<TagLib::FLAC::File*>(file)->pictureList());
+	case FileHelper::EXT_MP3: {
+		TagLib::MPEG::File *mpegFile = static_cast<TagLib::MPEG::File*>(file);
+		return mpegFile->hasID3v2Tag() ? coverFromFrames(mpegFile->ID3v2Tag()->frameList("APIC")) : nullptr;
+	}
+	case FileHelper::EXT_MP4:
+		return coverFromMp4Tag(static_cast<TagLib::MP4::File*>(file)->tag());
+	case FileHelper::EXT_MPC: {
+		TagLib::MPC::File *mpcFile = static_cast<TagLib::MPC::File*>(file);
+		return mpcFile->hasAPETag() ? coverFromApeTag(mpcFile->APETag()) : nullptr;
+	}
+	case FileHelper::EXT_OGG: {
+		// Vorbis and Opus files both store their pictures in base64 fields METADATA_BLOCK_PICTURE
+		TagLib::Ogg::XiphComment *xiphComment = dynamic_cast<TagLib::Ogg::XiphComment*>(file->tag());
+		return xiphComment ? coverFromPictures(xiphComment->pictureList()) : nullptr;
+	}
+	default:
+		return nullptr;
+	}
+}
+
+}
+
+FileHelper::FileHelper(const QMediaContent &track, OpenMode mode)
 	: _file(nullptr)
+	, _stream(nullptr)
 	, _fileType(EXT_UNKNOWN)
 	, _isValid(false)
+	, _openMode(mode)
 {
 	bool b = init(QDir::fromNativeSeparators(track.canonicalUrl().toLocalFile()));
 	if (!b) {
@@ -53,14 +289,18 @@ FileHelper::FileHelper(const QMediaContent &track)
 			delete _file;
 			_file = nullptr;
 		}
+		delete _stream;
+		_stream = nullptr;
 		_fileType = EXT_UNKNOWN;
 	}
 }
 
-FileHelper::FileHelper(const QString &filePath)
+FileHelper::FileHelper(const QString &filePath, OpenMode mode)
 	: _file(nullptr)
+	, _stream(nullptr)
 	, _fileType(EXT_UNKNOWN)
 	, _isValid(false)
+	, _openMode(mode)
 {
 	bool b = init(filePath);
 	if (!b) {
@@ -69,6 +309,8 @@ FileHelper::FileHelper(const QString &filePath)
 	if (!b) {
 		delete _file;
 		_file = nullptr;
+		delete _stream;
+		_stream = nullptr;
 		_fileType = EXT_UNKNOWN;
 	}
 }
@@ -115,29 +357,52 @@ bool FileHelper::init(const QString &filePath)
 	TagLib::String s(QDir::toNativeSeparators(fileName).toUtf8().constData(), TagLib::String::UTF8);
 	TagLib::FileName fp(s.toCString(true));
 #endif
+	// A fast read style takes the duration from the first frame or from headers, instead of scanning the stream
+	bool readProperties = (_openMode != OM_TagsOnly);
+	TagLib::AudioProperties::ReadStyle readStyle = TagLib::AudioProperties::Average;
+	if (_openMode != OM_Full) {
+		readStyle = TagLib::AudioProperties::Fast;
+	}
+	// Tags are parsed from memory when the file won't be saved, instead of many small reads in the file
+	if (_openMode != OM_Full && _stream == nullptr) {
+		MappedFileStream *stream = new MappedFileStream(fileName);
+		if (stream->isOpen()) {
+			_stream = stream;
+		} else {
+			delete stream;
+		}
+	}
 	if (suffix == "ape") {
-		_file = new TagLib::APE::File(fp);
+		_file = _stream ? new TagLib::APE::File(_stream, readProperties, readStyle)
+					   : new TagLib::APE::File(fp, readProperties, readStyle);
 		_fileType = EXT_APE;
 	} else if (suffix == "asf") {
-		_file = new TagLib::ASF::File(fp);
+		_file = _stream ? new TagLib::ASF::File(_stream, readProperties, readStyle)
+					   : new TagLib::ASF::File(fp, readProperties, readStyle);
 		_fileType = EXT_ASF;
 	} else if (suffix == "flac") {
-		_file = new TagLib::FLAC::File(fp);
+		_file = _stream ? new TagLib::FLAC::File(_stream, TagLib::ID3v2::FrameFactory::instance(), readProperties, readStyle)
+					   : new TagLib::FLAC::File(fp, readProperties, readStyle);
 		_fileType = EXT_FLAC;
 	} else if (suffix == "m4a" || suffix == "mp4") {
-		_file = new TagLib::MP4::File(fp);
+		_file = _stream ? new TagLib::MP4::File(_stream, readProperties, readStyle)
+					   : new TagLib::MP4::File(fp, readProperties, readStyle);
 		_fileType = EXT_MP4;
 	} else if (suffix == "mpc") {
-		_file = new TagLib::MPC::File(fp);
+		_file = _stream ? new TagLib::MPC::File(_stream, readProperties, readStyle)
+					   : new TagLib::MPC::File(fp, readProperties, readStyle);
 		_fileType = EXT_MPC;
 	} else if (suffix == "mp3") {
-		_file = new TagLib::MPEG::File(fp);
+		_file = _stream ? new TagLib::MPEG::File(_stream, TagLib::ID3v2::FrameFactory::instance(), readProperties, readStyle)
+					   : new TagLib::MPEG::File(fp, readProperties, readStyle);
 		_fileType = EXT_MP3;
 	} else if (suffix == "ogg" || suffix == "oga") {
-		_file = new TagLib::Vorbis::File(fp);
+		_file = _stream ? new TagLib::Vorbis::File(_stream, readProperties, readStyle)
+					   : new TagLib::Vorbis::File(fp, readProperties, readStyle);
 		_fileType = EXT_OGG;
 	} else if (suffix == "opus") {
-		_file = new TagLib::Ogg::Opus::File(fp);
+		_file = _stream ? new TagLib::Ogg::Opus::File(_stream, readProperties, readStyle)
+					   : new TagLib::Ogg::Opus::File(fp, readProperties, readStyle);
 		_fileType = EXT_OGG;
 	} else {
 		_file = nullptr;
@@ -149,6 +414,8 @@ bool FileHelper::init(const QString &filePath)
 	} else {
 		delete _file;
 		_file = nullptr;
+		delete _stream;
+		_stream = nullptr;
 		_fileType = EXT_UNKNOWN;
 	}
 	return false;
@@ -160,13 +427,16 @@ FileHelper::~FileHelper()
 		delete _file;
 		_file = nullptr;
 	}
+	// The file reads from its stream until it's deleted
+	delete _stream;
+	_stream = nullptr;
 }
 
 const QStringList FileHelper::suffixes(FileHelper::ExtensionTypes et, bool withPrefix)
 {
 	static QStringList standardSuffixes = QStringList() << "ape" << "asf" << "flac" << "m4a" << "mp4" << "mpc" << "mp3" << "oga" << "ogg" << "opus";
 	static QStringList gameMusicEmuSuffixes = QStringList() << "ay" << "gbs" << "gym" << "hes" << "kss" << "nsf" << "nsfe" << "sap" << "spc" << "vgm" << "vgz";
-	static QStringList playlistSuffixes = QStringList() << "m3u" << "m3u8" << "xspf";
+	static QStringList playlistSuffixes = QStringList() << "m3u" << "m3u8" << "pls" << "xspf";
 	QStringList filters;
 	if (et & ET_Standard) {
 		if (withPrefix) {
@@ -305,64 +575,28 @@ int FileHelper::discNumber(bool canBeZero) const
 	default:
 		qDebug() << Q_FUNC_INFO << "Not yet implemented for this file type" << _fileType;
 	}
-	int disc = -1;
-	if (strDiscNumber.contains('/')) {
-		disc = strDiscNumber.split('/').first().toInt();
-	} else {
-		disc = strDiscNumber.toInt();
-		if (canBeZero && disc == 0) {
-			disc = -1;
-		}
-	}
-	return disc;
+	return parseDiscNumber(strDiscNumber, canBeZero);
 }
 
+/** Pictures aren't copied: covers keep a reference on buffers of TagLib, which remain valid once the file is closed. */
 Cover* FileHelper::extractCover()
 {
-	Cover *cover = nullptr;
-	switch (_fileType) {
-	case EXT_MP3: {
-		TagLib::MPEG::File *mpegFile = static_cast<TagLib::MPEG::File*>(_file);
-		if (mpegFile && mpegFile->hasID3v2Tag()) {
-			// Look for picture frames only
-			TagLib::ID3v2::FrameList listOfMp3Frames = mpegFile->ID3v2Tag()->frameListMap()["APIC"];
-			// It's possible to have more than one picture per file!
-			if (!listOfMp3Frames.isEmpty()) {
-				for (TagLib::ID3v2::FrameList::ConstIterator it = listOfMp3Frames.begin(); it != listOfMp3Frames.end() ; it++) {
-					// Cast a Frame* to AttachedPictureFrame*
-					TagLib::ID3v2::AttachedPictureFrame *pictureFrame = static_cast<TagLib::ID3v2::AttachedPictureFrame*>(*it);
-					if (pictureFrame) {
-						// Performs a deep copy of the cover
-						QByteArray b = QByteArray(pictureFrame->picture().data(), pictureFrame->picture().size());
-						cover = new Cover(b, QString(pictureFrame->mimeType().toCString(true)));
-					}
-				}
-			}
-		} else if (mpegFile && mpegFile->hasID3v1Tag()) {
-			qDebug() << Q_FUNC_INFO << "Not implemented for ID3v1Tag";
-		}
-		break;
-	}
-	case EXT_FLAC: {
-		if (TagLib::FLAC::File *flacFile = static_cast<TagLib::FLAC::File*>(_file)) {
-			auto list = flacFile->pictureList();
-			for (auto it = list.begin(); it != list.end() ; it++) {
-				TagLib::FLAC::Picture *p = *it;
-				if (p->type() == TagLib::FLAC::Picture::FrontCover) {
-					// Performs a deep copy of the cover
-					QByteArray b = QByteArray(p->data().data(), p->data().size());
-					cover = new Cover(b, QString(p->mimeType().toCString(true)));
-					break;
-				}
-			}
-		}
-		break;
+	if (!(_file && _file->tag())) {
+		return nullptr;
 	}
+	switch (_fileType) {
+	case EXT_APE:
+	case EXT_ASF:
+	case EXT_FLAC:
+	case EXT_MP3:
+	case EXT_MP4:
+	case EXT_MPC:
+	case EXT_OGG:
+		return embeddedCover(_file, _fileType);
 	default:
 		qDebug() << Q_FUNC_INFO << "Not implemented for this file type" << _fileType << _file << _fileInfo.absoluteFilePath();
-		break;
+		return nullptr;
 	}
-	return cover;
 }
 
 bool FileHelper::insert(Field key, const QVariant &value)
@@ -413,15 +647,7 @@ bool FileHelper::hasCover() const
 		TagLib::MPEG::File *mpegFile = static_cast<TagLib::MPEG::File*>(_file);
 		if (mpegFile && mpegFile->hasID3v2Tag()) {
 			// Look for picture frames only
-			TagLib::ID3v2::FrameList listOfMp3Frames = mpegFile->ID3v2Tag()->frameListMap()["APIC"];
-			// It's possible to have more than one picture per file!
-			if (!listOfMp3Frames.isEmpty()) {
-				for (TagLib::ID3v2::FrameList::ConstIterator it = listOfMp3Frames.begin(); it != listOfMp3Frames.end() ; it++) {
-					// Cast a Frame* to AttachedPictureFrame*
-					TagLib::ID3v2::AttachedPictureFrame *pictureFrame = static_cast<TagLib::ID3v2::AttachedPictureFrame*>(*it);
-					atLeastOnePicture = atLeastOnePicture || (pictureFrame != nullptr && !pictureFrame->picture().isEmpty());
-				}
-			}
+			atLeastOnePicture = hasPicture(mpegFile->ID3v2Tag()->frameList("APIC"));
 		}
 		break;
 	}
@@ -429,6 +655,19 @@ bool FileHelper::hasCover() const
 		if (TagLib::FLAC::File *flacFile = static_cast<TagLib::FLAC::File*>(_file)) {
 			atLeastOnePicture = !flacFile->pictureList().isEmpty();
 		}
+		break;
+	}
+	case EXT_APE:
+	case EXT_ASF:
+	case EXT_MP4:
+	case EXT_MPC:
+	case EXT_OGG: {
+		// Pictures of these containers are parsed by TagLib anyway, a cover only references one of them
+		if (_file && _file->tag()) {
+			std::unique_ptr<Cover> cover(embeddedCover(_file, _fileType));
+			atLeastOnePicture = (cover != nullptr);
+		}
+		break;
 	}
 	default:
 		break;
@@ -471,6 +710,113 @@ int FileHelper::rating() const
 	return r;
 }
 
+/** Reads every field stored in the library, with one lookup per tag instead of one per field. */
+TrackMetadata FileHelper::readAll() const
+{
+	TrackMetadata metadata;
+	if (!(_file && _file->tag())) {
+		return metadata;
+	}
+
+	// Standard tags
+	TagLib::Tag *tag = _file->tag();
+	metadata.title = QString(tag->title().toCString(true));
+	metadata.artist = QString(tag->artist().toCString(true)).trimmed();
+	metadata.album = QString(tag->album().toCString(true)).trimmed();
+	if (tag->year() > 0 && tag->year() < INT_MAX) {
+		metadata.year = QString::number(tag->year());
+	}
+	if (tag->track() < UINT_MAX) {
+		metadata.trackNumber = tag->track();
+	}
+	if (_file->audioProperties()) {
+		metadata.length = _file->audioProperties()->length();
+	}
+
+	// Other fields depend on the container, each map is built or looked up once
+	QString disc = "0";
+	switch (_fileType) {
+	case EXT_APE:
+	case EXT_MPC: {
+		TagLib::PropertyMap properties = _file->properties();
+		metadata.artistAlbum = firstValue(properties, "ALBUMARTIST");
+		disc = firstValue(properties, "DISCNUMBER");
+		break;
+	}
+	case EXT_OGG: {
+		TagLib::PropertyMap properties = _file->properties();
+		metadata.artistAlbum = firstValue(properties, "ALBUMARTIST");
+		if (metadata.artistAlbum.isEmpty()) {
+			metadata.artistAlbum = firstValue(properties, "ALBUM ARTIST");
+		}
+		disc = firstValue(properties, "DISCNUMBER");
+		break;
+	}
+	case EXT_FLAC: {
+		TagLib::FLAC::File *flacFile = static_cast<TagLib::FLAC::File*>(_file);
+		if (TagLib::ID3v2::Tag *id3v2 = flacFile->ID3v2Tag()) {
+			metadata.artistAlbum = firstValue(id3v2->frameList("TPE2"));
+			disc = firstValue(id3v2->frameList("TPOS"));
+			// Fallback to the generic map in case we didn't find the matching key
+			if (metadata.artistAlbum.isEmpty() || disc.isEmpty()) {
+				TagLib::PropertyMap properties = _file->properties();
+				if (metadata.artistAlbum.isEmpty()) {
+					metadata.artistAlbum = firstValue(properties, "ALBUMARTIST");
+				}
+				if (disc.isEmpty()) {
+					disc = firstValue(properties, "DISCNUMBER");
+				}
+			}
+			metadata.rating = ratingFromPopularimeter(id3v2->frameList("POPM"));
+		} else if (flacFile->hasXiphComment()) {
+			const TagLib::Ogg::FieldListMap &fields = flacFile->xiphComment()->fieldListMap();
+			metadata.artistAlbum = firstValue(fields, "ALBUMARTIST");
+			disc = firstValue(fields, "DISCNUMBER");
+			QString rating = firstValue(fields, "RATING");
+			if (!rating.isEmpty()) {
+				metadata.rating = rating.toInt();
+			}
+		}
+		metadata.hasCover = !flacFile->pictureList().isEmpty();
+		break;
+	}
+	case EXT_MP4: {
+		if (TagLib::MP4::Tag *mp4Tag = static_cast<TagLib::MP4::File*>(_file)->tag()) {
+			const TagLib::MP4::ItemMap &items = mp4Tag->itemMap();
+			auto it = items.find("aART");
+			if (it != items.end()) {
+				metadata.artistAlbum = firstValue(it->second.toStringList());
+			}
+			it = items.find("disk");
+			if (it != items.end()) {
+				disc = QString::number(it->second.toIntPair().first);
+			}
+		}
+		break;
+	}
+	case EXT_MP3: {
+		TagLib::MPEG::File *mpegFile = static_cast<TagLib::MPEG::File*>(_file);
+		if (mpegFile->hasID3v2Tag()) {
+			TagLib::ID3v2::Tag *id3v2 = mpegFile->ID3v2Tag();
+			metadata.artistAlbum = firstValue(id3v2->frameList("TPE2"));
+			disc = firstValue(id3v2->frameList("TPOS"));
+			metadata.hasCover = hasPicture(id3v2->frameList("APIC"));
+			metadata.rating = ratingFromPopularimeter(id3v2->frameList("POPM"));
+		}
+		break;
+	}
+	default:
+		break;
+	}
+	// Stored during the scan, so that views never probe a track without a picture
+	if (_fileType != EXT_FLAC && _fileType != EXT_MP3) {
+		metadata.hasCover = this->hasCover();
+	}
+	metadata.artistAlbum = metadata.artistAlbum.trimmed();
+	metadata.disc = parseDiscNumber(disc, false);
+	return metadata;
+}
+
 /** Sets the inner picture. */
 void FileHelper::setCover(Cover *cover)
 {
@@ -798,33 +1144,23 @@ QString FileHelper::extractVorbisFeature(const QString &featureToExtract) const
 	return feature;
 }
 
-int FileHelper::ratingForID3v2(TagLib::ID3v2::Tag *tag) const
+int FileHelper::parseDiscNumber(const QString &disc, bool canBeZero)
 {
-	int r = -1;
-	TagLib::ID3v2::FrameList l = tag->frameListMap()["POPM"];
-	if (l.isEmpty()) {
-		return r;
-	}
-	if (TagLib::ID3v2::PopularimeterFrame *pf = static_cast<TagLib::ID3v2::PopularimeterFrame*>(l.front())) {
-		switch (pf->rating()) {
-		case 1:
-			r = 1;
-			break;
-		case 64:
-			r = 2;
-			break;
-		case 128:
-			r = 3;
-			break;
-		case 196:
-			r = 4;
-			break;
-		case 255:
-			r = 5;
-			break;
+	int d = -1;
+	if (disc.contains('/')) {
+		d = disc.split('/').first().toInt();
+	} else {
+		d = disc.toInt();
+		if (canBeZero && d == 0) {
+			d = -1;
 		}
 	}
-	return r;
+	return d;
+}
+
+int FileHelper::ratingForID3v2(TagLib::ID3v2::Tag *tag) const
+{
+	return ratingFromPopularimeter(tag->frameList("POPM"));
 }
 
 void FileHelper::setFlacAttribute(const std::string &attribute, const QString &value)
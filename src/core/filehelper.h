@@ -14,6 +14,7 @@ class Cover;
 /// Forward declaration
 namespace TagLib {
 	class File;
+	class IOStream;
 
 	namespace ID3v2 {
 		class Tag;
@@ -24,6 +25,28 @@ namespace TagLib {
 	}
 }
 
+/**
+ * \brief		The TrackMetadata struct holds fields of a track which are stored in the library.
+ * \details		It's filled by FileHelper::readAll(), which walks each tag of the file once instead of once per field.
+ */
+struct TrackMetadata
+{
+	QString title;
+	QString artist;
+	/** Field ArtistAlbum if exists (in a compilation for example), empty otherwise. */
+	QString artistAlbum;
+	QString album;
+	QString year;
+	int trackNumber;
+	/** In seconds. */
+	int length;
+	int disc;
+	bool hasCover;
+	int rating;
+
+	TrackMetadata() : trackNumber(0), length(0), disc(-1), hasCover(false), rating(-1) {}
+};
+
 /**
  * \brief		The FileHelper class is used to extract various but relevant fields in all types of tags (MP3, Flac, etc).
  * \author      Matthieu Bachelier
@@ -34,13 +57,18 @@ class MIAMCORE_LIBRARY FileHelper
 private:
 	TagLib::File *_file;
 
+	/** Set when the file is only read, null when TagLib opens the file itself. */
+	TagLib::IOStream *_stream;
+
 	int _fileType;
 	bool _isValid;
+	int _openMode;
 
 	QFileInfo _fileInfo;
 
 	Q_ENUMS(Extension)
 	Q_ENUMS(Field)
+	Q_ENUMS(OpenMode)
 
 public:
 	enum Extension {
@@ -81,9 +109,16 @@ public:
 		Field_Year			= 12
 	};
 
-	explicit FileHelper(const QMediaContent &track);
+	/** Audio properties can be long to compute (VBR files without header are scanned), views often need tags only. */
+	enum OpenMode {
+		OM_TagsOnly			= 0,
+		OM_TagsAndDuration	= 1,
+		OM_Full				= 2
+	};
+
+	explicit FileHelper(const QMediaContent &track, OpenMode mode = OM_Full);
 
-	explicit FileHelper(const QString &filePath);
+	explicit FileHelper(const QString &filePath, OpenMode mode = OM_Full);
 
 	static std::string keyToStdString(Field f);
 
@@ -113,6 +148,9 @@ public:
 	/** Convert the existing rating number into a smaller range from 1 to 5. */
 	int rating() const;
 
+	/** Reads every field stored in the library, with one lookup per tag instead of one per field. */
+	TrackMetadata readAll() const;
+
 	/** Sets the inner picture. */
 	void setCover(Cover *cover);
 
@@ -146,6 +184,8 @@ private:
 	QString extractMpegFeature(const QString &featureToExtract) const;
 	QString extractVorbisFeature(const QString &featureToExtract) const;
 
+	static int parseDiscNumber(const QString &disc, bool canBeZero);
+
 	int ratingForID3v2(TagLib::ID3v2::Tag *tag) const;
 	void setFlacAttribute(const std::string &attribute, const QString &value);
 	void setMp4Attribute(const std::string &attribute, const TagLib::MP4::Item &value);
@@ -1,5 +1,5 @@
 #include "jumptowidget.h"
-#include "settingsprivate.h"
+#include "settingssnapshot.h"
 
 #include <QApplication>
 #include <QHeaderView>
@@ -74,7 +74,7 @@ void JumpToWidget::mouseMoveEvent(QMouseEvent *event)
 void JumpToWidget::resizeEvent(QResizeEvent *event)
 {
 	QFont f = this->font();
-	int fontPointSize = SettingsPrivate::instance()->fontSize(SettingsPrivate::FF_Library);
+	int fontPointSize = SettingsPrivate::instance()->snapshot()->libraryFont.pointSize();
 	f.setPointSizeF(qMin((qreal)fontPointSize, height() / 60.0));
 	this->setFont(f);
 	QWidget::resizeEvent(event);
@@ -104,7 +104,7 @@ void JumpToWidget::paintEvent(QPaintEvent *)
 		if (r.contains(this->mapFromGlobal(QCursor::pos())) || _currentLetter == qc) {
 			QColor lighterBG = o.palette.highlight().color().lighter(lighterValue);
 			QColor highlightedText = o.palette.highlightedText().color();
-			if (SettingsPrivate::instance()->isCustomTextColorOverriden() || qAbs(lighterBG.value() - highlightedText.value()) > 128) {
+			if (SettingsPrivate::instance()->snapshot()->isCustomTextColorOverriden || qAbs(lighterBG.value() - highlightedText.value()) > 128) {
 				p.setPen(highlightedText);
 			} else {
 				p.setPen(o.palette.text().color());
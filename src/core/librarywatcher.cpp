@@ -0,0 +1,563 @@
+#include "librarywatcher.h"
+
+#include "directorywalker.h"
+#include "filehelper.h"
+#include "model/batchwriter.h"
+#include "model/sqldatabase.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSocketNotifier>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QTimer>
+
+#include <QtDebug>
+
+#if defined(Q_OS_LINUX)
+#include <errno.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+/** Upper bound of paths below a folder, for range queries which can use the index on uri: "dir/" <= uri < "dir0". */
+inline QString afterLastChild(const QString &dir)
+{
+	return dir + QChar('/' + 1);
+}
+
+inline qint64 lastModified(const QString &path)
+{
+	return QFileInfo(path).lastModified().toMSecsSinceEpoch();
+}
+
+}
+
+LibraryWatcher::LibraryWatcher(QObject *parent)
+	: QObject(parent)
+	, _inotifyFd(-1)
+	, _notifier(nullptr)
+	, _applyTimer(new QTimer(this))
+	, _pollTimer(new QTimer(this))
+{
+	for (QString suffix : FileHelper::suffixes(FileHelper::ET_Standard | FileHelper::ET_GameMusicEmu)) {
+		_suffixes.insert(suffix);
+	}
+
+	// Copying a folder generates lots of events: wait a little bit before writing in the database
+	_applyTimer->setSingleShot(true);
+	_applyTimer->setInterval(500);
+	connect(_applyTimer, &QTimer::timeout, this, &LibraryWatcher::applyChanges);
+
+	_pollTimer->setInterval(5 * 60 * 1000);
+	connect(_pollTimer, &QTimer::timeout, this, &LibraryWatcher::reconcile);
+}
+
+LibraryWatcher::~LibraryWatcher()
+{
+	this->stop();
+}
+
+/** Compares the library with folders which have changed since last time, then watches every folder in locations. */
+void LibraryWatcher::start(const QStringList &locations)
+{
+	this->stop();
+	for (QString location : locations) {
+		_locations.append(QDir::cleanPath(QDir(location).absolutePath()));
+	}
+
+#if defined(Q_OS_LINUX)
+	_inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (_inotifyFd >= 0) {
+		_notifier = new QSocketNotifier(_inotifyFd, QSocketNotifier::Read, this);
+		connect(_notifier, &QSocketNotifier::activated, this, &LibraryWatcher::readEvents);
+	} else {
+		qWarning() << Q_FUNC_INFO << "inotify is not available, folders will be checked periodically";
+	}
+#endif
+	if (_inotifyFd < 0) {
+		_pollTimer->start();
+	}
+
+	this->reconcile();
+}
+
+void LibraryWatcher::stop()
+{
+	_applyTimer->stop();
+	_pollTimer->stop();
+	if (_notifier) {
+		delete _notifier;
+		_notifier = nullptr;
+	}
+#if defined(Q_OS_LINUX)
+	if (_inotifyFd >= 0) {
+		// Also removes every watch
+		::close(_inotifyFd);
+		_inotifyFd = -1;
+	}
+#endif
+	_watchedDirs.clear();
+	_watchDescriptors.clear();
+	_pendingMoves.clear();
+	_locations.clear();
+}
+
+void LibraryWatcher::addWatch(const QString &dir)
+{
+#if defined(Q_OS_LINUX)
+	if (_inotifyFd < 0 || _watchDescriptors.contains(dir)) {
+		return;
+	}
+	int wd = inotify_add_watch(_inotifyFd, QFile::encodeName(dir).constData(),
+							   IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR);
+	if (wd >= 0) {
+		_watchedDirs.insert(wd, dir);
+		_watchDescriptors.insert(dir, wd);
+	} else if (errno == ENOSPC && !_pollTimer->isActive()) {
+		qWarning() << Q_FUNC_INFO << "No more inotify watches available (see fs.inotify.max_user_watches), folders will also be checked periodically";
+		_pollTimer->start();
+	}
+#else
+	Q_UNUSED(dir)
+#endif
+}
+
+/** Watches a new folder and its subfolders, files inside are added to the library. */
+void LibraryWatcher::addWatchesRecursively(const QString &dir)
+{
+	_createdDirs.insert(dir);
+	_removedDirs.remove(dir);
+	this->addWatch(dir);
+	DirectoryWalker::walk(dir, [this](const QString &entry, bool isDir) {
+		if (isDir) {
+			_createdDirs.insert(entry);
+			this->addWatch(entry);
+		} else if (this->isAudioFile(entry)) {
+			_updatedFiles.insert(entry);
+		}
+	});
+}
+
+bool LibraryWatcher::isAudioFile(const QString &absFilePath) const
+{
+	int dot = absFilePath.lastIndexOf('.');
+	return dot > absFilePath.lastIndexOf('/') && _suffixes.contains(absFilePath.mid(dot + 1));
+}
+
+void LibraryWatcher::readEvents()
+{
+#if defined(Q_OS_LINUX)
+	bool hasOverflowed = false;
+	alignas(struct inotify_event) char buffer[64 * 1024];
+	ssize_t length;
+	while ((length = ::read(_inotifyFd, buffer, sizeof(buffer))) > 0) {
+		for (char *p = buffer; p < buffer + length; ) {
+			const struct inotify_event *event = reinterpret_cast<const struct inotify_event*>(p);
+			p += sizeof(struct inotify_event) + event->len;
+
+			if (event->mask & IN_Q_OVERFLOW) {
+				hasOverflowed = true;
+				continue;
+			}
+			if (event->mask & IN_IGNORED) {
+				// Folder was removed (or moved outside watched locations)
+				QString dir = _watchedDirs.take(event->wd);
+				if (_watchDescriptors.value(dir) == event->wd) {
+					_watchDescriptors.remove(dir);
+				}
+				continue;
+			}
+
+			QString dir = _watchedDirs.value(event->wd);
+			if (dir.isEmpty() || event->len == 0) {
+				continue;
+			}
+			QString path = dir + '/' + QFile::decodeName(event->name);
+			bool isDir = event->mask & IN_ISDIR;
+
+			if (event->mask & IN_MOVED_FROM) {
+				_pendingMoves.insert(event->cookie, path);
+			} else if (event->mask & IN_MOVED_TO) {
+				QString oldPath = _pendingMoves.take(event->cookie);
+				if (isDir) {
+					if (oldPath.isEmpty()) {
+						// Moved from outside music locations
+						this->addWatchesRecursively(path);
+					} else {
+						_renamedDirs.append(qMakePair(oldPath, path));
+						// Watch descriptors follow the folder, only paths have to be updated
+						QString oldPrefix = oldPath + '/';
+						for (auto it = _watchedDirs.begin(); it != _watchedDirs.end(); ++it) {
+							if (it.value() == oldPath || it.value().startsWith(oldPrefix)) {
+								_watchDescriptors.remove(it.value());
+								it.value() = path + it.value().mid(oldPath.length());
+								_watchDescriptors.insert(it.value(), it.key());
+							}
+						}
+					}
+				} else if (!oldPath.isEmpty() && this->isAudioFile(oldPath)) {
+					if (_updatedFiles.remove(oldPath)) {
+						// File was created then renamed before being saved in the library
+						if (this->isAudioFile(path)) {
+							_updatedFiles.insert(path);
+						}
+					} else if (this->isAudioFile(path)) {
+						_renamedFiles.append(qMakePair(oldPath, path));
+					} else {
+						_removedFiles.insert(oldPath);
+					}
+				} else if (this->isAudioFile(path)) {
+					_updatedFiles.insert(path);
+					_removedFiles.remove(path);
+				}
+			} else if (event->mask & IN_CREATE) {
+				// Files are added when they are closed, after being written
+				if (isDir) {
+					this->addWatchesRecursively(path);
+				}
+			} else if (event->mask & IN_CLOSE_WRITE) {
+				if (this->isAudioFile(path)) {
+					_updatedFiles.insert(path);
+					_removedFiles.remove(path);
+				}
+			} else if (event->mask & IN_DELETE) {
+				if (isDir) {
+					_removedDirs.insert(path);
+					_createdDirs.remove(path);
+				} else if (this->isAudioFile(path)) {
+					_removedFiles.insert(path);
+					_updatedFiles.remove(path);
+				}
+			}
+		}
+	}
+
+	// Moves without a matching "moved to" event: items have left music locations
+	for (QString oldPath : _pendingMoves) {
+		if (_watchDescriptors.contains(oldPath)) {
+			this->removeWatchesRecursively(oldPath);
+			_removedDirs.insert(oldPath);
+		} else if (this->isAudioFile(oldPath)) {
+			_removedFiles.insert(oldPath);
+			_updatedFiles.remove(oldPath);
+		}
+	}
+	_pendingMoves.clear();
+
+	if (hasOverflowed) {
+		qWarning() << Q_FUNC_INFO << "inotify queue has overflowed, some changes were lost";
+		emit overflowed();
+	}
+	this->scheduleApply();
+#endif
+}
+
+void LibraryWatcher::removeWatchesRecursively(const QString &dir)
+{
+#if defined(Q_OS_LINUX)
+	QString prefix = dir + '/';
+	for (auto it = _watchDescriptors.begin(); it != _watchDescriptors.end(); ) {
+		if (it.key() == dir || it.key().startsWith(prefix)) {
+			inotify_rm_watch(_inotifyFd, it.value());
+			_watchedDirs.remove(it.value());
+			it = _watchDescriptors.erase(it);
+		} else {
+			++it;
+		}
+	}
+#else
+	Q_UNUSED(dir)
+#endif
+}
+
+void LibraryWatcher::scheduleApply()
+{
+	if (!_updatedFiles.isEmpty() || !_removedFiles.isEmpty() || !_createdDirs.isEmpty() || !_removedDirs.isEmpty() ||
+			!_renamedFiles.isEmpty() || !_renamedDirs.isEmpty()) {
+		_applyTimer->start();
+	}
+}
+
+/** Writes grouped changes in the database then notifies views. */
+void LibraryWatcher::applyChanges()
+{
+	QStringList added, modified, removed;
+	QList<QPair<QString, QString>> renamed;
+
+	// Folders whose content has changed: their modification time is saved to avoid checking them again on next start
+	QSet<QString> touchedDirs;
+	auto parentDir = [](const QString &path) -> QString {
+		return path.left(path.lastIndexOf('/'));
+	};
+
+	SqlDatabase db;
+
+	// Files are read before the write transaction is opened: other writers don't wait for tags to be parsed
+	QSqlQuery exists(db);
+	exists.setForwardOnly(true);
+	exists.prepare("SELECT 1 FROM cache WHERE uri = ?");
+	auto isKnown = [&exists](const QString &absFilePath) -> bool {
+		exists.addBindValue(absFilePath);
+		bool b = exists.exec() && exists.next();
+		exists.finish();
+		return b;
+	};
+	QList<QPair<QString, QString>> renamedFiles;
+	for (const QPair<QString, QString> &pair : _renamedFiles) {
+		if (isKnown(pair.first)) {
+			renamedFiles.append(pair);
+		} else {
+			// Unknown file: it was probably never parsed, or its folder was renamed in the same group of events
+			_removedFiles.insert(pair.first);
+			_updatedFiles.insert(pair.second);
+		}
+	}
+	QList<CacheRow> rows;
+	for (QString absFilePath : _updatedFiles) {
+		CacheRow row;
+		row.stamp = FileStamp::fromFileInfo(QFileInfo(absFilePath));
+		if (SqlDatabase::readFileRef(absFilePath, row)) {
+			rows.append(row);
+			if (isKnown(absFilePath)) {
+				modified << absFilePath;
+			} else {
+				added << absFilePath;
+			}
+		}
+		touchedDirs << parentDir(absFilePath);
+	}
+
+	db.transaction();
+
+	// Whole folders were renamed: tracks and folders below are renamed in place, tags are not read again
+	for (const QPair<QString, QString> &pair : _renamedDirs) {
+		QString oldPrefix = pair.first + '/';
+		QString newPrefix = pair.second + '/';
+		QSqlQuery select(db);
+		select.setForwardOnly(true);
+		select.prepare("SELECT uri FROM cache WHERE uri >= ? AND uri < ?");
+		select.addBindValue(oldPrefix);
+		select.addBindValue(afterLastChild(pair.first));
+		if (select.exec()) {
+			while (select.next()) {
+				QString oldUri = select.record().value(0).toString();
+				renamed.append(qMakePair(oldUri, newPrefix + oldUri.mid(oldPrefix.length())));
+			}
+		}
+		QSqlQuery update(db);
+		update.prepare("UPDATE cache SET uri = :new || substr(uri, :len), " \
+					   "internalCover = CASE WHEN internalCover IS NULL THEN NULL ELSE :new || substr(internalCover, :len) END, " \
+					   "cover = CASE WHEN cover >= :old AND cover < :end THEN :new || substr(cover, :len) ELSE cover END " \
+					   "WHERE uri >= :old AND uri < :end");
+		update.bindValue(":new", newPrefix);
+		update.bindValue(":len", oldPrefix.length() + 1);
+		update.bindValue(":old", oldPrefix);
+		update.bindValue(":end", afterLastChild(pair.first));
+		update.exec();
+
+		QSqlQuery updateDirs(db);
+		updateDirs.prepare("UPDATE filesystem SET path = :new || substr(path, :len) WHERE path = :dir OR (path >= :old AND path < :end)");
+		updateDirs.bindValue(":new", pair.second);
+		updateDirs.bindValue(":len", pair.first.length() + 1);
+		updateDirs.bindValue(":dir", pair.first);
+		updateDirs.bindValue(":old", oldPrefix);
+		updateDirs.bindValue(":end", afterLastChild(pair.first));
+		updateDirs.exec();
+
+		touchedDirs << parentDir(pair.first) << parentDir(pair.second);
+	}
+
+	QSqlQuery renameTrack(db);
+	renameTrack.prepare("UPDATE cache SET uri = :new, internalCover = CASE WHEN internalCover IS NULL THEN NULL ELSE :new END WHERE uri = :old");
+	for (const QPair<QString, QString> &pair : renamedFiles) {
+		renameTrack.bindValue(":new", pair.second);
+		renameTrack.bindValue(":old", pair.first);
+		if (renameTrack.exec()) {
+			renamed.append(pair);
+		}
+		touchedDirs << parentDir(pair.first) << parentDir(pair.second);
+	}
+
+	for (QString dir : _removedDirs) {
+		QSqlQuery select(db);
+		select.setForwardOnly(true);
+		select.prepare("SELECT uri FROM cache WHERE uri >= ? AND uri < ?");
+		select.addBindValue(dir + '/');
+		select.addBindValue(afterLastChild(dir));
+		if (select.exec()) {
+			while (select.next()) {
+				removed << select.record().value(0).toString();
+			}
+		}
+		QSqlQuery remove(db);
+		remove.prepare("DELETE FROM cache WHERE uri >= ? AND uri < ?");
+		remove.addBindValue(dir + '/');
+		remove.addBindValue(afterLastChild(dir));
+		remove.exec();
+
+		QSqlQuery removeDirs(db);
+		removeDirs.prepare("DELETE FROM filesystem WHERE path = ? OR (path >= ? AND path < ?)");
+		removeDirs.addBindValue(dir);
+		removeDirs.addBindValue(dir + '/');
+		removeDirs.addBindValue(afterLastChild(dir));
+		removeDirs.exec();
+
+		touchedDirs << parentDir(dir);
+	}
+
+	QSqlQuery removeTrack(db);
+	removeTrack.prepare("DELETE FROM cache WHERE uri = ?");
+	for (QString absFilePath : _removedFiles) {
+		removeTrack.addBindValue(absFilePath);
+		if (removeTrack.exec() && removeTrack.numRowsAffected() > 0) {
+			removed << absFilePath;
+		}
+		touchedDirs << parentDir(absFilePath);
+	}
+
+	// Statements are prepared once for every row, the writer joins the transaction
+	BatchWriter writer(&db);
+	for (const CacheRow &row : rows) {
+		writer.saveFileRef(row);
+	}
+	writer.flush();
+
+	touchedDirs.unite(_createdDirs);
+	QSqlQuery saveDir(db);
+	saveDir.prepare("INSERT OR REPLACE INTO filesystem (path, lastModified) VALUES (?, ?)");
+	for (QString dir : touchedDirs) {
+		if (_removedDirs.contains(dir) || !QFileInfo::exists(dir)) {
+			continue;
+		}
+		saveDir.addBindValue(dir);
+		saveDir.addBindValue(lastModified(dir));
+		saveDir.exec();
+	}
+	db.commit();
+
+	_updatedFiles.clear();
+	_removedFiles.clear();
+	_createdDirs.clear();
+	_removedDirs.clear();
+	_renamedFiles.clear();
+	_renamedDirs.clear();
+
+	QStringList updated = added + modified;
+	for (QString absFilePath : added) {
+		emit fileAdded(absFilePath);
+	}
+	for (QString absFilePath : modified) {
+		emit fileModified(absFilePath);
+	}
+	for (QString absFilePath : removed) {
+		emit fileRemoved(absFilePath);
+	}
+	for (const QPair<QString, QString> &pair : renamed) {
+		emit fileRenamed(pair.first, pair.second);
+		removed << pair.first;
+		updated << pair.second;
+	}
+	if (!updated.isEmpty() || !removed.isEmpty()) {
+		emit tracksChanged(updated, removed);
+	}
+}
+
+/** Compares folders stored in table "filesystem" with the filesystem, and updates files in modified folders. */
+void LibraryWatcher::reconcile()
+{
+	SqlDatabase db;
+
+	// Folders and their modification time, saved during previous session (or previous check)
+	QHash<QString, qint64> knownDirs;
+	QSqlQuery selectDirs(db);
+	selectDirs.setForwardOnly(true);
+	if (selectDirs.exec("SELECT path, lastModified FROM filesystem")) {
+		while (selectDirs.next()) {
+			knownDirs.insert(selectDirs.record().value(0).toString(), selectDirs.record().value(1).toLongLong());
+		}
+	}
+
+	// Tracks in the library with their stamps
+	QHash<QString, FileStamp> knownFiles = db.selectFileStamps();
+
+	// Adding or removing an entry in a folder changes its modification time: files of other folders are only compared with their stamps
+	QStringList modifiedDirs;
+	QSet<QString> currentDirs;
+	auto visitDir = [&](const QString &dir) {
+		currentDirs.insert(dir);
+		auto known = knownDirs.find(dir);
+		if (known == knownDirs.end() || known.value() != lastModified(dir)) {
+			modifiedDirs.append(dir);
+		}
+		this->addWatch(dir);
+	};
+	// A location which can't be reached (an unmounted drive for example) isn't walked, its tracks are kept
+	QStringList walkedLocations;
+	for (QString location : _locations) {
+		if (!QFileInfo::exists(location)) {
+			continue;
+		}
+		walkedLocations.append(location);
+		visitDir(location);
+		DirectoryWalker::walk(location, [&](const QString &entry, bool isDir) {
+			if (isDir) {
+				visitDir(entry);
+			} else if (this->isAudioFile(entry)) {
+				// Tags saved in place don't change the folder: each known file is compared with its stamp, with one stat
+				auto known = knownFiles.constFind(entry);
+				if (known != knownFiles.constEnd() && known.value() != FileStamp::fromFileInfo(QFileInfo(entry))) {
+					_updatedFiles.insert(entry);
+				}
+			}
+		});
+	}
+
+	// Only folders under a location which was walked can be missing
+	auto isUnderWalkedLocation = [&walkedLocations](const QString &dir) {
+		for (const QString &location : walkedLocations) {
+			if (dir == location || dir.startsWith(location.endsWith('/') ? location : location + '/')) {
+				return true;
+			}
+		}
+		return false;
+	};
+	for (auto it = knownDirs.cbegin(); it != knownDirs.cend(); ++it) {
+		if (!currentDirs.contains(it.key()) && isUnderWalkedLocation(it.key())) {
+			_removedDirs.insert(it.key());
+		}
+	}
+
+	if (!modifiedDirs.isEmpty()) {
+		// Tracks in the library, grouped by folder
+		QMultiHash<QString, QString> filesByDir;
+		for (auto it = knownFiles.cbegin(); it != knownFiles.cend(); ++it) {
+			filesByDir.insert(it.key().left(it.key().lastIndexOf('/')), it.key());
+		}
+
+		for (QString dir : modifiedDirs) {
+			QSet<QString> filesOnDisk;
+			for (QFileInfo fileInfo : QDir(dir).entryInfoList(QDir::Files | QDir::Hidden)) {
+				QString absFilePath = fileInfo.absoluteFilePath();
+				if (!this->isAudioFile(absFilePath)) {
+					continue;
+				}
+				filesOnDisk.insert(absFilePath);
+				auto known = knownFiles.find(absFilePath);
+				if (known == knownFiles.end() || known.value() != FileStamp::fromFileInfo(fileInfo)) {
+					_updatedFiles.insert(absFilePath);
+				}
+			}
+			for (QString absFilePath : filesByDir.values(dir)) {
+				if (!filesOnDisk.contains(absFilePath)) {
+					_removedFiles.insert(absFilePath);
+				}
+			}
+			_createdDirs.insert(dir);
+		}
+	}
+	this->applyChanges();
+}
@@ -0,0 +1,104 @@
+#ifndef LIBRARYWATCHER_H
+#define LIBRARYWATCHER_H
+
+#include <QHash>
+#include <QObject>
+#include <QPair>
+#include <QSet>
+#include <QStringList>
+
+#include "miamcore_global.h"
+
+/// Forward declarations
+class QSocketNotifier;
+class QTimer;
+class SqlDatabase;
+
+/**
+ * \brief		The LibraryWatcher class keeps the library up-to-date while files are added, modified or removed in music locations.
+ * \details		Every folder below music locations is stored in table "filesystem" with its last modification time. When the
+ *				watcher starts, folders which have changed since the last session are compared with the library: this table
+ *				is the persistent state of the watcher. Tags saved in place don't change their folder, so the size and the
+ *				modification time of each known file are compared too. Then on Linux, each folder is registered with inotify
+ *				and events are grouped for a short time. Tags are read first, then changes are applied to table "cache" in a
+ *				single short transaction.
+ *				If the kernel queue overflows, overflowed() is emitted so that an incremental scan can be started.
+ *				On other platforms, or when no more inotify watches are available, folders are checked periodically.
+ * \author      Matthieu Bachelier
+ * \copyright   GNU General Public License v3
+ */
+class MIAMCORE_LIBRARY LibraryWatcher : public QObject
+{
+	Q_OBJECT
+private:
+	int _inotifyFd;
+	QSocketNotifier *_notifier;
+
+	/** Watch descriptor -> folder, and the reverse. */
+	QHash<int, QString> _watchedDirs;
+	QHash<QString, int> _watchDescriptors;
+
+	/** Files moved from a watched folder, waiting for the matching "moved to" event (cookie -> old path). */
+	QHash<quint32, QString> _pendingMoves;
+
+	QStringList _locations;
+	QSet<QString> _suffixes;
+
+	/** Events are grouped then applied to the database after a short delay. */
+	QTimer *_applyTimer;
+
+	/** Periodic check of folders, when live events are not available. */
+	QTimer *_pollTimer;
+
+	QSet<QString> _updatedFiles;
+	QSet<QString> _removedFiles;
+	QSet<QString> _createdDirs;
+	QSet<QString> _removedDirs;
+	QList<QPair<QString, QString>> _renamedFiles;
+	QList<QPair<QString, QString>> _renamedDirs;
+
+public:
+	explicit LibraryWatcher(QObject *parent = nullptr);
+
+	virtual ~LibraryWatcher();
+
+	/** Compares the library with folders which have changed since last time, then watches every folder in locations. */
+	void start(const QStringList &locations);
+
+	void stop();
+
+private:
+	void addWatch(const QString &dir);
+
+	/** Watches a new folder and its subfolders, files inside are added to the library. */
+	void addWatchesRecursively(const QString &dir);
+
+	bool isAudioFile(const QString &absFilePath) const;
+
+	void readEvents();
+
+	void removeWatchesRecursively(const QString &dir);
+
+	void scheduleApply();
+
+private slots:
+	/** Writes grouped changes in the database then notifies views. */
+	void applyChanges();
+
+	/** Compares folders stored in table "filesystem" with the filesystem, and updates files in modified folders. */
+	void reconcile();
+
+signals:
+	void fileAdded(const QString &absFilePath);
+	void fileModified(const QString &absFilePath);
+	void fileRemoved(const QString &absFilePath);
+	void fileRenamed(const QString &oldAbsFilePath, const QString &newAbsFilePath);
+
+	/** Some events were lost: the whole library should be scanned again. */
+	void overflowed();
+
+	/** Sent once changes are in the database. Modified files are in both lists if their path has changed. */
+	void tracksChanged(const QStringList &updatedTracks, const QStringList &removedTracks);
+};
+
+#endif // LIBRARYWATCHER_H
@@ -0,0 +1,194 @@
+#include "mappedfilestream.h"
+
+#include <QAtomicInteger>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QStorageInfo>
+
+#include <QtDebug>
+
+namespace {
+
+/** Large enough for most tags with a small cover in one read, on a network the latency of each read dominates. */
+const qint64 readAheadSize = 256 * 1024;
+
+QAtomicInteger<qint64> bytesReadCount(0);
+QAtomicInteger<qint64> systemCallCount(0);
+
+}
+
+MappedFileStream::MappedFileStream(const QString &absFilePath)
+	: TagLib::IOStream()
+	, _file(absFilePath)
+	, _data(nullptr)
+	, _windowStart(0)
+	, _position(0)
+	, _length(0)
+{
+#ifdef _WIN32
+	_name = QDir::toNativeSeparators(absFilePath).toStdWString();
+#else
+	_name = QFile::encodeName(absFilePath);
+#endif
+
+	// Buffering of QIODevice would add its own reads to the window below
+	systemCallCount.ref();
+	if (!_file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+		return;
+	}
+	systemCallCount.ref();
+	_length = _file.size();
+	if (_length > 0 && _length <= readAheadSize) {
+		// Small files are read at once: the copy is safe even if the file is truncated right after
+		systemCallCount.ref();
+		_window = _file.read(_length);
+		_length = _window.size();
+		bytesReadCount.fetchAndAddRelaxed(_length);
+	} else if (_length > 0 && !isOnNetworkFileSystem(absFilePath)) {
+		systemCallCount.ref();
+		_data = _file.map(0, _length);
+	}
+}
+
+MappedFileStream::~MappedFileStream()
+{
+	if (_data) {
+		_file.unmap(_data);
+	}
+	_file.close();
+}
+
+/** Bytes and system calls of all streams since the application has started. */
+MappedFileStream::Statistics MappedFileStream::statistics()
+{
+	Statistics statistics;
+	statistics.bytesRead = bytesReadCount.load();
+	statistics.systemCalls = systemCallCount.load();
+	return statistics;
+}
+
+TagLib::FileName MappedFileStream::name() const
+{
+#ifdef _WIN32
+	return TagLib::FileName(_name.c_str());
+#else
+	return _name.constData();
+#endif
+}
+
+TagLib::ByteVector MappedFileStream::readBlock(unsigned long length)
+{
+	if (!_file.isOpen() || length == 0 || _position >= _length) {
+		return TagLib::ByteVector();
+	}
+	qint64 count = qMin(static_cast<qint64>(length), _length - _position);
+
+	// Pages are loaded by the kernel on demand, only copies are left
+	if (_data) {
+		// Reading a page after the end of a truncated file raises SIGBUS: when a tag editor has saved the file in the
+		// meantime, the mapping is dropped and the rest is read like on a network filesystem
+		systemCallCount.fetchAndAddRelaxed(1);
+		if (_file.size() >= _position + count) {
+			TagLib::ByteVector block(reinterpret_cast<const char*>(_data + _position), static_cast<unsigned int>(count));
+			_position += count;
+			bytesReadCount.fetchAndAddRelaxed(count);
+			return block;
+		}
+		_file.unmap(_data);
+		_data = nullptr;
+	}
+
+	if (_position < _windowStart || _position + count > _windowStart + _window.size()) {
+		systemCallCount.fetchAndAddRelaxed(2);
+		if (!_file.seek(_position)) {
+			return TagLib::ByteVector();
+		}
+		_window = _file.read(qMax(count, readAheadSize));
+		_windowStart = _position;
+		bytesReadCount.fetchAndAddRelaxed(_window.size());
+		count = qMin(count, static_cast<qint64>(_window.size()));
+	}
+	TagLib::ByteVector block(_window.constData() + (_position - _windowStart), static_cast<unsigned int>(count));
+	_position += count;
+	return block;
+}
+
+/** Streams are only used to read tags: TagLib doesn't try to save a read-only stream. */
+void MappedFileStream::writeBlock(const TagLib::ByteVector &)
+{
+	qDebug() << Q_FUNC_INFO << "Cannot write into a read-only stream" << _file.fileName();
+}
+
+void MappedFileStream::insert(const TagLib::ByteVector &, unsigned long, unsigned long)
+{
+	qDebug() << Q_FUNC_INFO << "Cannot write into a read-only stream" << _file.fileName();
+}
+
+void MappedFileStream::removeBlock(unsigned long, unsigned long)
+{
+	qDebug() << Q_FUNC_INFO << "Cannot write into a read-only stream" << _file.fileName();
+}
+
+bool MappedFileStream::readOnly() const
+{
+	return true;
+}
+
+bool MappedFileStream::isOpen() const
+{
+	return _file.isOpen();
+}
+
+/** Only the position is moved, the file is read when a block is requested. */
+void MappedFileStream::seek(long offset, Position p)
+{
+	switch (p) {
+	case Beginning:
+		_position = offset;
+		break;
+	case Current:
+		_position += offset;
+		break;
+	case End:
+		_position = _length + offset;
+		break;
+	}
+	_position = qMax(Q_INT64_C(0), _position);
+}
+
+long MappedFileStream::tell() const
+{
+	return static_cast<long>(_position);
+}
+
+long MappedFileStream::length()
+{
+	return static_cast<long>(_length);
+}
+
+void MappedFileStream::truncate(long)
+{
+	qDebug() << Q_FUNC_INFO << "Cannot write into a read-only stream" << _file.fileName();
+}
+
+/** Filesystems are checked once per folder. */
+bool MappedFileStream::isOnNetworkFileSystem(const QString &absFilePath)
+{
+	static QMutex mutex;
+	static QHash<QString, bool> folders;
+
+	QString folder = QFileInfo(absFilePath).absolutePath();
+	QMutexLocker locker(&mutex);
+	auto it = folders.constFind(folder);
+	if (it != folders.constEnd()) {
+		return it.value();
+	}
+
+	static const QList<QByteArray> networkTypes = { "9p", "afpfs", "cifs", "davfs", "fuse.sshfs", "ncpfs", "nfs", "nfs4", "smb2", "smbfs" };
+	QStorageInfo storage(folder);
+	bool isNetwork = networkTypes.contains(storage.fileSystemType().toLower()) || storage.device().startsWith("//");
+	folders.insert(folder, isNetwork);
+	return isNetwork;
+}
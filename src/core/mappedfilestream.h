@@ -0,0 +1,88 @@
+#ifndef MAPPEDFILESTREAM_H
+#define MAPPEDFILESTREAM_H
+
+#include <QFile>
+
+#include <string>
+
+#include <taglib/tiostream.h>
+
+#include "miamcore_global.h"
+
+/**
+ * \brief		The MappedFileStream class lets TagLib parse a file from memory instead of issuing many small reads.
+ * \details		TagLib walks ID3v2 frames and FLAC metadata blocks with lots of small read and seek calls on its default
+ *				FileStream. Small files are read at once. Larger local files are mapped in memory once, so reads become
+ *				copies, and their size is checked before each copy: a file truncated by a tag editor is then read by
+ *				windows. Files on network filesystems aren't mapped (a file truncated by another host would crash the
+ *				player), they're read by large windows instead. The stream is read-only: files opened with it can't be
+ *				saved. Bytes read and system calls are counted for every instance, so that a scan can report them.
+ * \author      Matthieu Bachelier
+ * \copyright   GNU General Public License v3
+ */
+class MIAMCORE_LIBRARY MappedFileStream : public TagLib::IOStream
+{
+public:
+	struct Statistics
+	{
+		qint64 bytesRead;
+		qint64 systemCalls;
+
+		Statistics() : bytesRead(0), systemCalls(0) {}
+	};
+
+private:
+	QFile _file;
+
+#ifdef _WIN32
+	std::wstring _name;
+#else
+	QByteArray _name;
+#endif
+
+	/** Whole file when it's mapped in memory, null otherwise. */
+	uchar *_data;
+
+	/** Bytes read ahead when the file isn't mapped, from _windowStart. Whole file when it's small. */
+	QByteArray _window;
+	qint64 _windowStart;
+
+	qint64 _position;
+	qint64 _length;
+
+public:
+	explicit MappedFileStream(const QString &absFilePath);
+
+	virtual ~MappedFileStream();
+
+	/** Bytes and system calls of all streams since the application has started. */
+	static Statistics statistics();
+
+	virtual TagLib::FileName name() const override;
+
+	virtual TagLib::ByteVector readBlock(unsigned long length) override;
+
+	virtual void writeBlock(const TagLib::ByteVector &data) override;
+
+	virtual void insert(const TagLib::ByteVector &data, unsigned long start = 0, unsigned long replace = 0) override;
+
+	virtual void removeBlock(unsigned long start = 0, unsigned long length = 0) override;
+
+	virtual bool readOnly() const override;
+
+	virtual bool isOpen() const override;
+
+	virtual void seek(long offset, Position p = Beginning) override;
+
+	virtual long tell() const override;
+
+	virtual long length() override;
+
+	virtual void truncate(long length) override;
+
+private:
+	/** Filesystems are checked once per folder. */
+	static bool isOnNetworkFileSystem(const QString &absFilePath);
+};
+
+#endif // MAPPEDFILESTREAM_H
@@ -51,7 +51,7 @@ MediaPlayer::MediaPlayer(QObject *parent)
 
 	connect(this, &MediaPlayer::currentMediaChanged, this, [=] (const QString &uri) {
 		QWindow *w = QGuiApplication::topLevelWindows().first();
-		TrackDAO t = SqlDatabase().selectTrackByURI(uri);
+		TrackDAO t = SqlDatabase::reader()->selectTrackByURI(uri);
 		if (t.artist().isEmpty()) {
 			w->setTitle(t.title() + " - Miam Player");
 		} else {
@@ -64,7 +64,8 @@ namespace Miam
 		DF_CurrentPosition		= Qt::UserRole + 16,
 		DF_Artist				= Qt::UserRole + 17,
 		DF_Album				= Qt::UserRole + 18,
-		DF_InternalCover		= Qt::UserRole + 19
+		DF_InternalCover		= Qt::UserRole + 19,
+		DF_ChildrenToFetch		= Qt::UserRole + 20
 	};
 
 	enum TagEditorColumns : int
@@ -38,9 +38,9 @@ public:
 	/** For classes that are subclassing this filter, allow to change sort column (for models based on a Table for example). */
 	virtual int defaultSortColumn() const { return 0; }
 
-private:
+protected:
 	/** Reduce the size of the library when the user is typing text. */
-	void filterLibrary(const QString &filter);
+	virtual void filterLibrary(const QString &filter);
 
 signals:
 	void aboutToHighlightLetters(const QSet<QChar> &letters);
@@ -0,0 +1,246 @@
+#include "batchwriter.h"
+
+#include <QSqlError>
+
+#include <QtDebug>
+
+namespace {
+
+const QString insertFileRef = "INSERT OR REPLACE INTO cache (uri, trackNumber, trackTitle, artist, artistNormalized, album, albumNormalized, " \
+							  "albumYear, artistAlbum, trackLength, disc, internalCover, rating, fileSize, lastModified, inode) VALUES ";
+const QString fileRefValues = "(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+
+/** 16 columns per row: a full statement stays below the default limit of 999 variables in SQLite. */
+const int fileRefsPerStatement = 32;
+
+/** Statements are prepared when they're used for the first time, a writer often needs only one of them. */
+void prepareOnce(QSqlQuery &query, const QString &sql)
+{
+	if (query.lastQuery().isEmpty()) {
+		query.setForwardOnly(true);
+		query.prepare(sql);
+	}
+}
+
+}
+
+BatchWriter::BatchWriter(SqlDatabase *db, int rowsPerTransaction)
+	: _db(db)
+	, _rowsPerTransaction(qMax(1, rowsPerTransaction))
+	, _rowsInTransaction(0)
+	, _ownsTransaction(false)
+	, _hasError(false)
+	, _saveFileRef(*db)
+	, _saveFileRefs(*db)
+	, _updateFileRef(*db)
+	, _removeFileRef(*db)
+	, _insertTrack(*db)
+	, _insertUri(*db)
+	, _insertPlaylistTrack(*db)
+	, _removePlaylistTrack(*db)
+{}
+
+BatchWriter::~BatchWriter()
+{
+	this->flush();
+}
+
+/** Inserts or replaces a local track previously filled by SqlDatabase::readFileRef. */
+void BatchWriter::saveFileRef(const CacheRow &row)
+{
+	_pendingFileRefs.append(row);
+	if (_pendingFileRefs.size() == fileRefsPerStatement) {
+		this->writeFileRefs();
+	}
+}
+
+/** Updates tags of a local track which is already in the library, other columns like cover are kept. */
+void BatchWriter::updateFileRef(const CacheRow &row)
+{
+	prepareOnce(_updateFileRef, "UPDATE cache SET trackNumber = ?, trackTitle = ?, artist = ?, artistNormalized = ?, album = ?, " \
+								"albumNormalized = ?, albumYear = ?, artistAlbum = ?, trackLength = ?, disc = ?, internalCover = ?, " \
+								"rating = ?, fileSize = ?, lastModified = ?, inode = ? WHERE uri = ?");
+	// Rows are written in the same order they were added
+	this->writeFileRefs();
+	this->beginRow();
+	_updateFileRef.addBindValue(row.trackNumber);
+	_updateFileRef.addBindValue(row.title);
+	_updateFileRef.addBindValue(row.artist);
+	_updateFileRef.addBindValue(row.artistNormalized);
+	_updateFileRef.addBindValue(row.album);
+	_updateFileRef.addBindValue(row.albumNormalized);
+	_updateFileRef.addBindValue(row.year);
+	_updateFileRef.addBindValue(row.artistAlbum);
+	_updateFileRef.addBindValue(row.length);
+	_updateFileRef.addBindValue(row.disc);
+	if (row.internalCover) {
+		_updateFileRef.addBindValue(row.uri);
+	} else {
+		_updateFileRef.addBindValue(QVariant());
+	}
+	_updateFileRef.addBindValue(row.rating);
+	_updateFileRef.addBindValue(row.stamp.size);
+	_updateFileRef.addBindValue(row.stamp.lastModified);
+	_updateFileRef.addBindValue(row.stamp.inode);
+	_updateFileRef.addBindValue(row.uri);
+	this->endRow(_updateFileRef);
+}
+
+void BatchWriter::removeFileRef(const QString &absFilePath)
+{
+	prepareOnce(_removeFileRef, "DELETE FROM cache WHERE uri = ?");
+	this->writeFileRefs();
+	this->beginRow();
+	_removeFileRef.addBindValue(absFilePath);
+	this->endRow(_removeFileRef);
+}
+
+/** Inserts a remote track. */
+void BatchWriter::insertTrack(const TrackDAO &track)
+{
+	prepareOnce(_insertTrack, "INSERT INTO cache (uri, trackNumber, trackTitle, artist, artistNormalized, album, albumNormalized, " \
+							  "albumYear, artistAlbum, trackLength, rating, disc, host, icon) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+
+	// Artists and albums are found by triggers from the same columns as tracks read from files
+	QString artistAlbum = track.artistAlbum().isEmpty() ? track.artist() : track.artistAlbum();
+
+	this->beginRow();
+	_insertTrack.addBindValue(track.uri());
+	_insertTrack.addBindValue(track.trackNumber());
+	_insertTrack.addBindValue(track.title());
+	_insertTrack.addBindValue(track.artist());
+	_insertTrack.addBindValue(SqlDatabase::normalizeField(artistAlbum));
+	_insertTrack.addBindValue(track.album());
+	_insertTrack.addBindValue(SqlDatabase::normalizeField(track.album()));
+	_insertTrack.addBindValue(track.year());
+	_insertTrack.addBindValue(artistAlbum);
+	_insertTrack.addBindValue(track.length());
+	_insertTrack.addBindValue(track.rating());
+	_insertTrack.addBindValue(track.disc());
+	_insertTrack.addBindValue(track.host());
+	_insertTrack.addBindValue(track.icon());
+	this->endRow(_insertTrack);
+}
+
+/** Inserts a track in a playlist at a position, the uri is shared with other playlists. */
+void BatchWriter::insertPlaylistTrack(uint playlistId, qint64 position, const QString &uri)
+{
+	prepareOnce(_insertUri, "INSERT OR IGNORE INTO uris (uri) VALUES (?)");
+	prepareOnce(_insertPlaylistTrack, "INSERT OR REPLACE INTO playlistTracks (playlistId, position, trackId) " \
+									  "SELECT ?, ?, id FROM uris WHERE uri = ?");
+	this->beginRow();
+	_insertUri.addBindValue(uri);
+	if (!_insertUri.exec()) {
+		qDebug() << Q_FUNC_INFO << _insertUri.lastError();
+		_hasError = true;
+	}
+	_insertPlaylistTrack.addBindValue(playlistId);
+	_insertPlaylistTrack.addBindValue(position);
+	_insertPlaylistTrack.addBindValue(uri);
+	this->endRow(_insertPlaylistTrack);
+}
+
+void BatchWriter::removePlaylistTrack(uint playlistId, qint64 position)
+{
+	prepareOnce(_removePlaylistTrack, "DELETE FROM playlistTracks WHERE playlistId = ? AND position = ?");
+	this->beginRow();
+	_removePlaylistTrack.addBindValue(playlistId);
+	_removePlaylistTrack.addBindValue(position);
+	this->endRow(_removePlaylistTrack);
+}
+
+/** Writes pending rows and commits the transaction opened by this writer. Returns false if one row has failed. */
+bool BatchWriter::flush()
+{
+	this->writeFileRefs();
+
+	if (_ownsTransaction) {
+		_db->commit();
+		_ownsTransaction = false;
+	}
+	_rowsInTransaction = 0;
+
+	bool ok = !_hasError;
+	_hasError = false;
+	return ok;
+}
+
+void BatchWriter::beginRow()
+{
+	// Fails if the caller has already opened a transaction: rows will be committed with it
+	if (!_ownsTransaction && _rowsInTransaction == 0) {
+		_ownsTransaction = _db->transaction();
+	}
+}
+
+void BatchWriter::bindFileRef(QSqlQuery &query, const CacheRow &row)
+{
+	query.addBindValue(row.uri);
+	query.addBindValue(row.trackNumber);
+	query.addBindValue(row.title);
+	query.addBindValue(row.artist);
+	query.addBindValue(row.artistNormalized);
+	query.addBindValue(row.album);
+	query.addBindValue(row.albumNormalized);
+	query.addBindValue(row.year);
+	query.addBindValue(row.artistAlbum);
+	query.addBindValue(row.length);
+	query.addBindValue(row.disc);
+	if (row.internalCover) {
+		query.addBindValue(row.uri);
+	} else {
+		query.addBindValue(QVariant());
+	}
+	query.addBindValue(row.rating);
+	query.addBindValue(row.stamp.size);
+	query.addBindValue(row.stamp.lastModified);
+	query.addBindValue(row.stamp.inode);
+}
+
+void BatchWriter::endRow(QSqlQuery &query)
+{
+	if (!query.exec()) {
+		qDebug() << Q_FUNC_INFO << query.lastError();
+		_hasError = true;
+	}
+	if (++_rowsInTransaction >= _rowsPerTransaction && _ownsTransaction) {
+		_db->commit();
+		_ownsTransaction = false;
+		_rowsInTransaction = 0;
+	}
+}
+
+void BatchWriter::writeFileRefs()
+{
+	if (_pendingFileRefs.size() < fileRefsPerStatement) {
+		// Last rows don't fill a multi-row statement
+		if (!_pendingFileRefs.isEmpty()) {
+			prepareOnce(_saveFileRef, insertFileRef + fileRefValues);
+		}
+		for (const CacheRow &row : _pendingFileRefs) {
+			this->beginRow();
+			this->bindFileRef(_saveFileRef, row);
+			this->endRow(_saveFileRef);
+		}
+		_pendingFileRefs.clear();
+		return;
+	}
+
+	if (_saveFileRefs.lastQuery().isEmpty()) {
+		QStringList values;
+		for (int i = 0; i < fileRefsPerStatement; i++) {
+			values << fileRefValues;
+		}
+		prepareOnce(_saveFileRefs, insertFileRef + values.join(", "));
+	}
+
+	this->beginRow();
+	for (const CacheRow &row : _pendingFileRefs) {
+		this->bindFileRef(_saveFileRefs, row);
+	}
+	_pendingFileRefs.clear();
+
+	// endRow() counts the last row of the chunk
+	_rowsInTransaction += fileRefsPerStatement - 1;
+	this->endRow(_saveFileRefs);
+}
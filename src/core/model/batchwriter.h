@@ -0,0 +1,75 @@
+#ifndef BATCHWRITER_H
+#define BATCHWRITER_H
+
+#include "../miamcore_global.h"
+#include "sqldatabase.h"
+
+#include <QList>
+#include <QSqlQuery>
+
+/**
+ * \brief		The BatchWriter class writes many rows in the database with statements which are prepared only once.
+ * \details		Rows for table "cache" are grouped by chunks and inserted with a single multi-row INSERT. Other rows reuse their
+ *				prepared statement. Rows are committed every rowsPerTransaction: if a transaction was already opened by the caller,
+ *				the writer joins it and leaves the commit to the caller. Remaining rows are written by flush() or by the destructor.
+ *				Like SqlDatabase, a writer can only be used in the thread which has opened the connection.
+ * \author      Matthieu Bachelier
+ * \copyright   GNU General Public License v3
+ */
+class MIAMCORE_LIBRARY BatchWriter
+{
+private:
+	SqlDatabase *_db;
+	int _rowsPerTransaction;
+	int _rowsInTransaction;
+	bool _ownsTransaction;
+	bool _hasError;
+
+	/** Rows of table "cache" waiting for a full multi-row INSERT. */
+	QList<CacheRow> _pendingFileRefs;
+
+	QSqlQuery _saveFileRef;
+	QSqlQuery _saveFileRefs;
+	QSqlQuery _updateFileRef;
+	QSqlQuery _removeFileRef;
+	QSqlQuery _insertTrack;
+	QSqlQuery _insertUri;
+	QSqlQuery _insertPlaylistTrack;
+	QSqlQuery _removePlaylistTrack;
+
+public:
+	explicit BatchWriter(SqlDatabase *db, int rowsPerTransaction = 500);
+
+	~BatchWriter();
+
+	/** Inserts or replaces a local track previously filled by SqlDatabase::readFileRef. */
+	void saveFileRef(const CacheRow &row);
+
+	/** Updates tags of a local track which is already in the library, other columns like cover are kept. */
+	void updateFileRef(const CacheRow &row);
+
+	void removeFileRef(const QString &absFilePath);
+
+	/** Inserts a remote track. */
+	void insertTrack(const TrackDAO &track);
+
+	/** Inserts a track in a playlist at a position, the uri is shared with other playlists. */
+	void insertPlaylistTrack(uint playlistId, qint64 position, const QString &uri);
+
+	void removePlaylistTrack(uint playlistId, qint64 position);
+
+	/** Writes pending rows and commits the transaction opened by this writer. Returns false if one row has failed. */
+	bool flush();
+
+private:
+	void beginRow();
+
+	void bindFileRef(QSqlQuery &query, const CacheRow &row);
+
+	void endRow(QSqlQuery &query);
+
+	/** Writes rows waiting for table "cache", with a multi-row INSERT if the chunk is full. */
+	void writeFileRefs();
+};
+
+#endif // BATCHWRITER_H
@@ -1,12 +1,17 @@
 #include "sqldatabase.h"
+#include "batchwriter.h"
 
 #include <QApplication>
+#include <QDateTime>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QMutex>
 #include <QRegularExpression>
 #include <QSqlError>
 #include <QSqlRecord>
 #include <QSqlQuery>
 #include <QStandardPaths>
+#include <QThreadStorage>
 #include <QTimer>
 
 #include <QtDebug>
@@ -14,15 +19,82 @@
 #include "cover.h"
 #include "settingsprivate.h"
 #include "musicsearchengine.h"
+#include "playlistchecksum.h"
 #include "filehelper.h"
 
 #include <chrono>
 #include <random>
 
+#if defined(Q_OS_UNIX)
+#include <sys/stat.h>
+#endif
+
+/** Version stored in PRAGMA user_version, incremented each time the schema is modified. */
+static const int schemaVersion = 8;
+
+/** Room left between two tracks of a playlist when it's written completely. */
+static const qint64 playlistPositionGap = 1024;
+
+FileStamp FileStamp::fromFileInfo(const QFileInfo &fileInfo)
+{
+	FileStamp stamp;
+#if defined(Q_OS_UNIX)
+	// One stat() gives everything, QFileInfo would need another one for the inode
+	struct stat st;
+	if (::stat(QFile::encodeName(fileInfo.absoluteFilePath()).constData(), &st) == 0) {
+		stamp.size = st.st_size;
+		stamp.lastModified = static_cast<qint64>(st.st_mtime) * 1000;
+		stamp.inode = st.st_ino;
+	}
+#else
+	stamp.size = fileInfo.size();
+	stamp.lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+#endif
+	return stamp;
+}
+
+/** Write transactions of every connection are serialized, so that a scan and the UI never compete for the lock of the file. */
+static QMutex *writeMutex()
+{
+	static QMutex mutex(QMutex::Recursive);
+	return &mutex;
+}
+
+static QAtomicInt openedInLastSecond(0);
+
+/** Counts connections opened in the last second, to find code which should use reader() instead. */
+static void countOpenedConnection()
+{
+	static QMutex mutex;
+	static QElapsedTimer window;
+	static int openedInWindow = 0;
+
+	QMutexLocker locker(&mutex);
+	if (!window.isValid()) {
+		window.start();
+	} else if (window.elapsed() >= 1000) {
+		openedInLastSecond.store(openedInWindow);
+		if (openedInWindow > 20) {
+			qDebug() << Q_FUNC_INFO << openedInWindow << "connections were opened in the last second";
+		}
+		openedInWindow = 0;
+		window.restart();
+	}
+	openedInWindow++;
+}
+
 SqlDatabase::SqlDatabase(QObject *parent)
+	: SqlDatabase(OM_ReadWrite, parent)
+{}
+
+SqlDatabase::SqlDatabase(OpenMode mode, QObject *parent)
 	: QObject(parent)
 	, QSqlDatabase("QSQLITE")
+	, _openMode(mode)
+	, _isInTransaction(false)
 {
+	countOpenedConnection();
+
 	SettingsPrivate *settings = SettingsPrivate::instance();
 	QString path("%1/%2/%3");
 	path = path.arg(QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation),
@@ -41,6 +113,9 @@ SqlDatabase::SqlDatabase(QObject *parent)
 
 	setDatabaseName(dbPath);
 
+	// Wait for another connection instead of failing immediately with "database is locked"
+	setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+
 	// DB folder exists but DB file doesn't: can be first launch or file was deleted manually
 	if (dbFile.exists()) {
 		this->init();
@@ -72,19 +147,45 @@ SqlDatabase::SqlDatabase(QObject *parent)
 		//t->start(5000);
 		//connect(t, &QTimer::timeout, this, &SqlDatabase::rebuild);
 	}
+	this->upgradeSchema();
 
+	// Views only read the library: they can't lock the file while a scan is writing
+	if (_openMode == OM_ReadOnly) {
+		exec("PRAGMA query_only = 1");
+	}
 }
 
 SqlDatabase::~SqlDatabase()
 {
+	if (_isInTransaction) {
+		this->rollback();
+	}
+	_preparedQueries.clear();
 	if (isOpen()) {
 		close();
 	}
 }
 
+/** Read-only connection of the current thread. It's opened once then reused, and closed when the thread exits. */
+SqlDatabase* SqlDatabase::reader()
+{
+	static QThreadStorage<SqlDatabase*> readers;
+	if (!readers.hasLocalData()) {
+		readers.setLocalData(new SqlDatabase(OM_ReadOnly));
+	}
+	return readers.localData();
+}
+
+/** Number of connections opened during the last full second. */
+int SqlDatabase::openedLastSecond()
+{
+	return openedInLastSecond.load();
+}
+
 void SqlDatabase::reset()
 {
 	exec("DELETE FROM cache");
+	exec("DELETE FROM covers");
 	exec("DROP INDEX indexArtist");
 	exec("DROP INDEX indexAlbum");
 	exec("DROP INDEX indexPath");
@@ -96,7 +197,186 @@ void SqlDatabase::init()
 	this->setPragmas();
 }
 
-uint SqlDatabase::insertIntoTablePlaylists(const PlaylistDAO &playlist, const QStringList &tracks, bool isOverwriting)
+/** Starts a write transaction, other connections wait until it's committed: files must be read before. Returns false if one is already opened. */
+bool SqlDatabase::transaction()
+{
+	writeMutex()->lock();
+	if (!_isInTransaction && QSqlDatabase::transaction()) {
+		_isInTransaction = true;
+		return true;
+	}
+	writeMutex()->unlock();
+	return false;
+}
+
+bool SqlDatabase::commit()
+{
+	bool b = QSqlDatabase::commit();
+	if (_isInTransaction) {
+		_isInTransaction = false;
+		writeMutex()->unlock();
+	}
+	return b;
+}
+
+bool SqlDatabase::rollback()
+{
+	bool b = QSqlDatabase::rollback();
+	if (_isInTransaction) {
+		_isInTransaction = false;
+		writeMutex()->unlock();
+	}
+	return b;
+}
+
+/** Applies every missing step to an existing database. New databases are created with version 0 then upgraded too. */
+void SqlDatabase::upgradeSchema()
+{
+	auto userVersion = [this]() -> int {
+		QSqlQuery version = QSqlDatabase::exec("PRAGMA user_version");
+		return version.next() ? version.record().value(0).toInt() : 0;
+	};
+	if (userVersion() >= schemaVersion) {
+		return;
+	}
+
+	// Connections opened at the same time by other threads wait here, then read the version written by the first one
+	if (!this->transaction()) {
+		return;
+	}
+	int fromVersion = userVersion();
+	if (fromVersion >= schemaVersion) {
+		this->rollback();
+		return;
+	}
+
+	// On the first error, every step is cancelled and the version is kept: the upgrade is tried again next time
+	bool isUpgraded = true;
+	auto step = [this, &isUpgraded](const QString &statement) -> QSqlQuery {
+		if (!isUpgraded) {
+			return QSqlQuery(*this);
+		}
+		QSqlQuery query = QSqlDatabase::exec(statement);
+		if (query.lastError().isValid()) {
+			qDebug() << Q_FUNC_INFO << statement << query.lastError().text();
+			isUpgraded = false;
+		}
+		return query;
+	};
+
+	if (fromVersion < 1) {
+		// Stamps of local files, to skip unchanged tracks when rescanning
+		step("ALTER TABLE cache ADD COLUMN fileSize INTEGER");
+		step("ALTER TABLE cache ADD COLUMN lastModified INTEGER");
+		step("ALTER TABLE cache ADD COLUMN inode INTEGER");
+	}
+	if (fromVersion < 2) {
+		// Number of entries found in each music location, to estimate progress of the next scan
+		step("CREATE TABLE IF NOT EXISTS scanStatistics (location varchar(255) PRIMARY KEY ASC, entryCount INTEGER)");
+	}
+	if (fromVersion < 3) {
+		// Artists and albums are stored once, tracks in table "cache" reference them with integer keys
+		step("CREATE TABLE IF NOT EXISTS artists (id INTEGER PRIMARY KEY, name varchar(255), normalizedName varchar(255) UNIQUE, " \
+			 "icon varchar(255), host varchar(255))");
+		step("CREATE TABLE IF NOT EXISTS albums (id INTEGER PRIMARY KEY, artistId INTEGER, name varchar(255), normalizedName varchar(255), " \
+			 "year INTEGER, icon varchar(255), host varchar(255), UNIQUE (artistId, normalizedName, year))");
+		step("ALTER TABLE cache ADD COLUMN artistId INTEGER");
+		step("ALTER TABLE cache ADD COLUMN albumId INTEGER");
+
+		step("INSERT OR IGNORE INTO artists (name, normalizedName, icon, host) " \
+			 "SELECT artistAlbum, IFNULL(artistNormalized, ''), icon, host FROM cache");
+		step("INSERT OR IGNORE INTO albums (artistId, name, normalizedName, year, icon, host) " \
+			 "SELECT ar.id, c.album, IFNULL(c.albumNormalized, ''), IFNULL(c.albumYear, ''), c.icon, c.host FROM cache c " \
+			 "INNER JOIN artists ar ON ar.normalizedName = IFNULL(c.artistNormalized, '')");
+		step("UPDATE cache SET artistId = (SELECT id FROM artists WHERE normalizedName = IFNULL(cache.artistNormalized, '')), " \
+			 "albumId = (SELECT al.id FROM albums al INNER JOIN artists ar ON al.artistId = ar.id " \
+			 "WHERE ar.normalizedName = IFNULL(cache.artistNormalized, '') AND al.normalizedName = IFNULL(cache.albumNormalized, '') " \
+			 "AND al.year = IFNULL(cache.albumYear, ''))");
+
+		// Every writer of table "cache" keeps artists and albums in sync, without knowing about them
+		QString linkTrack = "INSERT OR IGNORE INTO artists (name, normalizedName, icon, host) " \
+							"VALUES (NEW.artistAlbum, IFNULL(NEW.artistNormalized, ''), NEW.icon, NEW.host); " \
+							"INSERT OR IGNORE INTO albums (artistId, name, normalizedName, year, icon, host) " \
+							"SELECT id, NEW.album, IFNULL(NEW.albumNormalized, ''), IFNULL(NEW.albumYear, ''), NEW.icon, NEW.host " \
+							"FROM artists WHERE normalizedName = IFNULL(NEW.artistNormalized, ''); " \
+							"UPDATE cache SET artistId = (SELECT id FROM artists WHERE normalizedName = IFNULL(NEW.artistNormalized, '')), " \
+							"albumId = (SELECT al.id FROM albums al INNER JOIN artists ar ON al.artistId = ar.id " \
+							"WHERE ar.normalizedName = IFNULL(NEW.artistNormalized, '') AND al.normalizedName = IFNULL(NEW.albumNormalized, '') " \
+							"AND al.year = IFNULL(NEW.albumYear, '')) WHERE rowid = NEW.rowid; ";
+		QString unlinkTrack = "DELETE FROM albums WHERE id = OLD.albumId AND NOT EXISTS (SELECT 1 FROM cache WHERE albumId = OLD.albumId); " \
+							  "DELETE FROM artists WHERE id = OLD.artistId AND NOT EXISTS (SELECT 1 FROM cache WHERE artistId = OLD.artistId); ";
+		step("CREATE TRIGGER IF NOT EXISTS linkInsertedTrack AFTER INSERT ON cache BEGIN " + linkTrack + "END");
+		step("CREATE TRIGGER IF NOT EXISTS linkUpdatedTrack AFTER UPDATE OF artistAlbum, artistNormalized, album, albumNormalized, albumYear " \
+			 "ON cache BEGIN " + linkTrack + unlinkTrack + "END");
+		step("CREATE TRIGGER IF NOT EXISTS unlinkDeletedTrack AFTER DELETE ON cache BEGIN " + unlinkTrack + "END");
+
+		// Grouping tracks by album then by disc, and removing empty albums and artists
+		step("CREATE INDEX IF NOT EXISTS indexAlbumId ON cache (albumId, disc)");
+		step("CREATE INDEX IF NOT EXISTS indexArtistId ON cache (artistId)");
+	}
+	if (fromVersion < 4) {
+		// Full-text index for type-ahead search: words are matched by prefix, without case nor accents like normalizeField
+		step("CREATE VIRTUAL TABLE IF NOT EXISTS cacheSearch USING fts4(trackTitle, artist, album, " \
+			 "tokenize=unicode61 \"remove_diacritics=1\", prefix=\"1,2,3\")");
+		step("INSERT INTO cacheSearch (docid, trackTitle, artist, album) SELECT rowid, trackTitle, artist, album FROM cache");
+
+		QString indexTrack = "INSERT INTO cacheSearch (docid, trackTitle, artist, album) VALUES (NEW.rowid, NEW.trackTitle, NEW.artist, NEW.album); ";
+		QString unindexTrack = "DELETE FROM cacheSearch WHERE docid = OLD.rowid; ";
+		step("CREATE TRIGGER IF NOT EXISTS indexInsertedTrack AFTER INSERT ON cache BEGIN " + indexTrack + "END");
+		step("CREATE TRIGGER IF NOT EXISTS indexUpdatedTrack AFTER UPDATE OF trackTitle, artist, album ON cache BEGIN " + unindexTrack + indexTrack + "END");
+		step("CREATE TRIGGER IF NOT EXISTS unindexDeletedTrack AFTER DELETE ON cache BEGIN " + unindexTrack + "END");
+
+		// Jumping to the first artist starting with a letter
+		step("CREATE INDEX IF NOT EXISTS indexArtistName ON artists (name COLLATE NOCASE)");
+	}
+	if (fromVersion < 5) {
+		// A track can be in many playlists, many times. Rows are ordered by a sparse position and reference an id for each uri
+		step("CREATE TABLE IF NOT EXISTS uris (id INTEGER PRIMARY KEY, uri varchar(255) UNIQUE NOT NULL)");
+		step("ALTER TABLE playlistTracks RENAME TO oldPlaylistTracks");
+		step("CREATE TABLE playlistTracks (playlistId INTEGER NOT NULL, position INTEGER NOT NULL, trackId INTEGER NOT NULL, " \
+			 "PRIMARY KEY (playlistId, position), FOREIGN KEY(playlistId) REFERENCES playlists(id) ON DELETE CASCADE) WITHOUT ROWID");
+		step("INSERT OR IGNORE INTO uris (uri) SELECT uri FROM oldPlaylistTracks");
+
+		// Tracks were ordered by insertion: rowid keeps this order, and leaves room between two tracks of a playlist
+		step(QString("INSERT INTO playlistTracks (playlistId, position, trackId) SELECT o.playlistId, o.rowid * %1, u.id " \
+					 "FROM oldPlaylistTracks o INNER JOIN uris u ON u.uri = o.uri WHERE o.playlistId IS NOT NULL").arg(playlistPositionGap));
+		step("DROP TABLE oldPlaylistTracks");
+	}
+	if (fromVersion < 6) {
+		// Finding a duplicate playlist before saving
+		step("CREATE INDEX IF NOT EXISTS indexPlaylistChecksum ON playlists (checksum)");
+	}
+	if (fromVersion < 7) {
+		// Checksums are updated row by row by playlists: saved ones are computed again each time the method changes
+		QSqlQuery playlists = step("SELECT id FROM playlists");
+		QList<uint> playlistIds;
+		while (playlists.next()) {
+			playlistIds << playlists.record().value(0).toUInt();
+		}
+		QSqlQuery update(*this);
+		update.prepare("UPDATE playlists SET checksum = ? WHERE id = ?");
+		for (uint playlistId : playlistIds) {
+			update.addBindValue(QString::number(PlaylistChecksum::checksum(this->selectPlaylistTracks(playlistId, false))));
+			update.addBindValue(playlistId);
+			if (isUpgraded && !update.exec()) {
+				qDebug() << Q_FUNC_INFO << update.lastError().text();
+				isUpgraded = false;
+			}
+		}
+	}
+	if (fromVersion < 8) {
+		// Stamps of external covers, to save a cover again when it was added or replaced in a folder with unchanged tracks
+		step("CREATE TABLE IF NOT EXISTS covers (path varchar(255) PRIMARY KEY ASC, fileSize INTEGER, lastModified INTEGER, inode INTEGER)");
+	}
+	step(QString("PRAGMA user_version = %1").arg(schemaVersion));
+	if (isUpgraded) {
+		this->commit();
+	} else {
+		this->rollback();
+	}
+}
+
+uint SqlDatabase::insertIntoTablePlaylists(const PlaylistDAO &playlist, const PlaylistTracksDelta &tracks, bool isOverwriting)
 {
 	if (!isOpen()) {
 		open();
@@ -104,12 +384,14 @@ uint SqlDatabase::insertIntoTablePlaylists(const PlaylistDAO &playlist, const QS
 	}
 
 	static std::uniform_int_distribution<uint> tt;
-	this->transaction();
+	// The playlist and its tracks are saved together, or not at all
+	bool ownsTransaction = this->transaction();
 	uint id = 0;
+	bool isSaved = false;
 	if (isOverwriting) {
 		if (this->updateTablePlaylist(playlist)) {
 			id = playlist.id().toUInt();
-			this->insertIntoTablePlaylistTracks(id, tracks, isOverwriting);
+			isSaved = this->insertIntoTablePlaylistTracks(id, tracks);
 		}
 	} else {
 		if (playlist.id().isEmpty()) {
@@ -129,38 +411,53 @@ uint SqlDatabase::insertIntoTablePlaylists(const PlaylistDAO &playlist, const QS
 		insert.addBindValue(playlist.host());
 		insert.addBindValue(playlist.checksum());
 		if (insert.exec()) {
-			this->insertIntoTablePlaylistTracks(id, tracks);
+			isSaved = this->insertIntoTablePlaylistTracks(id, tracks);
 		}
 	}
-	this->commit();
-	return id;
+	if (ownsTransaction) {
+		if (isSaved) {
+			this->commit();
+		} else {
+			this->rollback();
+		}
+	}
+	return isSaved ? id : 0;
 }
 
-bool SqlDatabase::insertIntoTablePlaylistTracks(uint playlistId, const QStringList &tracks, bool isOverwriting)
+/** Writes changes of a playlist: only tracks which were moved, inserted or removed since the last save. */
+bool SqlDatabase::insertIntoTablePlaylistTracks(uint playlistId, const PlaylistTracksDelta &tracks)
 {
 	if (!isOpen()) {
 		open();
 		this->setPragmas();
 	}
 
-	this->transaction();
-	if (isOverwriting) {
+	// Joins the transaction of insertIntoTablePlaylists(): only the function which has opened it commits
+	bool ownsTransaction = this->transaction();
+	bool b = true;
+	if (tracks.isComplete) {
 		QSqlQuery deleteTracks(*this);
 		deleteTracks.prepare("DELETE FROM playlistTracks WHERE playlistId = ?");
 		deleteTracks.addBindValue(playlistId);
-		deleteTracks.exec();
+		b = deleteTracks.exec();
 	}
 	/// TODO remote tracks?
-	for (QString track : tracks) {
-		QSqlQuery insert(*this);
-		insert.prepare("INSERT INTO playlistTracks (uri, playlistId) VALUES (?, ?)");
-		insert.addBindValue(track);
-		insert.addBindValue(playlistId);
-
-		insert.exec();
+	BatchWriter writer(this);
+	for (qint64 position : tracks.removedPositions) {
+		writer.removePlaylistTrack(playlistId, position);
 	}
-	this->commit();
-	return lastError().type() == QSqlError::NoError;
+	for (const QPair<qint64, QString> &track : tracks.insertedTracks) {
+		writer.insertPlaylistTrack(playlistId, track.first, track.second);
+	}
+	b = writer.flush() && b;
+	if (ownsTransaction) {
+		if (b) {
+			this->commit();
+		} else {
+			this->rollback();
+		}
+	}
+	return b;
 }
 
 bool SqlDatabase::insertIntoTableTracks(const TrackDAO &track)
@@ -170,29 +467,9 @@ bool SqlDatabase::insertIntoTableTracks(const TrackDAO &track)
 		this->setPragmas();
 	}
 
-	QSqlQuery insertTrack(*this);
-	insertTrack.prepare("INSERT INTO cache (uri, trackNumber, trackTitle, artist, album, artistAlbum, trackLength, rating, " \
-		"disc, host, icon) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
-
-	QString artistAlbum = track.artistAlbum().isEmpty() ? track.artist() : track.artistAlbum();
-	QString artistNorm = this->normalizeField(artistAlbum);
-	QString albumNorm = this->normalizeField(track.album());
-	uint artistId = qHash(artistNorm);
-	uint albumId = artistId + qHash(albumNorm, 1);
-
-	insertTrack.addBindValue(track.uri());
-	insertTrack.addBindValue(track.trackNumber());
-	insertTrack.addBindValue(track.title());
-	insertTrack.addBindValue(artistId);
-	insertTrack.addBindValue(albumId);
-	insertTrack.addBindValue(track.artistAlbum());
-	insertTrack.addBindValue(track.length());
-	insertTrack.addBindValue(track.rating());
-	insertTrack.addBindValue(track.disc());
-	insertTrack.addBindValue(track.host());
-	insertTrack.addBindValue(track.icon());
-	bool b = insertTrack.exec();
-	return b;
+	BatchWriter writer(this);
+	writer.insertTrack(track);
+	return writer.flush();
 }
 
 bool SqlDatabase::insertIntoTableTracks(const std::list<TrackDAO> &tracks)
@@ -202,13 +479,11 @@ bool SqlDatabase::insertIntoTableTracks(const std::list<TrackDAO> &tracks)
 		this->setPragmas();
 	}
 
-	bool b = true;
+	BatchWriter writer(this);
 	for (std::list<TrackDAO>::const_iterator it = tracks.cbegin(); it != tracks.cend(); ++it) {
-		TrackDAO track = *it;
-		bool g = this->insertIntoTableTracks(track);
-		b = b && g;
+		writer.insertTrack(*it);
 	}
-	return b;
+	return writer.flush();
 }
 
 void SqlDatabase::removeCoverForAlbum(bool internalCover, const QString &artistNorm, const QString &albumNorm)
@@ -246,6 +521,9 @@ bool SqlDatabase::removePlaylist(uint playlistId)
 	remove.prepare("DELETE FROM playlists WHERE id = :id");
 	remove.bindValue(":id", playlistId);
 	remove.exec();
+
+	// Uris are shared between playlists
+	exec("DELETE FROM uris WHERE id NOT IN (SELECT trackId FROM playlistTracks)");
 	return this->commit();
 }
 
@@ -267,10 +545,25 @@ void SqlDatabase::removePlaylistsFromHost(const QString &host)
 	remove.prepare("DELETE FROM playlists WHERE host LIKE :h");
 	remove.bindValue(":h", host);
 	remove.exec();
+	exec("DELETE FROM uris WHERE id NOT IN (SELECT trackId FROM playlistTracks)");
 
 	this->commit();
 }
 
+/** Removes local tracks which don't exist anymore on the filesystem. */
+void SqlDatabase::removeFileRefs(const QStringList &absFilePaths)
+{
+	if (!isOpen()) {
+		open();
+		this->setPragmas();
+	}
+
+	BatchWriter writer(this);
+	for (QString absFilePath : absFilePaths) {
+		writer.removeFileRef(absFilePath);
+	}
+}
+
 void SqlDatabase::removeRecordsFromHost(const QString &host)
 {
 	if (!isOpen()) {
@@ -298,7 +591,7 @@ Cover* SqlDatabase::selectCoverFromURI(const QString &uri)
 	Cover *c = nullptr;
 
 	QSqlQuery selectCover(*this);
-	selectCover.prepare("SELECT DISTINCT internalCover, cover FROM cache WHERE uri = ?");
+	selectCover.prepare("SELECT DISTINCT internalCover, cover, album FROM cache WHERE uri = ?");
 	selectCover.addBindValue(uri);
 	if (selectCover.exec() && selectCover.next()) {
 		QString internalCover = selectCover.record().value(0).toString();
@@ -309,15 +602,15 @@ Cover* SqlDatabase::selectCoverFromURI(const QString &uri)
 			if (internalCover.isEmpty()) {
 				c = new Cover(coverPath);
 			} else {
-				FileHelper fh(uri);
+				FileHelper fh(uri, FileHelper::OM_TagsOnly);
 				c = fh.extractCover();
 			}
 		} else {
 			// No direct cover for this file, let's search for the entire album if one track has an inner cover
-			selectCover.prepare("SELECT uri FROM cache WHERE album = ? AND internalCover <> NULL LIMIT 1");
+			selectCover.prepare("SELECT uri FROM cache WHERE album = ? AND internalCover IS NOT NULL LIMIT 1");
 			selectCover.addBindValue(album);
 			if (selectCover.exec() && selectCover.next()) {
-				FileHelper fh(selectCover.record().value(0).toString());
+				FileHelper fh(selectCover.record().value(0).toString(), FileHelper::OM_TagsOnly);
 				c = fh.extractCover();
 			}
 		}
@@ -333,8 +626,8 @@ QStringList SqlDatabase::selectPlaylistTracks(uint playlistID, bool withPrefix)
 	}
 
 	QStringList tracks;
-	QSqlQuery results(*this);
-	results.prepare("SELECT uri FROM playlistTracks WHERE playlistId = ?");
+	QSqlQuery &results = this->preparedQuery("SELECT u.uri FROM playlistTracks p INNER JOIN uris u ON u.id = p.trackId " \
+											 "WHERE p.playlistId = ? ORDER BY p.position");
 	results.addBindValue(playlistID);
 	if (results.exec()) {
 		while (results.next()) {
@@ -346,6 +639,80 @@ QStringList SqlDatabase::selectPlaylistTracks(uint playlistID, bool withPrefix)
 			}
 		}
 	}
+	results.finish();
+	return tracks;
+}
+
+/** Returns tracks of a saved playlist with their tags from the library. Tracks which aren't in the library only have an uri. */
+QList<TrackDAO> SqlDatabase::selectPlaylistTracksFromLibrary(uint playlistId, QList<qint64> *positions)
+{
+	if (!isOpen()) {
+		open();
+		this->setPragmas();
+	}
+
+	QList<TrackDAO> tracks;
+	QSqlQuery &results = this->preparedQuery("SELECT p.position, u.uri, c.rowid, c.trackNumber, c.trackTitle, c.artist, c.album, " \
+											 "c.trackLength, c.rating, c.albumYear " \
+											 "FROM playlistTracks p INNER JOIN uris u ON u.id = p.trackId LEFT JOIN cache c ON c.uri = u.uri " \
+											 "WHERE p.playlistId = ? ORDER BY p.position");
+	results.addBindValue(playlistId);
+	if (results.exec()) {
+		while (results.next()) {
+			TrackDAO track;
+			int j = -1;
+			qint64 position = results.value(++j).toLongLong();
+			track.setUri(results.value(++j).toString());
+			// Id stays empty when the track isn't in the library
+			if (!results.value(++j).isNull()) {
+				track.setId(results.value(j).toString());
+				track.setTrackNumber(results.value(++j).toString());
+				track.setTitle(results.value(++j).toString());
+				track.setArtist(results.value(++j).toString());
+				track.setAlbum(results.value(++j).toString());
+				track.setLength(results.value(++j).toString());
+				track.setRating(results.value(++j).toInt());
+				track.setYear(results.value(++j).toString());
+			}
+			tracks << track;
+			if (positions) {
+				positions->append(position);
+			}
+		}
+	}
+	results.finish();
+	return tracks;
+}
+
+/** Returns tracks in the same order as uris, with their tags when they're in the library. Others only have an uri. */
+QList<TrackDAO> SqlDatabase::selectTracksFromLibrary(const QStringList &uris)
+{
+	if (!isOpen()) {
+		open();
+		this->setPragmas();
+	}
+
+	QList<TrackDAO> tracks;
+	QSqlQuery &results = this->preparedQuery("SELECT rowid, trackNumber, trackTitle, artist, album, trackLength, rating, albumYear " \
+											 "FROM cache WHERE uri = ?");
+	for (const QString &uri : uris) {
+		TrackDAO track;
+		track.setUri(uri);
+		results.addBindValue(uri);
+		if (results.exec() && results.next()) {
+			int j = -1;
+			track.setId(results.value(++j).toString());
+			track.setTrackNumber(results.value(++j).toString());
+			track.setTitle(results.value(++j).toString());
+			track.setArtist(results.value(++j).toString());
+			track.setAlbum(results.value(++j).toString());
+			track.setLength(results.value(++j).toString());
+			track.setRating(results.value(++j).toInt());
+			track.setYear(results.value(++j).toString());
+		}
+		results.finish();
+		tracks << track;
+	}
 	return tracks;
 }
 
@@ -369,6 +736,40 @@ PlaylistDAO SqlDatabase::selectPlaylist(uint playlistId)
 	return playlist;
 }
 
+/** Returns a saved playlist which has exactly the same tracks, or an empty playlist. */
+PlaylistDAO SqlDatabase::selectPlaylistByChecksum(quint64 checksum, const QStringList &uris)
+{
+	if (!isOpen()) {
+		open();
+		this->setPragmas();
+	}
+
+	QList<PlaylistDAO> candidates;
+	QSqlQuery &results = this->preparedQuery("SELECT id, title, checksum, icon, background FROM playlists WHERE checksum = ?");
+	results.addBindValue(QString::number(checksum));
+	if (results.exec()) {
+		while (results.next()) {
+			PlaylistDAO playlist;
+			int i = -1;
+			playlist.setId(results.record().value(++i).toString());
+			playlist.setTitle(results.record().value(++i).toString());
+			playlist.setChecksum(results.record().value(++i).toString());
+			playlist.setIcon(results.record().value(++i).toString());
+			playlist.setBackground(results.record().value(++i).toString());
+			candidates.append(playlist);
+		}
+	}
+	results.finish();
+
+	// Checksums can collide: tracks of each candidate are compared, in their order
+	for (const PlaylistDAO &playlist : candidates) {
+		if (this->selectPlaylistTracks(playlist.id().toUInt(), false) == uris) {
+			return playlist;
+		}
+	}
+	return PlaylistDAO();
+}
+
 QList<PlaylistDAO> SqlDatabase::selectPlaylists()
 {
 	if (!isOpen()) {
@@ -416,6 +817,69 @@ QList<PlaylistDAO> SqlDatabase::selectPlaylists()
 	}
 }*/
 
+/** Returns stamps of every local file in the library, to compare them with the filesystem. */
+QHash<QString, FileStamp> SqlDatabase::selectFileStamps()
+{
+	if (!isOpen()) {
+		open();
+		this->setPragmas();
+	}
+
+	QHash<QString, FileStamp> stamps;
+	QSqlQuery results(*this);
+	results.setForwardOnly(true);
+	if (results.exec("SELECT uri, fileSize, lastModified, inode FROM cache WHERE host IS NULL")) {
+		while (results.next()) {
+			FileStamp stamp;
+			stamp.size = results.value(1).toLongLong();
+			stamp.lastModified = results.value(2).toLongLong();
+			stamp.inode = results.value(3).toULongLong();
+			stamps.insert(results.value(0).toString(), stamp);
+		}
+	}
+	return stamps;
+}
+
+/** Returns stamps of external covers saved by previous scans. */
+QHash<QString, FileStamp> SqlDatabase::selectCoverStamps()
+{
+	if (!isOpen()) {
+		open();
+		this->setPragmas();
+	}
+
+	QHash<QString, FileStamp> stamps;
+	QSqlQuery results(*this);
+	results.setForwardOnly(true);
+	if (results.exec("SELECT path, fileSize, lastModified, inode FROM covers")) {
+		while (results.next()) {
+			FileStamp stamp;
+			stamp.size = results.value(1).toLongLong();
+			stamp.lastModified = results.value(2).toLongLong();
+			stamp.inode = results.value(3).toULongLong();
+			stamps.insert(results.value(0).toString(), stamp);
+		}
+	}
+	return stamps;
+}
+
+/** Returns the number of entries found in a music location during the last scan, or 0 if it was never scanned. */
+int SqlDatabase::selectScanEntryCount(const QString &location)
+{
+	if (!isOpen()) {
+		open();
+		this->setPragmas();
+	}
+
+	QSqlQuery select(*this);
+	select.prepare("SELECT entryCount FROM scanStatistics WHERE location = ?");
+	select.addBindValue(location);
+	if (select.exec() && select.next()) {
+		return select.record().value(0).toInt();
+	}
+	return 0;
+}
+
 TrackDAO SqlDatabase::selectTrackByURI(const QString &uri)
 {
 	if (!isOpen()) {
@@ -424,10 +888,9 @@ TrackDAO SqlDatabase::selectTrackByURI(const QString &uri)
 	}
 
 	TrackDAO track;
-	QSqlQuery qTracks(*this);
-	qTracks.prepare("SELECT uri, trackNumber, trackTitle, artist, album, artistAlbum, trackLength, " \
-					"rating, disc, host, icon, albumYear " \
-					"FROM cache WHERE uri = ?");
+	QSqlQuery &qTracks = this->preparedQuery("SELECT uri, trackNumber, trackTitle, artist, album, artistAlbum, trackLength, " \
+											 "rating, disc, host, icon, albumYear " \
+											 "FROM cache WHERE uri = ?");
 	qTracks.addBindValue(uri);
 	if (qTracks.exec() && qTracks.next()) {
 		QSqlRecord r = qTracks.record();
@@ -445,6 +908,8 @@ TrackDAO SqlDatabase::selectTrackByURI(const QString &uri)
 		track.setIcon(r.value(++j).toString());
 		track.setYear(r.value(++j).toString());
 	}
+	// Otherwise the statement keeps an old snapshot of the database
+	qTracks.finish();
 	return track;
 }
 
@@ -491,7 +956,7 @@ void SqlDatabase::updateTablePlaylistWithBackgroundImage(uint playlistID, const
 	update.exec();
 }
 
-void SqlDatabase::updateTableAlbumWithCoverImage(const QString &coverPath, const QString &album, const QString &artist)
+void SqlDatabase::updateTableScanStatistics(const QString &location, int entryCount)
 {
 	if (!isOpen()) {
 		open();
@@ -499,64 +964,29 @@ void SqlDatabase::updateTableAlbumWithCoverImage(const QString &coverPath, const
 	}
 
 	QSqlQuery update(*this);
-	update.prepare("UPDATE albums SET cover = ? WHERE normalizedName = ? AND artistId = (SELECT id FROM artists WHERE normalizedName = ?)");
-	update.addBindValue(coverPath);
-	update.addBindValue(this->normalizeField(album));
-	update.addBindValue(this->normalizeField(artist));
+	update.prepare("INSERT OR REPLACE INTO scanStatistics (location, entryCount) VALUES (?, ?)");
+	update.addBindValue(location);
+	update.addBindValue(entryCount);
 	update.exec();
 }
 
-
-void SqlDatabase::updateTrack(const QString &absFilePath)
+void SqlDatabase::updateTableAlbumWithCoverImage(const QString &coverPath, const QString &album, const QString &artist)
 {
-	FileHelper fh(absFilePath);
-	if (!fh.isValid()) {
-		return;
-	}
-
-	QSqlQuery updateTrack(*this);
-	updateTrack.setForwardOnly(true);
-	updateTrack.prepare("UPDATE cache SET trackNumber = ?, trackTitle = ?, artist = ?, artistNormalized = ?, album = ?, albumNormalized = ?, " \
-						"albumYear = ?, artistAlbum = ?, trackLength = ?, disc = ?, internalCover = ?, rating = ? WHERE uri = ?");
-
-	QString tn = fh.trackNumber();
-	QString title = fh.title();
-	QString artistAlbum = fh.artistAlbum().isEmpty() ? fh.artist() : fh.artistAlbum();
-
-	// Use Artist Album to reference tracks in table "tracks", not Artist
-	QString artistNorm = this->normalizeField(artistAlbum);
-	QString album = fh.album();
-	QString albumNorm = this->normalizeField(album);
-	QString length = fh.length();
-	int dn = fh.discNumber();
-
-	updateTrack.addBindValue(tn.toInt());
-	if (title.isEmpty()) {
-		updateTrack.addBindValue(fh.fileInfo().baseName());
-	} else {
-		updateTrack.addBindValue(title);
-	}
-	updateTrack.addBindValue(fh.artist());
-	updateTrack.addBindValue(artistNorm);
-	updateTrack.addBindValue(fh.album());
-	updateTrack.addBindValue(albumNorm);
-	updateTrack.addBindValue(fh.year());
-	updateTrack.addBindValue(artistAlbum);
-	updateTrack.addBindValue(length);
-	updateTrack.addBindValue(dn);
-	if (fh.hasCover()) {
-		updateTrack.addBindValue(absFilePath);
-	} else {
-		updateTrack.addBindValue(QVariant());
+	if (!isOpen()) {
+		open();
+		this->setPragmas();
 	}
-	updateTrack.addBindValue(fh.rating());
-	updateTrack.addBindValue(absFilePath);
 
-	if (!updateTrack.exec()) {
-		qDebug() << Q_FUNC_INFO << updateTrack.lastError();
-	}
+	QSqlQuery update(*this);
+	update.prepare("UPDATE cache SET cover = ? WHERE albumId IN (SELECT al.id FROM albums al INNER JOIN artists ar ON al.artistId = ar.id " \
+				   "WHERE al.normalizedName = ? AND ar.normalizedName = ?)");
+	update.addBindValue(coverPath);
+	update.addBindValue(this->normalizeField(album));
+	update.addBindValue(this->normalizeField(artist));
+	update.exec();
 }
 
+
 /** Update a list of tracks. If track name has changed, will be removed from Library then added right after. */
 void SqlDatabase::updateTracks(const QStringList &oldPaths, const QStringList &newPaths)
 {
@@ -566,43 +996,68 @@ void SqlDatabase::updateTracks(const QStringList &oldPaths, const QStringList &n
 	transaction();
 	Q_ASSERT(oldPaths.size() == newPaths.size());
 
+	BatchWriter writer(this);
 	for (int i = 0; i < newPaths.size(); i++) {
 		QString newPath = newPaths.at(i);
 		QString oldPath = oldPaths.at(i);
+		CacheRow row;
 		if (newPath.isEmpty()) {
-			this->updateTrack(oldPath);
+			// Same file, only tags have changed
+			row.stamp = FileStamp::fromFileInfo(QFileInfo(oldPath));
+			if (readFileRef(oldPath, row)) {
+				writer.updateFileRef(row);
+			}
 		} else {
-
-			QSqlQuery removeTrack(*this);
-			removeTrack.prepare("DELETE FROM cache WHERE uri = :h");
-			removeTrack.bindValue(":h", oldPath);
-			removeTrack.exec();
-
-			this->saveFileRef(newPath);
+			writer.removeFileRef(oldPath);
+			row.stamp = FileStamp::fromFileInfo(QFileInfo(newPath));
+			if (readFileRef(newPath, row)) {
+				writer.saveFileRef(row);
+			}
 		}
 	}
+	writer.flush();
 
 	commit();
 	emit aboutToUpdateView();
 }
 
-/** Reads an external picture which is close to multimedia files (same folder). */
-void SqlDatabase::saveCoverRef(const QString &coverPath, const QString &track)
+/** Reads an external picture which is close to multimedia files (same folder). Its stamp is kept for next scans. */
+void SqlDatabase::saveCoverRef(const QString &coverPath, const QString &track, const FileStamp &stamp)
 {
-	FileHelper fh(track);
-	QString artistAlbum = fh.artistAlbum().isEmpty() ? fh.artist() : fh.artistAlbum();
-	QString artistNorm = this->normalizeField(artistAlbum);
-	QString albumNorm = this->normalizeField(fh.album());
-
-	QSqlQuery updateCoverPath("UPDATE cache SET cover = ? WHERE artistNormalized = ? AND albumNormalized = ?", *this);
+	// Track was already inserted: reuse its normalized fields instead of parsing tags again
+	QSqlQuery updateCoverPath(*this);
 	updateCoverPath.setForwardOnly(true);
+	updateCoverPath.prepare("UPDATE cache SET cover = ? WHERE artistNormalized = (SELECT artistNormalized FROM cache WHERE uri = ?) " \
+							"AND albumNormalized = (SELECT albumNormalized FROM cache WHERE uri = ?)");
 	updateCoverPath.addBindValue(coverPath);
-	updateCoverPath.addBindValue(artistNorm);
-	updateCoverPath.addBindValue(albumNorm);
+	updateCoverPath.addBindValue(track);
+	updateCoverPath.addBindValue(track);
 	updateCoverPath.exec();
+
+	QSqlQuery saveStamp(*this);
+	saveStamp.prepare("INSERT OR REPLACE INTO covers (path, fileSize, lastModified, inode) VALUES (?, ?, ?, ?)");
+	saveStamp.addBindValue(coverPath);
+	saveStamp.addBindValue(stamp.size);
+	saveStamp.addBindValue(stamp.lastModified);
+	saveStamp.addBindValue(stamp.inode);
+	saveStamp.exec();
+}
+
+/** Builds a full-text query for table "cacheSearch" where each word of text is a prefix. Returns an empty string if text has no word. */
+QString SqlDatabase::matchExpression(const QString &text)
+{
+	// Same rules as the tokenizer: accents are removed, and every character which is not a letter or a digit splits words
+	static QRegularExpression marks("\\p{Mn}");
+	static QRegularExpression separators("[\\W_]+", QRegularExpression::UseUnicodePropertiesOption);
+	QString decomposed = text.toLower().normalized(QString::NormalizationForm_KD).remove(marks);
+	QStringList terms;
+	for (QString word : decomposed.split(separators, QString::SkipEmptyParts)) {
+		terms << word + '*';
+	}
+	return terms.join(' ');
 }
 
-QString SqlDatabase::normalizeField(const QString &s) const
+QString SqlDatabase::normalizeField(const QString &s)
 {
 	static QRegularExpression regExp("[^\\w]");
 	QString sNormed = s.toLower().normalized(QString::NormalizationForm_KD).remove(regExp).trimmed();
@@ -613,62 +1068,76 @@ QString SqlDatabase::normalizeField(const QString &s) const
 	}
 }
 
+/** Statements used on hot paths are prepared once per connection. */
+QSqlQuery& SqlDatabase::preparedQuery(const QString &sql)
+{
+	auto it = _preparedQueries.find(sql);
+	if (it == _preparedQueries.end()) {
+		QSqlQuery query(*this);
+		query.setForwardOnly(true);
+		query.prepare(sql);
+		it = _preparedQueries.insert(sql, query);
+	}
+	return it.value();
+}
+
 void SqlDatabase::setPragmas()
 {
-	this->exec("PRAGMA journal_mode = OFF");
-	this->exec("PRAGMA synchronous = OFF");
+	// With a write-ahead log, readers are not blocked by a scan, and a crash can only lose the last transactions
+	this->exec("PRAGMA journal_mode = WAL");
+	this->exec("PRAGMA synchronous = NORMAL");
 	this->exec("PRAGMA temp_store = 2");
 	this->exec("PRAGMA foreign_keys = 1");
 	this->exec("PRAGMA count_changes = OFF");
+	// Rows replaced by INSERT OR REPLACE also run delete triggers, so empty albums are removed
+	this->exec("PRAGMA recursive_triggers = 1");
+	// 16 MiB of page cache, and reads are mapped in memory instead of being copied
+	this->exec("PRAGMA cache_size = -16384");
+	this->exec("PRAGMA mmap_size = 268435456");
 }
 
-/** Reads a file from the filesystem and adds it into the library. */
-void SqlDatabase::saveFileRef(const QString &absFilePath)
+/** Reads tags of a local file without touching the database. Returns false if the file cannot be parsed. */
+bool SqlDatabase::readFileRef(const QString &absFilePath, CacheRow &row)
 {
-	FileHelper fh(absFilePath);
+	FileHelper fh(absFilePath, FileHelper::OM_TagsAndDuration);
 	if (!fh.isValid()) {
-		return;
+		return false;
 	}
 
-	QSqlQuery insertTrack(*this);
-	insertTrack.setForwardOnly(true);
-	insertTrack.prepare("INSERT INTO cache (uri, trackNumber, trackTitle, artist, artistNormalized, album, albumNormalized, " \
-						"albumYear, artistAlbum, trackLength, disc, internalCover, rating) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
-
-	QString tn = fh.trackNumber();
-	QString title = fh.title();
-	QString artistAlbum = fh.artistAlbum().isEmpty() ? fh.artist() : fh.artistAlbum();
+	TrackMetadata metadata = fh.readAll();
+	QString artistAlbum = metadata.artistAlbum.isEmpty() ? metadata.artist : metadata.artistAlbum;
 
+	row.uri = absFilePath;
+	row.trackNumber = metadata.trackNumber;
+	row.title = metadata.title.isEmpty() ? fh.fileInfo().baseName() : metadata.title;
+	row.artist = metadata.artist;
 	// Use Artist Album to reference tracks in table "tracks", not Artist
-	QString artistNorm = this->normalizeField(artistAlbum);
-	QString album = fh.album();
-	QString albumNorm = this->normalizeField(album);
-	QString length = fh.length();
-	int dn = fh.discNumber();
-
-	insertTrack.addBindValue(absFilePath);
-	insertTrack.addBindValue(tn.toInt());
-	if (title.isEmpty()) {
-		insertTrack.addBindValue(fh.fileInfo().baseName());
-	} else {
-		insertTrack.addBindValue(title);
-	}
-	insertTrack.addBindValue(fh.artist());
-	insertTrack.addBindValue(artistNorm);
-	insertTrack.addBindValue(fh.album());
-	insertTrack.addBindValue(albumNorm);
-	insertTrack.addBindValue(fh.year());
-	insertTrack.addBindValue(artistAlbum);
-	insertTrack.addBindValue(length);
-	insertTrack.addBindValue(dn);
-	if (fh.hasCover()) {
-		insertTrack.addBindValue(absFilePath);
-	} else {
-		insertTrack.addBindValue(QVariant());
-	}
-	insertTrack.addBindValue(fh.rating());
+	row.artistNormalized = normalizeField(artistAlbum);
+	row.album = metadata.album;
+	row.albumNormalized = normalizeField(row.album);
+	row.year = metadata.year;
+	row.artistAlbum = artistAlbum;
+	row.length = QString::number(metadata.length);
+	row.disc = metadata.disc;
+	row.internalCover = metadata.hasCover;
+	row.rating = metadata.rating;
+	return true;
+}
 
-	if (!insertTrack.exec()) {
-		qDebug() << Q_FUNC_INFO << insertTrack.lastError();
+/** Reads a file from the filesystem and adds it into the library. */
+void SqlDatabase::saveFileRef(const QString &absFilePath)
+{
+	CacheRow row;
+	row.stamp = FileStamp::fromFileInfo(QFileInfo(absFilePath));
+	if (readFileRef(absFilePath, row)) {
+		this->saveFileRef(row);
 	}
 }
+
+/** Inserts a row previously filled by readFileRef. */
+bool SqlDatabase::saveFileRef(const CacheRow &row)
+{
+	BatchWriter writer(this);
+	writer.saveFileRef(row);
+	return writer.flush();
+}
@@ -8,6 +8,7 @@
 
 #include <QFileInfo>
 #include <QSqlDatabase>
+#include <QSqlQuery>
 #include <QSqlTableModel>
 #include <QThread>
 #include <QUrl>
@@ -16,6 +17,65 @@
 class Cover;
 class FileHelper;
 
+/**
+ * \brief		The FileStamp struct identifies a version of a local file without reading it.
+ * \details		If size, modification time and inode are the same as the ones stored in the library, tags are not read again.
+ */
+struct MIAMCORE_LIBRARY FileStamp
+{
+	qint64 size;
+	qint64 lastModified;
+	quint64 inode;
+
+	FileStamp() : size(-1), lastModified(-1), inode(0) {}
+
+	static FileStamp fromFileInfo(const QFileInfo &fileInfo);
+
+	inline bool operator==(const FileStamp &other) const {
+		return size == other.size && lastModified == other.lastModified && inode == other.inode;
+	}
+	inline bool operator!=(const FileStamp &other) const { return !(*this == other); }
+};
+
+/**
+ * \brief		The CacheRow struct holds the values of one row in table "cache", read from tags before being inserted.
+ * \details		It's a plain struct so it can be filled in a worker thread and written later by the thread which owns the connection.
+ */
+struct CacheRow
+{
+	QString uri;
+	int trackNumber;
+	QString title;
+	QString artist;
+	QString artistNormalized;
+	QString album;
+	QString albumNormalized;
+	QString year;
+	QString artistAlbum;
+	QString length;
+	int disc;
+	bool internalCover;
+	int rating;
+	FileStamp stamp;
+
+	CacheRow() : trackNumber(0), disc(0), internalCover(false), rating(-1) {}
+};
+
+/**
+ * \brief		The PlaylistTracksDelta struct holds changes of a playlist since it was saved.
+ * \details		Tracks are ordered by a sparse position: inserting or moving one track writes one row, other rows are kept.
+ *				Rows are removed before new ones are inserted, so a position can be reused by the same save.
+ */
+struct PlaylistTracksDelta
+{
+	/** Every track is written again, when the playlist is saved for the first time or when there's no room between positions. */
+	bool isComplete;
+	QList<qint64> removedPositions;
+	QList<QPair<qint64, QString>> insertedTracks;
+
+	PlaylistTracksDelta() : isComplete(true) {}
+};
+
 /**
  * \brief		The SqlDatabase class uses SQLite to store few but useful tables for tracks, playlists, etc.
  * \author      Matthieu Bachelier
@@ -24,18 +84,43 @@ class FileHelper;
 class MIAMCORE_LIBRARY SqlDatabase : public QObject, public QSqlDatabase
 {
 	Q_OBJECT
+	Q_ENUMS(OpenMode)
+
+public:
+	/** Views should open read-only connections, only the scanner and few dialogs need to write. */
+	enum OpenMode { OM_ReadWrite	= 0,
+					OM_ReadOnly		= 1};
+
 private:
 	QHash<uint, GenericDAO*> _cache;
 
+	OpenMode _openMode;
+	bool _isInTransaction;
+
+	QHash<QString, QSqlQuery> _preparedQueries;
+
 public:
 	explicit SqlDatabase(QObject *parent = nullptr);
 
+	explicit SqlDatabase(OpenMode mode, QObject *parent = nullptr);
+
 	virtual ~SqlDatabase();
 
+	/** Read-only connection of the current thread. It's opened once then reused, and closed when the thread exits. */
+	static SqlDatabase* reader();
+
+	/** Number of connections opened during the last full second. */
+	static int openedLastSecond();
+
 	void reset();
 
-	uint insertIntoTablePlaylists(const PlaylistDAO &playlist, const QStringList &tracks, bool isOverwriting);
-	bool insertIntoTablePlaylistTracks(uint playlistId, const QStringList &tracks, bool isOverwriting = false);
+	/** Starts a write transaction, other connections wait until it's committed: files must be read before. Returns false if one is already opened. */
+	bool transaction();
+	bool commit();
+	bool rollback();
+
+	uint insertIntoTablePlaylists(const PlaylistDAO &playlist, const PlaylistTracksDelta &tracks, bool isOverwriting);
+	bool insertIntoTablePlaylistTracks(uint playlistId, const PlaylistTracksDelta &tracks);
 	bool insertIntoTableTracks(const TrackDAO &track);
 	bool insertIntoTableTracks(const std::list<TrackDAO> &tracks);
 
@@ -44,33 +129,74 @@ public:
 	void removePlaylistsFromHost(const QString &host);
 	void removeRecordsFromHost(const QString &host);
 
+	/** Removes local tracks which don't exist anymore on the filesystem. */
+	void removeFileRefs(const QStringList &absFilePaths);
+
 	Cover *selectCoverFromURI(const QString &uri);
 	QStringList selectPlaylistTracks(uint playlistID, bool withPrefix = true);
+
+	/**
+	 * Returns tracks of a saved playlist with their tags from the library. Tracks which aren't in the library only have an uri.
+	 * Positions are needed to save only changes of this playlist later.
+	 */
+	QList<TrackDAO> selectPlaylistTracksFromLibrary(uint playlistId, QList<qint64> *positions = nullptr);
+
+	/** Returns tracks in the same order as uris, with their tags when they're in the library. Others only have an uri. */
+	QList<TrackDAO> selectTracksFromLibrary(const QStringList &uris);
+
 	PlaylistDAO selectPlaylist(uint playlistId);
+
+	/** Returns a saved playlist which has exactly the same tracks, or an empty playlist. */
+	PlaylistDAO selectPlaylistByChecksum(quint64 checksum, const QStringList &uris);
+
 	QList<PlaylistDAO> selectPlaylists();
 
+	/** Returns stamps of every local file in the library, to compare them with the filesystem. */
+	QHash<QString, FileStamp> selectFileStamps();
+
+	/** Returns stamps of external covers saved by previous scans. */
+	QHash<QString, FileStamp> selectCoverStamps();
+
+	/** Returns the number of entries found in a music location during the last scan, or 0 if it was never scanned. */
+	int selectScanEntryCount(const QString &location);
+
 	TrackDAO selectTrackByURI(const QString &uri);
 
 	bool playlistHasBackgroundImage(uint playlistID);
 	bool updateTablePlaylist(const PlaylistDAO &playlist);
 	void updateTablePlaylistWithBackgroundImage(uint playlistID, const QString &backgroundImagePath);
+	void updateTableScanStatistics(const QString &location, int entryCount);
 	void updateTableAlbumWithCoverImage(const QString &coverPath, const QString &album, const QString &artist);
 
 	/** Update a list of tracks. If track name has changed, it will be removed from Library then added right after. */
 	void updateTracks(const QStringList &oldPaths, const QStringList &newPaths);
 
-	QString normalizeField(const QString &s) const;
+	/** Builds a full-text query for table "cacheSearch" where each word of text is a prefix. Returns an empty string if text has no word. */
+	static QString matchExpression(const QString &text);
+
+	static QString normalizeField(const QString &s);
+
+	/** Reads tags of a local file without touching the database. Returns false if the file cannot be parsed.
+	 * The stamp of the row is left untouched: it's up to the caller to set it. */
+	static bool readFileRef(const QString &absFilePath, CacheRow &row);
+
+	/** Inserts a row previously filled by readFileRef. Use a BatchWriter to insert many rows. */
+	bool saveFileRef(const CacheRow &row);
 
 private:
 	void init();
 
+	/** Statements used on hot paths are prepared once per connection. */
+	QSqlQuery& preparedQuery(const QString &sql);
+
 	void setPragmas();
 
-	void updateTrack(const QString &absFilePath);
+	/** Applies every missing step to an existing database. */
+	void upgradeSchema();
 
 public slots:
-	/** Reads an external picture which is close to multimedia files (same folder). */
-	void saveCoverRef(const QString &coverPath, const QString &track);
+	/** Reads an external picture which is close to multimedia files (same folder). Its stamp is kept for next scans. */
+	void saveCoverRef(const QString &coverPath, const QString &track, const FileStamp &stamp);
 
 	/** Reads a file from the filesystem and adds it into the library. */
 	void saveFileRef(const QString &absFilePath);
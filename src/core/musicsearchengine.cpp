@@ -1,12 +1,18 @@
 #include "musicsearchengine.h"
+#include "covercache.h"
+#include "directorywalker.h"
 #include "filehelper.h"
+#include "librarywatcher.h"
 #include "settingsprivate.h"
 #include "model/sqldatabase.h"
+#include "scanpipeline.h"
+#include "thumbnailstore.h"
 
 #include <QDateTime>
 #include <QDirIterator>
 #include <QFileInfo>
 #include <QThread>
+#include <QTimer>
 
 #include <QSqlQuery>
 #include <QSqlError>
@@ -18,26 +24,29 @@ bool MusicSearchEngine::isScanning = false;
 
 MusicSearchEngine::MusicSearchEngine(QObject *parent)
 	: QObject(parent)
-	, _timer(new QTimer(this))
+	, _watcher(nullptr)
+	, _scanMode(SM_Incremental)
 {
-	//_timer->setInterval(5000);
-	//connect(_timer, &QTimer::timeout, this, &MusicSearchEngine::watchForChanges);
-
-	// Monitor filesystem
-	if (SettingsPrivate::instance()->isFileSystemMonitored()) {
-		setWatchForChanges(true);
-	}
+	// Thumbnails of modified tracks are read again, because an embedded cover may have changed
+	connect(this, &MusicSearchEngine::libraryChanged, CoverCache::instance(), [](const QStringList &updatedTracks, const QStringList &removedTracks) {
+		CoverCache::instance()->removeCovers(updatedTracks + removedTracks);
+	});
+	connect(this, &MusicSearchEngine::libraryChanged, this, [](const QStringList &, const QStringList &removedTracks) {
+		ThumbnailStore::remove(removedTracks);
+	});
 }
 
 MusicSearchEngine::~MusicSearchEngine()
 {}
 
+/** Starts or stops watching music locations. Must be called from the thread of this object. */
 void MusicSearchEngine::setWatchForChanges(bool b)
 {
 	if (b) {
-		_timer->start();
-	} else {
-		_timer->stop();
+		this->watchForChanges();
+	} else if (_watcher) {
+		delete _watcher;
+		_watcher = nullptr;
 	}
 }
 
@@ -46,24 +55,10 @@ void MusicSearchEngine::doSearch()
 	emit aboutToSearch();
 
 	MusicSearchEngine::isScanning = true;
-	QList<QDir> locations;
-	for (QString musicPath : SettingsPrivate::instance()->musicLocations()) {
-		QDir location(musicPath);
-		location.setFilter(QDir::AllDirs | QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot);
-		locations.append(location);
-	}
-
-	int entryCount = 0;
-	// QDirIterator class is very fast to scan large directories
-	for (QDir location : locations) {
-		QDirIterator it(location.absolutePath(), QDir::AllEntries | QDir::Hidden | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
-		while (it.hasNext()) {
-			it.next();
-			entryCount++;
-		}
-	}
+	QStringList locations = SettingsPrivate::instance()->musicLocations();
 
 	int currentEntry = 0;
+	int walkedEntries = 0;
 	int percent = 1;
 	bool atLeastOneAudioFileWasFound = false;
 	bool isNewDirectory = false;
@@ -73,53 +68,140 @@ void MusicSearchEngine::doSearch()
 
 	QStringList suffixes = FileHelper::suffixes(FileHelper::ET_Standard | FileHelper::ET_GameMusicEmu);
 
-	SqlDatabase db;
-	db.transaction();
-	for (QDir location : locations) {
-		QDirIterator it(location.absolutePath(), QDir::AllEntries | QDir::Hidden | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
-		while (it.hasNext()) {
-			QString entry = it.next();
-			QFileInfo qFileInfo(entry);
-			currentEntry++;
+	// Files already in the library. Those which are still in this list after the scan have been removed from the filesystem
+	QHash<QString, FileStamp> knownFiles;
+	QHash<QString, FileStamp> knownCovers;
+
+	// Locations are walked only once: the total is estimated from the previous scan and refined while walking
+	int estimatedEntryCount = 0;
+	{
+		SqlDatabase db;
+		if (_scanMode == SM_Full) {
+			db.reset();
+		} else {
+			knownFiles = db.selectFileStamps();
+			knownCovers = db.selectCoverStamps();
+		}
+		for (QString location : locations) {
+			estimatedEntryCount += db.selectScanEntryCount(location);
+		}
+	}
+	// At least one track of the current folder is parsed
+	bool hasModifiedFiles = false;
 
-			// Directory has changed: we can discard cover
-			if (qFileInfo.isDir()) {
-				if (!coverPath.isEmpty() && !lastFileScannedNextToCover.isEmpty()) {
-					db.saveCoverRef(coverPath, lastFileScannedNextToCover);
-					coverPath.clear();
-				}
-				isNewDirectory = true;
-				atLeastOneAudioFileWasFound = false;
-				lastFileScannedNextToCover.clear();
-				continue;
-			} else if (qFileInfo.suffix().toLower() == "jpg" || qFileInfo.suffix().toLower() == "png") {
-				if (atLeastOneAudioFileWasFound) {
-					coverPath = qFileInfo.absoluteFilePath();
-				} else if (isNewDirectory) {
-					coverPath = qFileInfo.absoluteFilePath();
-				}
-			} else if (suffixes.contains(qFileInfo.suffix())) {
-				db.saveFileRef(qFileInfo.absoluteFilePath());
-				atLeastOneAudioFileWasFound = true;
-				lastFileScannedNextToCover = qFileInfo.absoluteFilePath();
-				isNewDirectory = false;
-			}
+	// This thread only walks the filesystem: tags are read by workers and rows are written by a dedicated thread
+	ScanPipeline pipeline(SettingsPrivate::instance()->scanWorkerCount());
+	pipeline.start();
 
-			if (currentEntry * 100 / entryCount > percent) {
-				percent = currentEntry * 100 / entryCount;
-				emit progressChanged(percent);
-				qApp->processEvents();
-			}
+	// External covers are only saved again for folders where at least one track was parsed, or if the cover itself has changed
+	auto addCoverRef = [&]() {
+		if (coverPath.isEmpty() || lastFileScannedNextToCover.isEmpty()) {
+			return;
+		}
+		FileStamp coverStamp = FileStamp::fromFileInfo(QFileInfo(coverPath));
+		if (hasModifiedFiles || knownCovers.value(coverPath) != coverStamp) {
+			pipeline.addCoverRef(coverPath, lastFileScannedNextToCover, coverStamp);
+		}
+	};
+
+	// Audio files are counted when written by the pipeline, everything else when visited
+	bool isWalking = true;
+	auto updateProgress = [&]() {
+		int total = qMax(estimatedEntryCount, walkedEntries);
+		if (total == 0) {
+			return;
 		}
-		if (!coverPath.isEmpty() && !lastFileScannedNextToCover.isEmpty()) {
-			db.saveCoverRef(coverPath, lastFileScannedNextToCover);
-			coverPath.clear();
+		int done = currentEntry + pipeline.processedFiles();
+		int p = done * 100 / total;
+		// Total is only known for sure when every location has been walked
+		if (isWalking) {
+			p = qMin(p, 99);
+		}
+		if (p > percent) {
+			percent = p;
+			emit progressChanged(percent);
+			qApp->processEvents();
+		}
+	};
+
+	auto visit = [&](const QString &entry, bool isDir) {
+		walkedEntries++;
+
+		// Directory has changed: we can discard cover
+		if (isDir) {
+			if (!coverPath.isEmpty() && !lastFileScannedNextToCover.isEmpty()) {
+				addCoverRef();
+				coverPath.clear();
+			}
+			hasModifiedFiles = false;
+			isNewDirectory = true;
+			atLeastOneAudioFileWasFound = false;
 			lastFileScannedNextToCover.clear();
+			currentEntry++;
+			return;
+		}
+
+		QFileInfo qFileInfo(entry);
+		QString suffix = qFileInfo.suffix();
+		if (suffix.toLower() == "jpg" || suffix.toLower() == "png") {
+			if (atLeastOneAudioFileWasFound) {
+				coverPath = entry;
+			} else if (isNewDirectory) {
+				coverPath = entry;
+			}
+			currentEntry++;
+		} else if (suffixes.contains(suffix)) {
+			FileStamp stamp = FileStamp::fromFileInfo(qFileInfo);
+			auto known = knownFiles.find(entry);
+			if (known == knownFiles.end() || known.value() != stamp) {
+				pipeline.addFile(entry, stamp);
+				hasModifiedFiles = true;
+			} else {
+				// Unchanged since last scan: only a stat() was needed
+				currentEntry++;
+			}
+			if (known != knownFiles.end()) {
+				knownFiles.erase(known);
+			}
+			atLeastOneAudioFileWasFound = true;
+			lastFileScannedNextToCover = entry;
+			isNewDirectory = false;
+		} else {
+			currentEntry++;
 		}
+		updateProgress();
+	};
+
+	QHash<QString, int> entryCounts;
+	for (QString location : locations) {
+		entryCounts.insert(location, DirectoryWalker::walk(location, visit));
+		addCoverRef();
+		coverPath.clear();
+		lastFileScannedNextToCover.clear();
+		hasModifiedFiles = false;
 		atLeastOneAudioFileWasFound = false;
 	}
-	db.commit();
+	isWalking = false;
+	estimatedEntryCount = walkedEntries;
+
+	// Keep reporting progress while workers are parsing the last files
+	pipeline.finish();
+	while (!pipeline.waitForFinished(100)) {
+		updateProgress();
+	}
+	updateProgress();
 
+	MappedFileStream::Statistics io = pipeline.ioStatistics();
+	qDebug() << Q_FUNC_INFO << pipeline.processedFiles() << "files," << io.bytesRead << "bytes read in" << io.systemCalls << "system calls";
+
+	SqlDatabase db;
+	if (!knownFiles.isEmpty()) {
+		db.removeFileRefs(knownFiles.keys());
+		ThumbnailStore::remove(knownFiles.keys());
+	}
+	for (auto it = entryCounts.cbegin(); it != entryCounts.cend(); ++it) {
+		db.updateTableScanStatistics(it.key(), it.value());
+	}
 	db.exec("CREATE INDEX IF NOT EXISTS indexArtist ON cache (artistNormalized)");
 	db.exec("CREATE INDEX IF NOT EXISTS indexAlbum ON cache (albumNormalized)");
 	db.exec("CREATE INDEX IF NOT EXISTS indexPath ON cache (uri)");
@@ -132,75 +214,30 @@ void MusicSearchEngine::doSearch()
 	emit searchHasEnded();
 }
 
+/** Synchronizes the library with changes made since the last session, then applies live changes. */
 void MusicSearchEngine::watchForChanges()
 {
 	if (isScanning) {
 		return;
 	}
 
-	// Gather all folders registered on music locations
-	QFileInfoList dirs;
-	for (QString musicPath : SettingsPrivate::instance()->musicLocations()) {
-		QFileInfo location(musicPath);
-		QDirIterator it(location.absoluteFilePath(), QDir::Dirs | QDir::Hidden | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
-		while (it.hasNext()) {
-			QString entry = it.next();
-			QFileInfo qFileInfo(entry);
-			dirs << qFileInfo;
-		}
-	}
-
-	SqlDatabase db;
-
-	QStringList newFoldersToAddInLibrary;
-	// Add folders that were not found first
-	for (QFileInfo f : dirs) {
-		QSqlQuery query(db);
-		query.setForwardOnly(true);
-		query.prepare("SELECT * FROM filesystem WHERE path = ?");
-		query.addBindValue(f.absoluteFilePath());
-		if (query.exec() && !query.next()) {
-			newFoldersToAddInLibrary << f.absoluteFilePath();
-			QSqlQuery prepared(db);
-			prepared.setForwardOnly(true);
-			prepared.prepare("INSERT INTO filesystem (path, lastModified) VALUES (?, ?)");
-			prepared.addBindValue(f.absoluteFilePath());
-			prepared.addBindValue(f.lastModified().toTime_t());
-			prepared.exec();
-		}
-	}
+	if (_watcher == nullptr) {
+		_watcher = new LibraryWatcher(this);
+		connect(_watcher, &LibraryWatcher::tracksChanged, this, &MusicSearchEngine::libraryChanged);
 
-	if (!newFoldersToAddInLibrary.isEmpty()) {
-		this->doSearch();
+		// Some events were lost: only an incremental scan can tell what has changed
+		connect(_watcher, &LibraryWatcher::overflowed, this, &MusicSearchEngine::rescanAfterOverflow);
 	}
+	_watcher->start(SettingsPrivate::instance()->musicLocations());
+}
 
-	// Process in reverse mode to clean cache: from database file and check if entry exists in database
-	QSqlQuery cache("SELECT * FROM filesystem", db);
-	cache.setForwardOnly(true);
-	if (cache.exec()) {
-		QStringList oldLocations;
-		while (cache.next()) {
-			QDir d(cache.record().value(0).toString());
-			d.exists();
-			QFileInfo fileInfo(cache.record().value(0).toString());
-			// Remove folder in database because it couldn't be find in the filesystem
-			if (!fileInfo.exists()) {
-				QSqlQuery deleteFromFilesystem(db);
-				deleteFromFilesystem.prepare("DELETE FROM filesystem WHERE path = ?");
-				deleteFromFilesystem.addBindValue(fileInfo.absoluteFilePath());
-				qDebug() << Q_FUNC_INFO << "DELETE FROM filesystem WHERE path = ?";
-
-				if (deleteFromFilesystem.exec()) {
-					oldLocations << fileInfo.absoluteFilePath();
-				}
-			}
-		}
-		qDebug() << Q_FUNC_INFO << oldLocations;
-		if (!oldLocations.isEmpty()) {
-			//db.rebuildFomLocations(oldLocations, QStringList());
-			//setDelta(oldLocations);
-			//db.exec("DELETE FROM cache");
-			//db.exec("DROP INDEX indexUri");
-		}
+/** Some events were lost: only an incremental scan can tell what has changed. It waits for a running scan to end. */
+void MusicSearchEngine::rescanAfterOverflow()
+{
+	if (isScanning) {
+		QTimer::singleShot(1000, this, &MusicSearchEngine::rescanAfterOverflow);
+		return;
 	}
+	_scanMode = SM_Incremental;
+	this->doSearch();
 }
@@ -3,10 +3,12 @@
 
 #include <QDir>
 #include <QFileInfo>
-#include <QTimer>
 
 #include "miamcore_global.h"
 
+/// Forward declaration
+class LibraryWatcher;
+
 /**
  * \brief		The MusicSearchEngine class
  * \author      Matthieu Bachelier
@@ -15,10 +17,17 @@
 class MIAMCORE_LIBRARY MusicSearchEngine : public QObject
 {
 	Q_OBJECT
+public:
+	enum ScanMode { SM_Full			= 0,
+					SM_Incremental	= 1};
+
 private:
-	QTimer *_timer;
+	/** Keeps the library up-to-date between two scans. */
+	LibraryWatcher *_watcher;
 	//QStringList _delta;
 
+	ScanMode _scanMode;
+
 public:
 	static bool isScanning;
 
@@ -28,19 +37,31 @@ public:
 
 	//void setDelta(const QStringList &delta);
 
+	/** Starts or stops watching music locations. Must be called from the thread of this object. */
 	void setWatchForChanges(bool b);
 
+	/** Full mode rebuilds the library, incremental mode only reads tags of new or modified files. */
+	inline void setScanMode(ScanMode mode) { _scanMode = mode; }
+
 public slots:
 	void doSearch();
 
+	/** Synchronizes the library with changes made since the last session, then applies live changes. */
 	void watchForChanges();
 
+private slots:
+	/** Some events were lost: only an incremental scan can tell what has changed. It waits for a running scan to end. */
+	void rescanAfterOverflow();
+
 signals:
 	void aboutToSearch();
 
 	void progressChanged(int);
 
 	void searchHasEnded();
+
+	/** Tracks were updated in the database by the watcher. Renamed tracks are in both lists. */
+	void libraryChanged(const QStringList &updatedTracks, const QStringList &removedTracks);
 };
 
 #endif // MUSICSEARCHENGINE_H
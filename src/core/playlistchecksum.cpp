@@ -0,0 +1,189 @@
+#include "playlistchecksum.h"
+
+namespace {
+
+/** Odd multiplier of the polynomial hash, every position gets a different power. */
+const quint64 base = Q_UINT64_C(0x9E3779B97F4A7C15);
+
+quint64 uriHash(const QString &uri)
+{
+	quint64 h = Q_UINT64_C(14695981039346656037);
+	const ushort *c = uri.utf16();
+	for (int i = 0; i < uri.size(); i++) {
+		h ^= c[i];
+		h *= Q_UINT64_C(1099511628211);
+	}
+	return h;
+}
+
+/** Final step of SplitMix64, every bit of the input changes about half of the output. */
+quint64 mix(quint64 z)
+{
+	z = (z ^ (z >> 30)) * Q_UINT64_C(0xBF58476D1CE4E5B9);
+	z = (z ^ (z >> 27)) * Q_UINT64_C(0x94D049BB133111EB);
+	return z ^ (z >> 31);
+}
+
+}
+
+/** An empty playlist. */
+PlaylistChecksum::PlaylistChecksum()
+	: _root(-1)
+	, _seed(2463534242u)
+{}
+
+/** Computes the checksum of a whole playlist, equal to the checksum of a model with the same rows. */
+quint64 PlaylistChecksum::checksum(const QStringList &uris)
+{
+	quint64 sum = 0;
+	quint64 power = 1;
+	for (const QString &uri : uris) {
+		sum += mix(uriHash(uri)) * power;
+		power *= base;
+	}
+	return finalize(sum, uris.size());
+}
+
+void PlaylistChecksum::clear()
+{
+	_nodes.clear();
+	_freeNodes.clear();
+	_root = -1;
+}
+
+/** Rows were inserted before row (or appended if row is the number of rows). */
+void PlaylistChecksum::insert(int row, const QVector<QString> &uris)
+{
+	int inserted = -1;
+	for (const QString &uri : uris) {
+		inserted = merge(inserted, createNode(uri));
+	}
+	int left, right;
+	split(_root, row, left, right);
+	_root = merge(merge(left, inserted), right);
+}
+
+/** Rows were removed. */
+void PlaylistChecksum::remove(int row, int count)
+{
+	int left, middle, right;
+	split(_root, row, left, right);
+	split(right, count, middle, right);
+	freeNodes(middle);
+	_root = merge(left, right);
+}
+
+quint64 PlaylistChecksum::value() const
+{
+	if (_root < 0) {
+		return finalize(0, 0);
+	}
+	return finalize(_nodes.at(_root).sum, _nodes.at(_root).size);
+}
+
+/** The number of rows is mixed in: a playlist can't collide with itself followed by tracks hashed to zero. */
+quint64 PlaylistChecksum::finalize(quint64 sum, int size)
+{
+	return mix(sum ^ mix(static_cast<quint64>(size)));
+}
+
+int PlaylistChecksum::createNode(const QString &uri)
+{
+	_seed ^= _seed << 13;
+	_seed ^= _seed >> 17;
+	_seed ^= _seed << 5;
+
+	Node node;
+	node.hash = mix(uriHash(uri));
+	node.sum = node.hash;
+	node.power = base;
+	node.left = -1;
+	node.right = -1;
+	node.size = 1;
+	node.priority = _seed;
+	if (_freeNodes.isEmpty()) {
+		_nodes.append(node);
+		return _nodes.size() - 1;
+	}
+	int index = _freeNodes.takeLast();
+	_nodes[index] = node;
+	return index;
+}
+
+void PlaylistChecksum::freeNodes(int node)
+{
+	if (node < 0) {
+		return;
+	}
+	freeNodes(_nodes.at(node).left);
+	freeNodes(_nodes.at(node).right);
+	_freeNodes.append(node);
+}
+
+int PlaylistChecksum::merge(int left, int right)
+{
+	if (left < 0) {
+		return right;
+	}
+	if (right < 0) {
+		return left;
+	}
+	if (_nodes.at(left).priority > _nodes.at(right).priority) {
+		int merged = merge(_nodes.at(left).right, right);
+		_nodes[left].right = merged;
+		update(left);
+		return left;
+	} else {
+		int merged = merge(left, _nodes.at(right).left);
+		_nodes[right].left = merged;
+		update(right);
+		return right;
+	}
+}
+
+/** Left tree has the first count rows of node, right tree has others. */
+void PlaylistChecksum::split(int node, int count, int &left, int &right)
+{
+	if (node < 0) {
+		left = -1;
+		right = -1;
+		return;
+	}
+	int leftSize = _nodes.at(node).left < 0 ? 0 : _nodes.at(_nodes.at(node).left).size;
+	if (count <= leftSize) {
+		int subRight;
+		split(_nodes.at(node).left, count, left, subRight);
+		_nodes[node].left = subRight;
+		update(node);
+		right = node;
+	} else {
+		int subLeft;
+		split(_nodes.at(node).right, count - leftSize - 1, subLeft, right);
+		_nodes[node].right = subLeft;
+		update(node);
+		left = node;
+	}
+}
+
+void PlaylistChecksum::update(int node)
+{
+	Node &n = _nodes[node];
+	quint64 leftSum = 0, leftPower = 1, rightSum = 0, rightPower = 1;
+	int leftSize = 0, rightSize = 0;
+	if (n.left >= 0) {
+		const Node &l = _nodes.at(n.left);
+		leftSum = l.sum;
+		leftPower = l.power;
+		leftSize = l.size;
+	}
+	if (n.right >= 0) {
+		const Node &r = _nodes.at(n.right);
+		rightSum = r.sum;
+		rightPower = r.power;
+		rightSize = r.size;
+	}
+	// Rows of the right subtree come after the left subtree and this row
+	n.sum = leftSum + n.hash * leftPower + rightSum * leftPower * base;
+	n.power = leftPower * base * rightPower;
+	n.size = leftSize + 1 + rightSize;
+}
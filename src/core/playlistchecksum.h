@@ -0,0 +1,76 @@
+#ifndef PLAYLISTCHECKSUM_H
+#define PLAYLISTCHECKSUM_H
+
+#include <QStringList>
+#include <QVector>
+
+#include "miamcore_global.h"
+
+/**
+ * \brief		The PlaylistChecksum class identifies the content of a playlist, the order of its tracks included.
+ * \details		The checksum is a polynomial hash of uris by position: the hash of the uri at row i is multiplied by B^i.
+ *				Unlike a sum of neighbour pairs, it changes when a track is moved even if the playlist has duplicates. Hashes
+ *				of rows are kept in an implicit treap, where each node knows the hash of its subtree: inserting or removing
+ *				rows updates the checksum of a large playlist in O(log n). Uris are hashed with FNV-1a, so checksums stored in
+ *				the database stay valid between versions of Qt.
+ * \author      Matthieu Bachelier
+ * \copyright   GNU General Public License v3
+ */
+class MIAMCORE_LIBRARY PlaylistChecksum
+{
+private:
+	struct Node
+	{
+		/** Hash of the uri of this row. */
+		quint64 hash;
+		/** Polynomial hash of the subtree, rows being numbered from the leftmost one. */
+		quint64 sum;
+		/** B^size, to shift a subtree after another one. */
+		quint64 power;
+		int left;
+		int right;
+		int size;
+		quint32 priority;
+	};
+
+	/** Nodes are stored in one block, removed ones are reused. */
+	QVector<Node> _nodes;
+	QVector<int> _freeNodes;
+	int _root;
+
+	/** State of a xorshift generator, for priorities of nodes. */
+	quint32 _seed;
+
+public:
+	/** An empty playlist. */
+	PlaylistChecksum();
+
+	/** Computes the checksum of a whole playlist, equal to the checksum of a model with the same rows. */
+	static quint64 checksum(const QStringList &uris);
+
+	void clear();
+
+	/** Rows were inserted before row (or appended if row is the number of rows). */
+	void insert(int row, const QVector<QString> &uris);
+
+	/** Rows were removed. */
+	void remove(int row, int count);
+
+	quint64 value() const;
+
+private:
+	static quint64 finalize(quint64 sum, int size);
+
+	int createNode(const QString &uri);
+
+	void freeNodes(int node);
+
+	int merge(int left, int right);
+
+	/** Left tree has the first count rows of node, right tree has others. */
+	void split(int node, int count, int &left, int &right);
+
+	void update(int node);
+};
+
+#endif // PLAYLISTCHECKSUM_H
@@ -0,0 +1,139 @@
+#include "scanpipeline.h"
+#include "model/batchwriter.h"
+
+#include <QRunnable>
+
+#include <functional>
+
+#include <QtDebug>
+
+namespace {
+
+/** Runs a member function of the pipeline in the pool. */
+class PipelineTask : public QRunnable
+{
+private:
+	std::function<void()> _task;
+
+public:
+	explicit PipelineTask(const std::function<void()> &task) : _task(task) {}
+
+	virtual void run() override { _task(); }
+};
+
+/** Rows are committed by chunks to keep transactions short without paying one commit per file. */
+const int rowsPerTransaction = 500;
+
+}
+
+ScanPipeline::ScanPipeline(int workerCount)
+	: _files(qMax(1, workerCount) * 64)
+	, _rows(rowsPerTransaction * 2)
+	, _workerCount(qMax(1, workerCount))
+	, _runningWorkers(0)
+	, _processedFiles(0)
+{
+	// Parsers plus one writer
+	_pool.setMaxThreadCount(_workerCount + 1);
+}
+
+ScanPipeline::~ScanPipeline()
+{
+	this->finish();
+	_pool.waitForDone();
+}
+
+/** Adds a cover found next to a track. It will be saved when every track has been written. */
+void ScanPipeline::addCoverRef(const QString &coverPath, const QString &track, const FileStamp &stamp)
+{
+	CoverRef coverRef;
+	coverRef.coverPath = coverPath;
+	coverRef.track = track;
+	coverRef.stamp = stamp;
+	_coverRefs.append(coverRef);
+}
+
+/** Adds an audio file to parse. Blocks while workers are too far behind. */
+void ScanPipeline::addFile(const QString &absFilePath, const FileStamp &stamp)
+{
+	CacheRow file;
+	file.uri = absFilePath;
+	file.stamp = stamp;
+	_files.push(file);
+}
+
+/** Bytes read and system calls made by workers to parse tags since the pipeline has started. */
+MappedFileStream::Statistics ScanPipeline::ioStatistics() const
+{
+	// Counters are shared with other readers, like the cover cache, which may read a few files in the meantime
+	MappedFileStream::Statistics statistics = MappedFileStream::statistics();
+	statistics.bytesRead -= _ioAtStart.bytesRead;
+	statistics.systemCalls -= _ioAtStart.systemCalls;
+	return statistics;
+}
+
+/** Walking is over: lets workers and writer drain their queues. */
+void ScanPipeline::finish()
+{
+	_files.close();
+}
+
+void ScanPipeline::start()
+{
+	_ioAtStart = MappedFileStream::statistics();
+	_runningWorkers.store(_workerCount);
+	for (int i = 0; i < _workerCount; i++) {
+		_pool.start(new PipelineTask([this]() { this->parseFiles(); }));
+	}
+	_pool.start(new PipelineTask([this]() { this->writeRows(); }));
+}
+
+/** Waits at most msecs for the writer to complete. Returns true if everything was written. */
+bool ScanPipeline::waitForFinished(int msecs)
+{
+	return _pool.waitForDone(msecs);
+}
+
+void ScanPipeline::parseFiles()
+{
+	CacheRow row;
+	while (_files.pop(row)) {
+		if (SqlDatabase::readFileRef(row.uri, row)) {
+			_rows.push(row);
+		} else {
+			_processedFiles.fetchAndAddRelaxed(1);
+		}
+	}
+
+	// Last worker to leave tells the writer nothing else will come
+	if (_runningWorkers.fetchAndAddOrdered(-1) == 1) {
+		_rows.close();
+	}
+}
+
+void ScanPipeline::writeRows()
+{
+	// A connection can only be used by the thread which has opened it
+	SqlDatabase db;
+	BatchWriter writer(&db, rowsPerTransaction);
+	CacheRow row;
+	forever {
+		if (!_rows.tryPop(row)) {
+			// Parsers are behind: the write lock isn't held while waiting for them, other writers can go first
+			writer.flush();
+			if (!_rows.pop(row)) {
+				break;
+			}
+		}
+		writer.saveFileRef(row);
+		_processedFiles.fetchAndAddRelaxed(1);
+	}
+	writer.flush();
+
+	// Every track is in the database, updating covers is now safe
+	db.transaction();
+	for (const CoverRef &coverRef : _coverRefs) {
+		db.saveCoverRef(coverRef.coverPath, coverRef.track, coverRef.stamp);
+	}
+	db.commit();
+}
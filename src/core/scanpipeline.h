@@ -0,0 +1,150 @@
+#ifndef SCANPIPELINE_H
+#define SCANPIPELINE_H
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QQueue>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include "model/sqldatabase.h"
+#include "mappedfilestream.h"
+#include "miamcore_global.h"
+
+/**
+ * \brief		The BoundedQueue class is a blocking FIFO shared between producer and consumer threads.
+ * \details		Producers wait when the queue is full, consumers wait when it's empty. Once closed, consumers drain
+ *				remaining items then pop() returns false.
+ * \author      Matthieu Bachelier
+ * \copyright   GNU General Public License v3
+ */
+template<typename T>
+class BoundedQueue
+{
+private:
+	QMutex _mutex;
+	QWaitCondition _notEmpty;
+	QWaitCondition _notFull;
+	QQueue<T> _queue;
+	int _capacity;
+	bool _isClosed;
+
+public:
+	explicit BoundedQueue(int capacity) : _capacity(capacity), _isClosed(false) {}
+
+	/** Appends an item, blocking while the queue is full. Returns false if the queue was closed. */
+	bool push(const T &item)
+	{
+		QMutexLocker locker(&_mutex);
+		while (_queue.size() >= _capacity && !_isClosed) {
+			_notFull.wait(&_mutex);
+		}
+		if (_isClosed) {
+			return false;
+		}
+		_queue.enqueue(item);
+		_notEmpty.wakeOne();
+		return true;
+	}
+
+	/** Takes the first item, blocking while the queue is empty. Returns false when closed and drained. */
+	bool pop(T &item)
+	{
+		QMutexLocker locker(&_mutex);
+		while (_queue.isEmpty() && !_isClosed) {
+			_notEmpty.wait(&_mutex);
+		}
+		if (_queue.isEmpty()) {
+			return false;
+		}
+		item = _queue.dequeue();
+		_notFull.wakeOne();
+		return true;
+	}
+
+	/** Takes the first item if there's one, without waiting. */
+	bool tryPop(T &item)
+	{
+		QMutexLocker locker(&_mutex);
+		if (_queue.isEmpty()) {
+			return false;
+		}
+		item = _queue.dequeue();
+		_notFull.wakeOne();
+		return true;
+	}
+
+	/** No more items will be pushed: wakes up everyone waiting. */
+	void close()
+	{
+		QMutexLocker locker(&_mutex);
+		_isClosed = true;
+		_notEmpty.wakeAll();
+		_notFull.wakeAll();
+	}
+};
+
+/**
+ * \brief		The ScanPipeline class reads tags of audio files on multiple threads while a single thread writes them.
+ * \details		The thread which walks music locations feeds paths with addFile(). N workers parse files with FileHelper
+ *				and a single writer inserts rows in table "cache", committing every few hundreds of rows. External covers
+ *				are applied by the writer once all tracks are in the database.
+ * \author      Matthieu Bachelier
+ * \copyright   GNU General Public License v3
+ */
+class MIAMCORE_LIBRARY ScanPipeline
+{
+private:
+	QThreadPool _pool;
+
+	/** Files to parse: only uri and stamp are set. */
+	BoundedQueue<CacheRow> _files;
+	BoundedQueue<CacheRow> _rows;
+
+	struct CoverRef
+	{
+		QString coverPath;
+		QString track;
+		FileStamp stamp;
+	};
+	QList<CoverRef> _coverRefs;
+
+	int _workerCount;
+	QAtomicInt _runningWorkers;
+	QAtomicInt _processedFiles;
+
+	/** Counters of streams when the pipeline has started. */
+	MappedFileStream::Statistics _ioAtStart;
+
+public:
+	explicit ScanPipeline(int workerCount);
+
+	virtual ~ScanPipeline();
+
+	/** Adds a cover found next to a track. It will be saved when every track has been written. */
+	void addCoverRef(const QString &coverPath, const QString &track, const FileStamp &stamp);
+
+	/** Adds an audio file to parse. Blocks while workers are too far behind. */
+	void addFile(const QString &absFilePath, const FileStamp &stamp);
+
+	/** Walking is over: lets workers and writer drain their queues. */
+	void finish();
+
+	/** Bytes read and system calls made by workers to parse tags since the pipeline has started. */
+	MappedFileStream::Statistics ioStatistics() const;
+
+	/** Number of files parsed and written (or discarded because invalid) so far. */
+	inline int processedFiles() const { return _processedFiles.load(); }
+
+	void start();
+
+	/** Waits at most msecs for the writer to complete. Returns true if everything was written. */
+	bool waitForFinished(int msecs);
+
+private:
+	void parseFiles();
+
+	void writeRows();
+};
+
+#endif // SCANPIPELINE_H
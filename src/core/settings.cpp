@@ -1,5 +1,7 @@
 #include "settings.h"
 
+#include "settingssnapshot.h"
+
 #include <QAction>
 #include <QDateTime>
 #include <QFile>
@@ -31,35 +33,35 @@ Settings* Settings::instance()
 /** Return the actual size of media buttons. */
 int Settings::buttonsSize() const
 {
-	return value("buttonsSize", 36).toInt();
+	return lookup("buttonsSize", 36).toInt();
 }
 
 qreal Settings::coverBelowTracksOpacity() const
 {
-	return value("bigCoverOpacity", 0.66).toReal();
+	return lookup("bigCoverOpacity", 0.66).toReal();
 }
 
 /** Returns the size of a cover. */
 int Settings::coverSizeLibraryTree() const
 {
-	return value("coverSizeLibraryTree", 48).toInt();
+	return lookup("coverSizeLibraryTree", 48).toInt();
 }
 
 int Settings::coverSizeUniqueLibrary() const
 {
-	return value("coverSizeUniqueLibrary", 100).toInt();
+	return lookup("coverSizeUniqueLibrary", 100).toInt();
 }
 
 /** Returns true if big and faded covers are displayed in the library when an album is expanded. */
 bool Settings::isCoverBelowTracksEnabled() const
 {
-	return value("bigCovers", true).toBool();
+	return lookup("bigCovers", true).toBool();
 }
 
 /** Returns true if the button in parameter is visible or not. */
 bool Settings::isMediaButtonVisible(const QString & buttonName) const
 {
-   QVariant ok = value(buttonName);
+   QVariant ok = lookup(buttonName);
    if (ok.isValid()) {
 	   return ok.toBool();
    } else {
@@ -74,13 +76,13 @@ bool Settings::isMediaButtonVisible(const QString & buttonName) const
 /** Returns true if star outline must be displayed in the library. */
 bool Settings::isShowNeverScored() const
 {
-	return value("showNeverScored", false).toBool();
+	return lookup("showNeverScored", false).toBool();
 }
 
 /** Returns true if stars are visible and active. */
 bool Settings::libraryHasStars() const
 {
-	return value("delegates", true).toBool();
+	return lookup("delegates", true).toBool();
 }
 
 /** Sets if the button in parameter is visible or not. */
@@ -98,15 +100,15 @@ void Settings::setShowNeverScored(bool b)
 
 QMap<QString, QVariant> Settings::shortcuts() const
 {
-	return value("shortcuts").toMap();
+	return lookup("shortcuts").toMap();
 }
 
 Settings::RequestSqlModel Settings::sqlModel() const
 {
-	if (value("requestSqlModel").isNull()) {
+	if (lookup("requestSqlModel").isNull()) {
 		return RSM_Hierarchical;
 	} else {
-		int i = value("requestSqlModel").toInt();
+		int i = lookup("requestSqlModel").toInt();
 		return (Settings::RequestSqlModel)i;
 	}
 }
@@ -114,18 +116,25 @@ Settings::RequestSqlModel Settings::sqlModel() const
 /** Returns the actual theme name. */
 QString Settings::theme() const
 {
-	return value("theme", "oxygen").toString();
+	return lookup("theme", "oxygen").toString();
+}
+
+/** Reads a value from getters of this class, and counts the lookup: see SettingsSnapshot::lookups(). */
+QVariant Settings::lookup(const QString &key, const QVariant &defaultValue) const
+{
+	SettingsSnapshot::countLookup();
+	return QSettings::value(key, defaultValue);
 }
 
 /** Returns volume from the slider. */
 qreal Settings::volume() const
 {
-	return value("volume", 0.9).toReal();
+	return lookup("volume", 0.9).toReal();
 }
 
 void Settings::initShortcuts()
 {
-	if (value("shortcuts").isNull()) {
+	if (lookup("shortcuts").isNull()) {
 		QMap<QString, QVariant> shortcuts;
 		shortcuts.insert("openFiles", "Ctrl+O");
 		shortcuts.insert("openFolders", "Ctrl+Shift+O");
@@ -182,7 +191,7 @@ void Settings::setVolume(qreal v)
 /** Returns true if the volume value in percent is always visible in the upper left corner of the widget. */
 bool Settings::isVolumeBarTextAlwaysVisible() const
 {
-	return value("volumeBarTextAlwaysVisible", false).toBool();
+	return lookup("volumeBarTextAlwaysVisible", false).toBool();
 }
 
 void Settings::setCoverBelowTracksEnabled(bool b)
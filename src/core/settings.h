@@ -103,6 +103,9 @@ public:
 private:
 	void initShortcuts();
 
+	/** Reads a value from getters of this class, and counts the lookup: see SettingsSnapshot::lookups(). */
+	QVariant lookup(const QString &key, const QVariant &defaultValue = QVariant()) const;
+
 public slots:
 	/** Sets a new button size. */
 	void setButtonsSize(int s);
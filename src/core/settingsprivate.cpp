@@ -1,8 +1,12 @@
 #include "settingsprivate.h"
 
+#include "settings.h"
+#include "settingssnapshot.h"
+
 #include <QDateTime>
 #include <QDir>
 #include <QFile>
+#include <QFontMetrics>
 #include <QApplication>
 #include <QGuiApplication>
 #include <QHeaderView>
@@ -10,6 +14,7 @@
 #include <QScrollBar>
 #include <QStandardPaths>
 #include <QTabWidget>
+#include <QThread>
 
 #include <QtDebug>
 
@@ -25,6 +30,12 @@ SettingsPrivate::SettingsPrivate(const QString &organization, const QString &app
 	if (isCustomColors()) {
 		QApplication::setPalette(this->customPalette());
 	}
+
+	// Values which can't be changed through one of these signals are updated by their setter
+	this->updateSnapshot();
+	connect(this, &SettingsPrivate::fontHasChanged, this, &SettingsPrivate::updateSnapshot);
+	connect(this, &SettingsPrivate::librarySearchModeHasChanged, this, &SettingsPrivate::updateSnapshot);
+	connect(Settings::instance(), &Settings::viewPropertyChanged, this, &SettingsPrivate::updateSnapshot);
 }
 
 /** Singleton pattern to be able to easily use SettingsPrivate everywhere in the app. */
@@ -40,7 +51,7 @@ SettingsPrivate* SettingsPrivate::instance()
 /** Add an activated plugin to the application. */
 void SettingsPrivate::addPlugin(const PluginInfo &plugin)
 {
-	QMap<QString, QVariant> map = value("plugins").toMap();
+	QMap<QString, QVariant> map = lookup("plugins").toMap();
 	map.insert(plugin.absFilePath(), QVariant::fromValue(plugin));
 	this->setValue("plugins", map);
 }
@@ -48,7 +59,7 @@ void SettingsPrivate::addPlugin(const PluginInfo &plugin)
 /** Disable a previously registered plugin (so it still can be listed in options). */
 void SettingsPrivate::disablePlugin(const QString &absFilePath)
 {
-	QMap<QString, QVariant> map = value("plugins").toMap();
+	QMap<QString, QVariant> map = lookup("plugins").toMap();
 	PluginInfo pluginInfo = map.value(absFilePath).value<PluginInfo>();
 	pluginInfo.setEnabled(false);
 	map.insert(absFilePath, QVariant::fromValue(pluginInfo));
@@ -58,50 +69,50 @@ void SettingsPrivate::disablePlugin(const QString &absFilePath)
 /** Returns true if the background color in playlist is using alternatative colors. */
 bool SettingsPrivate::colorsAlternateBG() const
 {
-	return value("colorsAlternateBG", true).toBool();
+	return lookup("colorsAlternateBG", true).toBool();
 }
 
 bool SettingsPrivate::copyTracksFromPlaylist() const
 {
-	return value("copyTracksFromPlaylist", false).toBool();
+	return lookup("copyTracksFromPlaylist", false).toBool();
 }
 
 const QString SettingsPrivate::customIcon(const QString &buttonName) const
 {
-	return value("customIcons/" + buttonName).toString();
+	return lookup("customIcons/" + buttonName).toString();
 }
 
 QPalette SettingsPrivate::customPalette() const
 {
-	if (value("customPalette").isNull()) {
+	if (lookup("customPalette").isNull()) {
 		return _standardPalette;
 	} else {
-		return value("customPalette").value<QPalette>();
+		return lookup("customPalette").value<QPalette>();
 	}
 }
 
 QString SettingsPrivate::defaultLocationFileExplorer() const
 {
-	if (value("defaultLocationFileExplorer").isNull()) {
+	if (lookup("defaultLocationFileExplorer").isNull()) {
 		QStringList l = QStandardPaths::standardLocations(QStandardPaths::MusicLocation);
 		if (!l.isEmpty()) {
 			return l.first();
 		}
 	} else {
-		return value("defaultLocationFileExplorer").toString();
+		return lookup("defaultLocationFileExplorer").toString();
 	}
 	return "/";
 }
 
 SettingsPrivate::DragDropAction SettingsPrivate::dragDropAction() const
 {
-	return static_cast<SettingsPrivate::DragDropAction>(value("dragDropAction").toInt());
+	return static_cast<SettingsPrivate::DragDropAction>(lookup("dragDropAction").toInt());
 }
 
 /** Returns the font of the application. */
 QFont SettingsPrivate::font(const FontFamily fontFamily)
 {
-	fontFamilyMap = this->value("fontFamilyMap").toMap();
+	fontFamilyMap = this->lookup("fontFamilyMap").toMap();
 	QFont font;
 	QVariant vFont;
 	switch(fontFamily) {
@@ -141,7 +152,7 @@ QFont SettingsPrivate::font(const FontFamily fontFamily)
 /** Sets the font of the application. */
 int SettingsPrivate::fontSize(const FontFamily fontFamily)
 {
-	fontPointSizeMap = this->value("fontPointSizeMap").toMap();
+	fontPointSizeMap = this->lookup("fontPointSizeMap").toMap();
 	int pointSize = fontPointSizeMap.value(QString(fontFamily)).toInt();
 	if (pointSize == 0) {
 		#if defined(Q_OS_OSX)
@@ -155,79 +166,79 @@ int SettingsPrivate::fontSize(const FontFamily fontFamily)
 
 bool SettingsPrivate::hasCustomIcon(const QString &buttonName) const
 {
-	return value("customIcons/" + buttonName).isValid() && value("customIcons/" + buttonName).toBool();
+	return lookup("customIcons/" + buttonName).isValid() && lookup("customIcons/" + buttonName).toBool();
 }
 
 SettingsPrivate::InsertPolicy SettingsPrivate::insertPolicy() const
 {
-	if (value("insertPolicy").isNull()) {
+	if (lookup("insertPolicy").isNull()) {
 		return SettingsPrivate::IP_Artists;
 	} else {
-		int i = value("insertPolicy").toInt();
+		int i = lookup("insertPolicy").toInt();
 		return (SettingsPrivate::InsertPolicy)i;
 	}
 }
 
 bool SettingsPrivate::isCustomColors() const
 {
-	return value("customColors", false).toBool();
+	return lookup("customColors", false).toBool();
 }
 
 bool SettingsPrivate::isCustomTextColorOverriden() const
 {
-	bool b = value("customTextColorOverriden", false).toBool();
+	bool b = lookup("customTextColorOverriden", false).toBool();
 	return b && isCustomColors();
 }
 
 bool SettingsPrivate::isExtendedSearchVisible() const
 {
-	return value("extendedSearchVisible", true).toBool();
+	return lookup("extendedSearchVisible", true).toBool();
 }
 
 /** Returns true if background process is active to keep library up-to-date. */
 bool SettingsPrivate::isFileSystemMonitored() const
 {
-	return value("monitorFileSystem", true).toBool();
+	return lookup("monitorFileSystem", true).toBool();
 }
 
 /** Returns the hierarchical order of the library tree view. */
 bool SettingsPrivate::isLibraryFilteredByArticles() const
 {
-	return value("isLibraryFilteredByArticles", false).toBool();
+	return lookup("isLibraryFilteredByArticles", false).toBool();
 }
 
 bool SettingsPrivate::isPlaylistResizeColumns() const
 {
-	return value("playlistResizeColumns", true).toBool();
+	return lookup("playlistResizeColumns", true).toBool();
 }
 
 /** Returns true if tabs should be displayed like rectangles. */
 bool SettingsPrivate::isRectTabs() const
 {
-	return value("rectangularTabs", false).toBool();
+	return lookup("rectangularTabs", false).toBool();
 }
 
 bool SettingsPrivate::isRemoteControlEnabled() const
 {
-	return value("remoteControl").toBool();
+	return lookup("remoteControl").toBool();
 }
 
 /** Returns true if the article should be displayed after artist's name. */
 bool SettingsPrivate::isReorderArtistsArticle() const
 {
-	return value("reorderArtistsArticle", false).toBool();
+	return lookup("reorderArtistsArticle", false).toBool();
 }
 
 /** Returns true if a user has modified one of defaults theme. */
 bool SettingsPrivate::isButtonThemeCustomized() const
 {
-	return value("buttonThemeCustomized", false).toBool();
+	return lookup("buttonThemeCustomized", false).toBool();
 }
 
 /** Returns the language of the application. */
 QString SettingsPrivate::language()
 {
-	QString l = value("language").toString();
+	QString l = lookup("language").toString();
 	if (l.isEmpty()) {
 		l = QLocale::system().uiLanguages().first().left(2);
 		setValue("language", l);
@@ -240,18 +251,18 @@ QString SettingsPrivate::language()
 /** Returns the last active playlist header state. */
 QByteArray SettingsPrivate::lastActivePlaylistGeometry() const
 {
-	return value("lastActivePlaylistGeometry").toByteArray();
+	return lookup("lastActivePlaylistGeometry").toByteArray();
 }
 
 QByteArray SettingsPrivate::lastActiveViewGeometry(const QString &menuAction) const
 {
-	return value(menuAction).toByteArray();
+	return lookup(menuAction).toByteArray();
 }
 
 /** Returns the last playlists that were opened when player was closed. */
 QList<uint> SettingsPrivate::lastPlaylistSession() const
 {
-	QList<QVariant> l = value("currentSessionPlaylists").toList();
+	QList<QVariant> l = lookup("currentSessionPlaylists").toList();
 	QList<uint> playlistIds;
 	for (int i = 0; i < l.count(); i++) {
 		playlistIds.append(l.at(i).toUInt());
@@ -261,7 +272,7 @@ QList<uint> SettingsPrivate::lastPlaylistSession() const
 
 QStringList SettingsPrivate::libraryFilteredByArticles() const
 {
-	QVariant vArticles = value("libraryFilteredByArticles");
+	QVariant vArticles = lookup("libraryFilteredByArticles");
 	if (vArticles.isValid()) {
 		return vArticles.toStringList();
 	} else {
@@ -271,10 +282,10 @@ QStringList SettingsPrivate::libraryFilteredByArticles() const
 
 SettingsPrivate::LibrarySearchMode SettingsPrivate::librarySearchMode() const
 {
-	if (value("librarySearchMode").isNull()) {
+	if (lookup("librarySearchMode").isNull()) {
 		return SettingsPrivate::LSM_Filter;
 	} else {
-		int i = value("librarySearchMode").toInt();
+		int i = lookup("librarySearchMode").toInt();
 		return (SettingsPrivate::LibrarySearchMode)i;
 	}
 }
@@ -282,42 +293,42 @@ SettingsPrivate::LibrarySearchMode SettingsPrivate::librarySearchMode() const
 QStringList SettingsPrivate::musicLocations() const
 {
 	QStringList list;
-	list.append(value("musicLocations").toStringList());
+	list.append(lookup("musicLocations").toStringList());
 	return list;
 }
 
 int SettingsPrivate::tabsOverlappingLength() const
 {
-	return value("tabsOverlappingLength", 10).toInt();
+	return lookup("tabsOverlappingLength", 10).toInt();
 }
 
 /// PlayBack options
 qint64 SettingsPrivate::playbackSeekTime() const
 {
-	return value("playbackSeekTime", 5000).toLongLong();
+	return lookup("playbackSeekTime", 5000).toLongLong();
 }
 
 /** Default action to execute when one is closing a playlist. */
 SettingsPrivate::PlaylistDefaultAction SettingsPrivate::playbackDefaultActionForClose() const
 {
-	return static_cast<SettingsPrivate::PlaylistDefaultAction>(value("playbackDefaultActionForClose").toInt());
+	return static_cast<SettingsPrivate::PlaylistDefaultAction>(lookup("playbackDefaultActionForClose").toInt());
 }
 
 /** Automatically save all playlists before exit. */
 bool SettingsPrivate::playbackKeepPlaylists() const
 {
-	return value("playbackKeepPlaylists", false).toBool();
+	return lookup("playbackKeepPlaylists", false).toBool();
 }
 
 /** Automatically restore all saved playlists at startup. */
 bool SettingsPrivate::playbackRestorePlaylistsAtStartup() const
 {
-	return value("playbackRestorePlaylistsAtStartup", false).toBool();
+	return lookup("playbackRestorePlaylistsAtStartup", false).toBool();
 }
 
 QMap<QString, PluginInfo> SettingsPrivate::plugins() const
 {
-	QMap<QString, QVariant> list = value("plugins").toMap();
+	QMap<QString, QVariant> list = lookup("plugins").toMap();
 	QMapIterator<QString, QVariant> it(list);
 	QMap<QString, PluginInfo> registeredPlugins;
 	while (it.hasNext()) {
@@ -332,7 +343,14 @@ QMap<QString, PluginInfo> SettingsPrivate::plugins() const
 
 uint SettingsPrivate::remoteControlPort() const
 {
-	return value("remoteControlPort", 5600).toUInt();
+	return lookup("remoteControlPort", 5600).toUInt();
+}
+
+/** Returns the number of threads reading tags when the library is scanned. */
+int SettingsPrivate::scanWorkerCount() const
+{
+	int count = lookup("scanWorkerCount", QThread::idealThreadCount()).toInt();
+	return qMax(1, count);
 }
 
 void SettingsPrivate::setCustomColorRole(QPalette::ColorRole cr, const QColor &color)
@@ -458,7 +476,7 @@ void SettingsPrivate::setLastPlaylistSession(const QList<uint> &ids)
 
 void SettingsPrivate::setMusicLocations(const QStringList &locations)
 {
-	QStringList old = value("musicLocations").toStringList();
+	QStringList old = lookup("musicLocations").toStringList();
 	setValue("musicLocations", locations);
 	emit musicLocationsHaveChanged(old, locations);
 }
@@ -466,27 +484,40 @@ void SettingsPrivate::setMusicLocations(const QStringList &locations)
 void SettingsPrivate::setRemoteControlEnabled(bool b)
 {
 	setValue("remoteControl", b);
-	emit remoteControlChanged(b, value("remoteControlPort").toUInt());
+	emit remoteControlChanged(b, lookup("remoteControlPort").toUInt());
 }
 
 void SettingsPrivate::setShortcut(const QString &objectName, const QKeySequence &keySequence)
 {
-	QMap<QString, QVariant> shortcuts = value("shortcuts").toMap();
+	QMap<QString, QVariant> shortcuts = lookup("shortcuts").toMap();
 	shortcuts.insert(objectName, keySequence.toString());
 	setValue("shortcuts", shortcuts);
 }
 
 QKeySequence SettingsPrivate::shortcut(const QString &objectName) const
 {
-	return QKeySequence(value("shortcuts").toMap().value(objectName).toString());
+	return QKeySequence(lookup("shortcuts").toMap().value(objectName).toString());
+}
+
+/** Returns values read while painting rows, without any lookup in QSettings. Must be called from the GUI thread. */
+QSharedPointer<const SettingsSnapshot> SettingsPrivate::snapshot() const
+{
+	return _snapshot;
+}
+
+/** Reads a value from getters of this class, and counts the lookup: see SettingsSnapshot::lookups(). */
+QVariant SettingsPrivate::lookup(const QString &key, const QVariant &defaultValue) const
+{
+	SettingsSnapshot::countLookup();
+	return QSettings::value(key, defaultValue);
 }
 
 int SettingsPrivate::volumeBarHideAfter() const
 {
-	if (value("volumeBarHideAfter").isNull()) {
+	if (lookup("volumeBarHideAfter").isNull()) {
 		return 1;
 	} else {
-		return value("volumeBarHideAfter").toInt();
+		return lookup("volumeBarHideAfter").toInt();
 	}
 }
 
@@ -504,6 +535,32 @@ bool SettingsPrivate::initLanguage(const QString &lang)
 	return b;
 }
 
+/** Reads values of the snapshot once again, after one of them has changed. */
+void SettingsPrivate::updateSnapshot()
+{
+	static int version = 0;
+	Settings *settings = Settings::instance();
+
+	SettingsSnapshot *snapshot = new SettingsSnapshot;
+	snapshot->version = ++version;
+	snapshot->libraryFont = this->font(FF_Library);
+	snapshot->menuFont = this->font(FF_Menu);
+	snapshot->playlistFont = this->font(FF_Playlist);
+	snapshot->libraryFontHeight = QFontMetrics(snapshot->libraryFont).height();
+	snapshot->playlistFontHeight = QFontMetrics(snapshot->playlistFont).height();
+	snapshot->coverSizeLibraryTree = settings->coverSizeLibraryTree();
+	snapshot->coverSizeUniqueLibrary = settings->coverSizeUniqueLibrary();
+	snapshot->isCoverBelowTracksEnabled = settings->isCoverBelowTracksEnabled();
+	snapshot->coverBelowTracksOpacity = settings->coverBelowTracksOpacity();
+	snapshot->libraryHasStars = settings->libraryHasStars();
+	snapshot->isShowNeverScored = settings->isShowNeverScored();
+	snapshot->isCustomTextColorOverriden = this->isCustomTextColorOverriden();
+	snapshot->isReorderArtistsArticle = this->isReorderArtistsArticle();
+	snapshot->insertPolicy = this->insertPolicy();
+	snapshot->librarySearchMode = this->librarySearchMode();
+	_snapshot = QSharedPointer<const SettingsSnapshot>(snapshot);
+}
+
 void SettingsPrivate::setDefaultLocationFileExplorer(const QString &location)
 {
 	setValue("defaultLocationFileExplorer", location);
@@ -513,6 +570,7 @@ void SettingsPrivate::setDefaultLocationFileExplorer(const QString &location)
 void SettingsPrivate::setInsertPolicy(SettingsPrivate::InsertPolicy ip)
 {
 	setValue("insertPolicy", ip);
+	this->updateSnapshot();
 }
 
 /// SLOTS
@@ -520,7 +578,7 @@ void SettingsPrivate::setInsertPolicy(SettingsPrivate::InsertPolicy ip)
 /** Add a list of folders to settings. */
 void SettingsPrivate::addMusicLocations(const QList<QDir> &dirs)
 {
-	QStringList old = value("musicLocations").toStringList();
+	QStringList old = lookup("musicLocations").toStringList();
 	QStringList locations;
 	for (QDir d : dirs) {
 		if (!old.contains(QDir::toNativeSeparators(d.absolutePath()))) {
@@ -554,6 +612,7 @@ void SettingsPrivate::setCustomColors(bool b)
 	if (!b) {
 		QApplication::setPalette(_standardPalette);
 	}
+	this->updateSnapshot();
 }
 
 /** Sets custom text color instead of classic black or white. */
@@ -564,6 +623,7 @@ void SettingsPrivate::setCustomTextColorOverride(bool b)
 		this->setCustomColorRole(QPalette::Text, _standardPalette.color(QPalette::Text));
 		this->setCustomColorRole(QPalette::HighlightedText, _standardPalette.color(QPalette::HighlightedText));
 	}
+	this->updateSnapshot();
 }
 
 /** Sets the default action when one is dropping tracks or folders. */
@@ -641,6 +701,7 @@ void SettingsPrivate::setPlaybackKeepPlaylists(bool b)
 void SettingsPrivate::setReorderArtistsArticle(bool b)
 {
 	setValue("reorderArtistsArticle", b);
+	this->updateSnapshot();
 }
 
 void SettingsPrivate::setSearchAndExcludeLibrary(bool b)
@@ -666,6 +727,12 @@ void SettingsPrivate::setRemoteControlPort(uint port)
 	emit remoteControlChanged(true, port);
 }
 
+/** Sets the number of threads reading tags when the library is scanned. */
+void SettingsPrivate::setScanWorkerCount(int count)
+{
+	setValue("scanWorkerCount", count);
+}
+
 void SettingsPrivate::setTabsOverlappingLength(int l)
 {
 	setValue("tabsOverlappingLength", l);
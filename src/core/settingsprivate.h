@@ -5,10 +5,14 @@
 #include <QPushButton>
 #include <QSettings>
 #include <QTranslator>
+#include <QSharedPointer>
 #include "plugininfo.h"
 
 #include "miamcore_global.h"
 
+/// Forward declaration
+class SettingsSnapshot;
+
 /**
  * \brief		SettingsPrivate class contains all relevant pairs of (keys, values) used by Miam-Player.
  * \details		This class implements the Singleton pattern. Instead of using standard "this->value(QString)", lots of methods
@@ -35,6 +39,9 @@ private:
 
 	QPalette _standardPalette;
 
+	/** Values read while painting rows, built again when one of them has changed. */
+	QSharedPointer<const SettingsSnapshot> _snapshot;
+
 	Q_ENUMS(DragDropAction)
 	Q_ENUMS(FontFamily)
 	Q_ENUMS(InsertPolicy)
@@ -159,6 +166,9 @@ public:
 
 	uint remoteControlPort() const;
 
+	/** Returns the number of threads reading tags when the library is scanned. */
+	int scanWorkerCount() const;
+
 	void setCustomColorRole(QPalette::ColorRole cr, const QColor &color);
 
 	/** Custom icons in CustomizeTheme */
@@ -180,11 +190,21 @@ public:
 
 	QKeySequence shortcut(const QString &objectName) const;
 
+	/** Returns values read while painting rows, without any lookup in QSettings. Must be called from the GUI thread. */
+	QSharedPointer<const SettingsSnapshot> snapshot() const;
+
 	int volumeBarHideAfter() const;
 
 private:
 	bool initLanguage(const QString &lang);
 
+	/** Reads a value from getters of this class, and counts the lookup: see SettingsSnapshot::lookups(). */
+	QVariant lookup(const QString &key, const QVariant &defaultValue = QVariant()) const;
+
+private slots:
+	/** Reads values of the snapshot once again, after one of them has changed. */
+	void updateSnapshot();
+
 public:
 	void setDefaultLocationFileExplorer(const QString &location);
 
@@ -239,6 +259,9 @@ public slots:
 
 	void setRemoteControlPort(uint port);
 
+	/** Sets the number of threads reading tags when the library is scanned. */
+	void setScanWorkerCount(int count);
+
 	void setReorderArtistsArticle(bool b);
 
 	void setSearchAndExcludeLibrary(bool b);
@@ -0,0 +1,76 @@
+#include "settingssnapshot.h"
+
+#include <QAtomicInt>
+#include <QLoggingCategory>
+
+namespace {
+
+QAtomicInt lookupCount(0);
+QAtomicInt lastFrameLookupCount(0);
+
+/** Views are painted many times per second: messages are disabled unless QT_LOGGING_RULES="miam.settings.lookups.debug=true". */
+Q_LOGGING_CATEGORY(settingsLookups, "miam.settings.lookups", QtWarningMsg)
+
+}
+
+SettingsSnapshot::FrameCounter::FrameCounter(const char *view)
+	: _view(view)
+	, _firstLookup(SettingsSnapshot::lookups())
+{}
+
+SettingsSnapshot::FrameCounter::~FrameCounter()
+{
+	// Lookups made by other threads in the meantime are counted too, it's only a hint to find slow paint events
+	int count = SettingsSnapshot::lookups() - _firstLookup;
+	lastFrameLookupCount.store(count);
+	if (count > 0) {
+		qCDebug(settingsLookups) << _view << count << "settings were read in QSettings while painting";
+	}
+}
+
+SettingsSnapshot::SettingsSnapshot()
+	: version(0)
+	, libraryFontHeight(0)
+	, playlistFontHeight(0)
+	, coverSizeLibraryTree(48)
+	, coverSizeUniqueLibrary(100)
+	, isCoverBelowTracksEnabled(true)
+	, coverBelowTracksOpacity(0.66)
+	, libraryHasStars(true)
+	, isShowNeverScored(false)
+	, isCustomTextColorOverriden(false)
+	, isReorderArtistsArticle(false)
+	, insertPolicy(SettingsPrivate::IP_Artists)
+	, librarySearchMode(SettingsPrivate::LSM_Filter)
+{}
+
+QFont SettingsSnapshot::font(SettingsPrivate::FontFamily fontFamily) const
+{
+	switch (fontFamily) {
+	case SettingsPrivate::FF_Library:
+		return libraryFont;
+	case SettingsPrivate::FF_Menu:
+		return menuFont;
+	case SettingsPrivate::FF_Playlist:
+	default:
+		return playlistFont;
+	}
+}
+
+/** Called by getters of Settings and SettingsPrivate for each value read in QSettings. */
+void SettingsSnapshot::countLookup()
+{
+	lookupCount.ref();
+}
+
+/** Number of values read in QSettings since the application has started. */
+int SettingsSnapshot::lookups()
+{
+	return lookupCount.load();
+}
+
+/** Number of values read in QSettings while the last frame of a view was painted. */
+int SettingsSnapshot::lastFrameLookups()
+{
+	return lastFrameLookupCount.load();
+}
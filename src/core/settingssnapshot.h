@@ -0,0 +1,73 @@
+#ifndef SETTINGSSNAPSHOT_H
+#define SETTINGSSNAPSHOT_H
+
+#include <QFont>
+
+#include "settingsprivate.h"
+
+/**
+ * \brief		The SettingsSnapshot class holds typed values of settings which are read while painting rows.
+ * \details		Delegates and models call their getters for every cell, and each getter of Settings or SettingsPrivate is a
+ *				lookup in QSettings (fonts even parse two maps). A snapshot is built once by SettingsPrivate::snapshot(), then
+ *				is shared and never modified: when one of its values changes, SettingsPrivate builds a new one with a greater
+ *				version. Lookups made by getters of Settings and SettingsPrivate are counted, so that a view can check that a
+ *				frame was painted without them.
+ * \author      Matthieu Bachelier
+ * \copyright   GNU General Public License v3
+ */
+class MIAMCORE_LIBRARY SettingsSnapshot
+{
+public:
+	/** Counts lookups in QSettings while a view is painted, and logs them in category "miam.settings.lookups". */
+	class MIAMCORE_LIBRARY FrameCounter
+	{
+	private:
+		const char *_view;
+		int _firstLookup;
+
+	public:
+		explicit FrameCounter(const char *view);
+
+		~FrameCounter();
+	};
+
+	/** Incremented each time a snapshot is built, holders can compare it to update values they compute from it. */
+	int version;
+
+	QFont libraryFont;
+	QFont menuFont;
+	QFont playlistFont;
+
+	/** Height of rows in the library and in playlists, computed with fonts above. */
+	int libraryFontHeight;
+	int playlistFontHeight;
+
+	int coverSizeLibraryTree;
+	int coverSizeUniqueLibrary;
+	bool isCoverBelowTracksEnabled;
+	qreal coverBelowTracksOpacity;
+
+	bool libraryHasStars;
+	bool isShowNeverScored;
+
+	bool isCustomTextColorOverriden;
+	bool isReorderArtistsArticle;
+
+	SettingsPrivate::InsertPolicy insertPolicy;
+	SettingsPrivate::LibrarySearchMode librarySearchMode;
+
+	SettingsSnapshot();
+
+	QFont font(SettingsPrivate::FontFamily fontFamily) const;
+
+	/** Called by getters of Settings and SettingsPrivate for each value read in QSettings. */
+	static void countLookup();
+
+	/** Number of values read in QSettings since the application has started. */
+	static int lookups();
+
+	/** Number of values read in QSettings while the last frame of a view was painted. */
+	static int lastFrameLookups();
+};
+
+#endif // SETTINGSSNAPSHOT_H
@@ -1,6 +1,6 @@
 #include "miamstyleditemdelegate.h"
 
-#include "settingsprivate.h"
+#include "settingssnapshot.h"
 
 #include <QApplication>
 #include <QPainter>
@@ -60,7 +60,7 @@ void MiamStyledItemDelegate::paint(QPainter *p, const QStyleOptionViewItem &opt,
 	p->restore();
 	if (!_fallback) {
 		if (o.state.testFlag(QStyle::State_Selected)) {
-			if (SettingsPrivate::instance()->isCustomTextColorOverriden()) {
+			if (SettingsPrivate::instance()->snapshot()->isCustomTextColorOverriden) {
 				p->setPen(o.palette.highlightedText().color());
 			} else if ((o.palette.highlight().color().lighter(lighterValue).saturation() - o.palette.highlightedText().color().saturation()) < 128) {
 				p->setPen(o.palette.text().color());
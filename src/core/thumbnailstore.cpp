@@ -0,0 +1,106 @@
+#include "thumbnailstore.h"
+
+#include "cover.h"
+#include "filehelper.h"
+#include "settingsprivate.h"
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <memory>
+
+#include <QtDebug>
+
+/** Folder where thumbnails are stored, with one subfolder per size. */
+QString ThumbnailStore::location()
+{
+	static const QString path = QString("%1/%2/%3/thumbnails").arg(QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation),
+																	SettingsPrivate::instance()->organizationName(),
+																	SettingsPrivate::instance()->applicationName());
+	return path;
+}
+
+/** Removes thumbnails of covers which have been removed from the library. */
+void ThumbnailStore::remove(const QStringList &coverPaths)
+{
+	QDir store(location());
+	for (QString size : store.entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+		for (QString coverPath : coverPaths) {
+			QFile::remove(thumbnailPath(coverPath, size.toInt()));
+		}
+	}
+}
+
+/** Returns a stored thumbnail, or reads and scales the cover then stores it. Returns a null image if the cover is unreadable. */
+QImage ThumbnailStore::thumbnail(const QString &coverPath, int size)
+{
+	QFileInfo source(coverPath);
+	if (!source.exists()) {
+		return QImage();
+	}
+
+	// Tracks and pictures which were modified after the thumbnail was stored need to be read again
+	QString path = thumbnailPath(coverPath, size);
+	QFileInfo stored(path);
+	if (stored.exists() && stored.lastModified() >= source.lastModified()) {
+		QImage image(path, "JPG");
+		if (!image.isNull()) {
+			return image;
+		}
+	}
+
+	QImage image = readCover(coverPath, size);
+	if (image.isNull()) {
+		return image;
+	}
+
+	QDir().mkpath(stored.absolutePath());
+	QSaveFile file(path);
+	if (file.open(QIODevice::WriteOnly)) {
+		QImageWriter writer(&file, "JPG");
+		writer.setQuality(90);
+		if (writer.write(image)) {
+			file.commit();
+		} else {
+			qDebug() << Q_FUNC_INFO << writer.errorString();
+			file.cancelWriting();
+		}
+	}
+	return image;
+}
+
+/** Extracts the picture embedded in a track, or reads a picture file, and scales it while decoding. */
+QImage ThumbnailStore::readCover(const QString &coverPath, int size)
+{
+	// The buffer reads the picture of TagLib without copying it, the cover must outlive the reader
+	std::unique_ptr<Cover> cover;
+	QImageReader imageReader;
+	QBuffer buffer;
+	QString suffix = QFileInfo(coverPath).suffix().toLower();
+	if (FileHelper::suffixes().contains(suffix)) {
+		FileHelper fh(coverPath, FileHelper::OM_TagsOnly);
+		cover.reset(fh.extractCover());
+		if (!cover) {
+			return QImage();
+		}
+		buffer.setData(cover->byteArray());
+		imageReader.setDevice(&buffer);
+	} else {
+		imageReader.setFileName(QDir::fromNativeSeparators(coverPath));
+	}
+	imageReader.setScaledSize(QSize(size, size));
+	return imageReader.read();
+}
+
+QString ThumbnailStore::thumbnailPath(const QString &coverPath, int size)
+{
+	QByteArray hash = QCryptographicHash::hash(coverPath.toUtf8(), QCryptographicHash::Sha1).toHex();
+	return QString("%1/%2/%3.jpg").arg(location()).arg(size).arg(QString::fromLatin1(hash));
+}
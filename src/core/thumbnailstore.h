@@ -0,0 +1,40 @@
+#ifndef THUMBNAILSTORE_H
+#define THUMBNAILSTORE_H
+
+#include <QImage>
+#include <QStringList>
+
+#include "miamcore_global.h"
+
+/**
+ * \brief		The ThumbnailStore class keeps pre-scaled covers on disk between sessions.
+ * \details		Each cover is stored once per size as a small JPEG file, in the same folder as the database. A cover is either
+ *				a picture next to tracks or a track with an embedded picture: the file name is a hash of this path, and a
+ *				thumbnail is valid while it's newer than its source. At startup, covers are then read without parsing tags
+ *				nor decoding full resolution pictures. Methods can be called from any thread.
+ * \author      Matthieu Bachelier
+ * \copyright   GNU General Public License v3
+ */
+class MIAMCORE_LIBRARY ThumbnailStore
+{
+private:
+	ThumbnailStore() {}
+
+public:
+	/** Folder where thumbnails are stored, with one subfolder per size. */
+	static QString location();
+
+	/** Removes thumbnails of covers which have been removed from the library. */
+	static void remove(const QStringList &coverPaths);
+
+	/** Returns a stored thumbnail, or reads and scales the cover then stores it. Returns a null image if the cover is unreadable. */
+	static QImage thumbnail(const QString &coverPath, int size);
+
+private:
+	/** Extracts the picture embedded in a track, or reads a picture file, and scales it while decoding. */
+	static QImage readCover(const QString &coverPath, int size);
+
+	static QString thumbnailPath(const QString &coverPath, int size);
+};
+
+#endif // THUMBNAILSTORE_H
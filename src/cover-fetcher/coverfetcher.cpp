@@ -124,7 +124,7 @@ void CoverFetcher::fetch(SelectedTracksModel *selectedTracksModel)
 
 		QPixmap p;
 		if (!internalCover.isEmpty()) {
-			FileHelper fh(internalCover);
+			FileHelper fh(internalCover, FileHelper::OM_TagsOnly);
 			Cover *c = fh.extractCover();
 			if (c && p.loadFromData(c->byteArray())) {
 				currentCover->setPixmap(p);
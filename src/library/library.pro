@@ -17,6 +17,7 @@ SOURCES += albumitem.cpp \
     librarytreeview.cpp \
     miamitemdelegate.cpp \
     miamitemmodel.cpp \
+    modelreadertask.cpp \
     separatoritem.cpp \
     trackitem.cpp \
     yearitem.cpp
@@ -35,6 +36,7 @@ HEADERS += albumitem.h \
     miamitemdelegate.h \
     miamitemmodel.h \
     miamlibrary_global.hpp \
+    modelreadertask.h \
     separatoritem.h \
     trackitem.h \
     yearitem.h
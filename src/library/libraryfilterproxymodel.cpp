@@ -1,6 +1,6 @@
 #include "libraryfilterproxymodel.h"
 
-#include <settingsprivate.h>
+#include <settingssnapshot.h>
 
 #include <QtDebug>
 
@@ -12,12 +12,30 @@ LibraryFilterProxyModel::LibraryFilterProxyModel(QObject *parent) :
 QVariant LibraryFilterProxyModel::data(const QModelIndex &index, int role) const
 {
 	if (role == Qt::FontRole) {
-		return SettingsPrivate::instance()->font(SettingsPrivate::FF_Library);
+		return SettingsPrivate::instance()->snapshot()->libraryFont;
 	} else {
 		return MiamSortFilterProxyModel::data(index, role);
 	}
 }
 
+/** Redefined to read children which are not in the library yet, every track has to be searched. */
+void LibraryFilterProxyModel::findMusic(const QString &text)
+{
+	if (!text.isEmpty()) {
+		this->fetchAll(QModelIndex());
+	}
+	MiamSortFilterProxyModel::findMusic(text);
+}
+
+/** Filters items again once they were replaced by the library, their children have to be read first. */
+void LibraryFilterProxyModel::refreshFilter()
+{
+	if (!filterRegExp().isEmpty()) {
+		this->fetchAll(QModelIndex());
+		this->invalidateFilter();
+	}
+}
+
 bool LibraryFilterProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
 {
 	if (filterAcceptsRowItself(sourceRow, sourceParent)) {
@@ -48,7 +66,7 @@ bool LibraryFilterProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex
 			}
 		}
 	}
-	return (SettingsPrivate::instance()->librarySearchMode() == SettingsPrivate::LSM_HighlightOnly);
+	return (SettingsPrivate::instance()->snapshot()->librarySearchMode == SettingsPrivate::LSM_HighlightOnly);
 }
 
 /** Redefined for custom sorting. */
@@ -70,7 +88,7 @@ bool LibraryFilterProxyModel::lessThan(const QModelIndex &idxLeft, const QModelI
 		if (rType == Miam::IT_Album) {
 			int lYear = left->data(Miam::DF_Year).toInt();
 			int rYear = right->data(Miam::DF_Year).toInt();
-			if (SettingsPrivate::instance()->insertPolicy() == SettingsPrivate::IP_Artists && lYear >= 0 && rYear >= 0) {
+			if (SettingsPrivate::instance()->snapshot()->insertPolicy == SettingsPrivate::IP_Artists && lYear >= 0 && rYear >= 0) {
 				if (sortOrder() == Qt::AscendingOrder) {
 					if (lYear == rYear) {
 						result = MiamSortFilterProxyModel::lessThan(idxLeft, idxRight);
@@ -99,7 +117,7 @@ bool LibraryFilterProxyModel::lessThan(const QModelIndex &idxLeft, const QModelI
 
 	case Miam::IT_Separator:
 		// Separators have a different sorting order when Hierarchical Order starts with Years
-		if (SettingsPrivate::instance()->insertPolicy() == SettingsPrivate::IP_Years) {
+		if (SettingsPrivate::instance()->snapshot()->insertPolicy == SettingsPrivate::IP_Years) {
 			if (sortOrder() == Qt::AscendingOrder) {
 				result = left->data(Miam::DF_NormalizedString).toInt() <= right->data(Miam::DF_NormalizedString).toInt();
 			} else {
@@ -165,6 +183,18 @@ bool LibraryFilterProxyModel::lessThan(const QModelIndex &idxLeft, const QModelI
 	return result;
 }
 
+/** Reads children of items which were never expanded, recursively. */
+void LibraryFilterProxyModel::fetchAll(const QModelIndex &sourceParent)
+{
+	QAbstractItemModel *model = sourceModel();
+	if (model->canFetchMore(sourceParent)) {
+		model->fetchMore(sourceParent);
+	}
+	for (int i = 0; i < model->rowCount(sourceParent); i++) {
+		this->fetchAll(model->index(i, 0, sourceParent));
+	}
+}
+
 bool LibraryFilterProxyModel::filterAcceptsRowItself(int sourceRow, const QModelIndex &sourceParent) const
 {
 	return MiamSortFilterProxyModel::filterAcceptsRow(sourceRow, sourceParent);
@@ -24,6 +24,12 @@ public:
 	/** Redefined to override Qt::FontRole. */
 	virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
 
+	/** Redefined to read children which are not in the library yet, every track has to be searched. */
+	void findMusic(const QString &text);
+
+	/** Filters items again once they were replaced by the library, their children have to be read first. */
+	void refreshFilter();
+
 protected:
 	/** Redefined from QSortFilterProxyModel. */
 	virtual bool filterAcceptsRow(int sourceRow, const QModelIndex &parent) const override;
@@ -32,6 +38,9 @@ protected:
 	virtual bool lessThan(const QModelIndex &idxLeft, const QModelIndex &idxRight) const override;
 
 private:
+	/** Reads children of items which were never expanded, recursively. */
+	void fetchAll(const QModelIndex &sourceParent);
+
 	bool filterAcceptsRowItself(int sourceRow, const QModelIndex &sourceParent) const;
 	bool hasAcceptedChildren(int sourceRow, const QModelIndex &sourceParent) const;
 };
@@ -2,16 +2,12 @@
 
 #include <library/jumptowidget.h>
 #include <styling/imageutils.h>
-#include <cover.h>
+#include <covercache.h>
 #include <librarytreeview.h>
-#include <settingsprivate.h>
+#include <settingssnapshot.h>
 #include <starrating.h>
 
 #include <QApplication>
-#include <QDir>
-#include <QImageReader>
-
-#include <memory>
 
 #include <QtDebug>
 
@@ -31,14 +27,24 @@ LibraryItemDelegate::LibraryItemDelegate(LibraryTreeView *libraryTreeView, QSort
 		}
 	});
 
-	_coverSize = Settings::instance()->coverSizeLibraryTree();
+	_coverSize = SettingsPrivate::instance()->snapshot()->coverSizeLibraryTree;
+
+	// Repaint albums which were waiting for their cover
+	connect(CoverCache::instance(), &CoverCache::coverLoaded, this, [=](const QString &coverPath) {
+		for (const QPersistentModelIndex &index : _pendingCovers.values(coverPath)) {
+			if (index.isValid()) {
+				_libraryTreeView->update(index);
+			}
+		}
+		_pendingCovers.remove(coverPath);
+	});
 }
 
 void LibraryItemDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const
 {
 	painter->save();
-	auto settings = SettingsPrivate::instance();
-	painter->setFont(settings->font(SettingsPrivate::FF_Library));
+	auto settings = SettingsPrivate::instance()->snapshot();
+	painter->setFont(settings->libraryFont);
 	QStandardItem *item = _libraryModel->itemFromIndex(_proxy->mapToSource(index));
 	QStyleOptionViewItem o = option;
 	initStyleOption(&o, index);
@@ -68,8 +74,8 @@ void LibraryItemDelegate::paint(QPainter *painter, const QStyleOptionViewItem &o
 		this->drawLetter(painter, o, item);
 		break;
 	case Miam::IT_Track: {
-		SettingsPrivate::LibrarySearchMode lsm = settings->librarySearchMode();
-		if (Settings::instance()->isCoverBelowTracksEnabled() && ((_proxy->filterRegExp().isEmpty() && lsm == SettingsPrivate::LSM_Filter) ||
+		SettingsPrivate::LibrarySearchMode lsm = settings->librarySearchMode;
+		if (settings->isCoverBelowTracksEnabled && ((_proxy->filterRegExp().isEmpty() && lsm == SettingsPrivate::LSM_Filter) ||
 				lsm == SettingsPrivate::LSM_HighlightOnly)) {
 			this->paintCoverOnTrack(painter, o, item);
 		} else {
@@ -88,65 +94,58 @@ void LibraryItemDelegate::paint(QPainter *painter, const QStyleOptionViewItem &o
 /** Redefined to always display the same height for albums, even for those without one. */
 QSize LibraryItemDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const
 {
-	SettingsPrivate *settingsPrivate = SettingsPrivate::instance();
+	auto settings = SettingsPrivate::instance()->snapshot();
 	QStandardItem *item = _libraryModel->itemFromIndex(_proxy->mapToSource(index));
 	if (item->type() == Miam::IT_Album) {
-		QFontMetrics fmf(settingsPrivate->font(SettingsPrivate::FF_Library));
-		return QSize(option.rect.width(), qMax(fmf.height(), Settings::instance()->coverSizeLibraryTree() + 2));
+		return QSize(option.rect.width(), qMax(settings->libraryFontHeight, settings->coverSizeLibraryTree + 2));
 	} else {
-		QFontMetrics fmf(settingsPrivate->font(SettingsPrivate::FF_Library));
-		return QSize(option.rect.width(), fmf.height());
+		return QSize(option.rect.width(), settings->libraryFontHeight);
 	}
 }
 
 /** Albums have covers usually. */
 void LibraryItemDelegate::drawAlbum(QPainter *painter, QStyleOptionViewItem &option, QStandardItem *item) const
 {
-	/// XXX: reload cover with high resolution when one has increased coverSize (every 64px)
-	static QImageReader imageReader;
-	SettingsPrivate *settingsPrivate = SettingsPrivate::instance();
-
-	// Album has no picture yet
+	// Album has no picture yet: thumbnails are decoded in background, a placeholder is drawn meanwhile
+	QPixmap pixmap;
 	bool itemHasNoIcon = item->icon().isNull();
 	if (itemHasNoIcon) {
 
 		// Check first if an inner cover should be displayed
-		if (item->data(Miam::DF_InternalCover).toString().isEmpty()) {
-			QString coverPath = item->data(Miam::DF_CoverPath).toString();
-			if (!coverPath.isEmpty()) {
-				imageReader.setFileName(QDir::fromNativeSeparators(coverPath));
-				imageReader.setScaledSize(QSize(_coverSize, _coverSize));
-				QImage image = imageReader.read();
-				if (image.isNull()) {
-					itemHasNoIcon = true;
-					SqlDatabase db;
-					db.removeCoverForAlbum(false, item->data(Miam::DF_NormArtist).toString(), item->data(Miam::DF_NormAlbum).toString());
-					item->setData("", Miam::DF_CoverPath);
+		bool isInternalCover = !item->data(Miam::DF_InternalCover).toString().isEmpty();
+		QString coverPath;
+		if (isInternalCover) {
+			coverPath = item->data(Miam::DF_InternalCover).toString();
+		} else {
+			coverPath = item->data(Miam::DF_CoverPath).toString();
+		}
+		if (!coverPath.isEmpty()) {
+			CoverCache *coverCache = CoverCache::instance();
+			if (coverCache->hasFailed(coverPath)) {
+				// We couldn't read this cover: maybe the file was modified somewhere else
+				coverCache->forget(coverPath);
+				SqlDatabase db;
+				db.removeCoverForAlbum(isInternalCover, item->data(Miam::DF_NormArtist).toString(), item->data(Miam::DF_NormAlbum).toString());
+				if (isInternalCover) {
+					item->setData("", Miam::DF_InternalCover);
 				} else {
-					item->setIcon(QPixmap::fromImage(image));
-					itemHasNoIcon = false;
+					item->setData("", Miam::DF_CoverPath);
 				}
-			}
-		} else {
-			FileHelper fh(item->data(Miam::DF_InternalCover).toString());
-			std::unique_ptr<Cover> cover(fh.extractCover());
-			if (cover) {
-				QPixmap p;
-				if (p.loadFromData(cover->byteArray(), cover->format())) {
-					if (!p.isNull()) {
-						item->setIcon(p);
-						itemHasNoIcon = false;
+			} else {
+				pixmap = coverCache->cover(coverPath, _coverSize);
+				if (pixmap.isNull()) {
+					QPersistentModelIndex index = _proxy->mapFromSource(item->index());
+					if (!_pendingCovers.contains(coverPath, index)) {
+						_pendingCovers.insert(coverPath, index);
 					}
-				//} else {
-				//	qDebug() << Q_FUNC_INFO << "couldn't load data into QPixmap";
+				} else {
+					item->setIcon(pixmap);
+					itemHasNoIcon = false;
 				}
-			} else {
-				// We couldn't extract inner cover: maybe the file was modified somewhere else
-				SqlDatabase db;
-				db.removeCoverForAlbum(true, item->data(Miam::DF_NormArtist).toString(), item->data(Miam::DF_NormAlbum).toString());
-				item->setData("", Miam::DF_InternalCover);
 			}
 		}
+	} else {
+		pixmap = option.icon.pixmap(QSize(_coverSize, _coverSize));
 	}
 
 	painter->save();
@@ -170,8 +169,7 @@ void LibraryItemDelegate::drawAlbum(QPainter *painter, QStyleOptionViewItem &opt
 		painter->drawPixmap(cover, QPixmap(":/icons/disc"));
 	} else {
 		painter->setOpacity(_iconOpacity);
-		QPixmap p = option.icon.pixmap(QSize(_coverSize, _coverSize));
-		painter->drawPixmap(cover, p);
+		painter->drawPixmap(cover, pixmap);
 	}
 	painter->restore();
 
@@ -205,7 +203,7 @@ void LibraryItemDelegate::drawAlbum(QPainter *painter, QStyleOptionViewItem &opt
 		rectText = QRect(option.rect.x(), option.rect.y(), option.rect.width() - _coverSize - 5, option.rect.height());
 	}
 
-	QFontMetrics fmf(settingsPrivate->font(SettingsPrivate::FF_Library));
+	QFontMetrics fmf(SettingsPrivate::instance()->snapshot()->libraryFont);
 	QString s = fmf.elidedText(option.text, Qt::ElideRight, rectText.width());
 
 	this->paintText(painter, option, rectText, s, item);
@@ -213,8 +211,8 @@ void LibraryItemDelegate::drawAlbum(QPainter *painter, QStyleOptionViewItem &opt
 
 void LibraryItemDelegate::drawArtist(QPainter *painter, QStyleOptionViewItem &option, QStandardItem *item) const
 {
-	auto settings = SettingsPrivate::instance();
-	QFontMetrics fmf(settings->font(SettingsPrivate::FF_Library));
+	auto settings = SettingsPrivate::instance()->snapshot();
+	QFontMetrics fmf(settings->libraryFont);
 	option.textElideMode = Qt::ElideRight;
 	QRect rectText;
 	QString s;
@@ -222,7 +220,7 @@ void LibraryItemDelegate::drawArtist(QPainter *painter, QStyleOptionViewItem &op
 		QPoint topLeft(option.rect.x() + 5, option.rect.y());
 		rectText = QRect(topLeft, option.rect.bottomRight());
 		QString custom = item->data(Miam::DF_CustomDisplayText).toString();
-		if (!custom.isEmpty() && settings->isReorderArtistsArticle()) {
+		if (!custom.isEmpty() && settings->isReorderArtistsArticle) {
 			/// XXX: paint articles like ", the" in gray? Could be nice
 			s = fmf.elidedText(custom, Qt::ElideRight, rectText.width());
 		} else {
@@ -248,8 +246,8 @@ void LibraryItemDelegate::drawDisc(QPainter *painter, QStyleOptionViewItem &opti
 
 void LibraryItemDelegate::drawTrack(QPainter *painter, QStyleOptionViewItem &option, QStandardItem *track) const
 {
-	auto settings = Settings::instance();
-	if (settings->libraryHasStars()) {
+	auto settings = SettingsPrivate::instance()->snapshot();
+	if (settings->libraryHasStars) {
 		int r = track->data(Miam::DF_Rating).toInt();
 		QStyleOptionViewItem copy(option);
 		copy.rect = QRect(0, option.rect.y(), option.rect.x(), option.rect.height());
@@ -259,7 +257,7 @@ void LibraryItemDelegate::drawTrack(QPainter *painter, QStyleOptionViewItem &opt
 		StarRating starRating(r);
 		if (r > 0) {
 			starRating.paintStars(painter, copy, StarRating::EM_ReadOnly);
-		} else if (settings->isShowNeverScored()) {
+		} else if (settings->isShowNeverScored) {
 			starRating.paintStars(painter, copy, StarRating::EM_NoStarsYet);
 		}
 	}
@@ -268,7 +266,7 @@ void LibraryItemDelegate::drawTrack(QPainter *painter, QStyleOptionViewItem &opt
 
 void LibraryItemDelegate::paintCoverOnTrack(QPainter *painter, const QStyleOptionViewItem &opt, const QStandardItem *track) const
 {
-	Settings *settings = Settings::instance();
+	auto settings = SettingsPrivate::instance()->snapshot();
 	const QImage *image = _libraryTreeView->expandedCover(static_cast<AlbumItem*>(track->parent()));
 	if (image && !image->isNull()) {
 		// Copy QStyleOptionViewItem to be able to expand it to the left, and take the maximum available space
@@ -295,7 +293,7 @@ void LibraryItemDelegate::paintCoverOnTrack(QPainter *painter, const QStyleOptio
 		}
 
 		painter->save();
-		painter->setOpacity(1 - settings->coverBelowTracksOpacity());
+		painter->setOpacity(1 - settings->coverBelowTracksOpacity);
 		painter->drawImage(option.rect, subImage);
 
 		// Over paint black pixel in white
@@ -313,7 +311,7 @@ void LibraryItemDelegate::paintCoverOnTrack(QPainter *painter, const QStyleOptio
 			// Because the expanded border can look strange to one, is blurred with some gaussian function
 			leftBorder = leftBorder.scaled(t.width(), option.rect.height(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
 			leftBorder = ImageUtils::blurred(leftBorder, leftBorder.rect(), 10, false);
-			painter->setOpacity(1 - settings->coverBelowTracksOpacity());
+			painter->setOpacity(1 - settings->coverBelowTracksOpacity);
 			painter->drawImage(t, leftBorder);
 
 			QLinearGradient linearAlphaBrush(0, 0, leftBorder.width(), 0);
@@ -352,11 +350,11 @@ void LibraryItemDelegate::paintText(QPainter *p, const QStyleOptionViewItem &opt
 	p->save();
 	if (text.isEmpty()) {
 		p->setPen(opt.palette.mid().color());
-		QFontMetrics fmf(SettingsPrivate::instance()->font(SettingsPrivate::FF_Library));
+		QFontMetrics fmf(SettingsPrivate::instance()->snapshot()->libraryFont);
 		p->drawText(rectText, Qt::AlignVCenter, fmf.elidedText(tr("(empty)"), Qt::ElideRight, rectText.width()));
 	} else {
 		if (opt.state.testFlag(QStyle::State_Selected) || opt.state.testFlag(QStyle::State_MouseOver)) {
-			if (SettingsPrivate::instance()->isCustomTextColorOverriden()) {
+			if (SettingsPrivate::instance()->snapshot()->isCustomTextColorOverriden) {
 				p->setPen(opt.palette.highlightedText().color());
 			} else if (qAbs(opt.palette.highlight().color().lighter(lighterValue).value() - opt.palette.highlightedText().color().value()) < 128) {
 				p->setPen(opt.palette.text().color());
@@ -374,6 +372,37 @@ void LibraryItemDelegate::paintText(QPainter *p, const QStyleOptionViewItem &opt
 	p->restore();
 }
 
+/** Decodes covers of albums which are just above or below the viewport. */
+void LibraryItemDelegate::prefetchCovers(const QModelIndex &top, const QModelIndex &bottom, int rows) const
+{
+	CoverCache *coverCache = CoverCache::instance();
+	auto prefetch = [=](const QModelIndex &index) {
+		QStandardItem *item = _libraryModel->itemFromIndex(_proxy->mapToSource(index));
+		if (!item || item->type() != Miam::IT_Album || !item->icon().isNull()) {
+			return;
+		}
+		QString coverPath = item->data(Miam::DF_InternalCover).toString();
+		if (coverPath.isEmpty()) {
+			coverPath = item->data(Miam::DF_CoverPath).toString();
+		}
+		if (!coverPath.isEmpty()) {
+			coverCache->prefetch(coverPath, _coverSize);
+		}
+	};
+	QModelIndex above = top;
+	QModelIndex below = bottom;
+	for (int i = 0; i < rows; i++) {
+		if (above.isValid()) {
+			above = _libraryTreeView->indexAbove(above);
+			prefetch(above);
+		}
+		if (below.isValid()) {
+			below = _libraryTreeView->indexBelow(below);
+			prefetch(below);
+		}
+	}
+}
+
 void LibraryItemDelegate::displayIcon(bool b)
 {
 	if (b) {
@@ -386,5 +415,6 @@ void LibraryItemDelegate::displayIcon(bool b)
 void LibraryItemDelegate::updateCoverSize()
 {
 	qDebug() << Q_FUNC_INFO;
-	_coverSize = Settings::instance()->coverSizeLibraryTree();
+	_coverSize = SettingsPrivate::instance()->snapshot()->coverSizeLibraryTree;
+	_pendingCovers.clear();
 }
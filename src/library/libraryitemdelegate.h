@@ -29,6 +29,9 @@ private:
 
 	int _coverSize;
 
+	/** Albums which are displayed with a placeholder until their cover is decoded. */
+	mutable QMultiHash<QString, QPersistentModelIndex> _pendingCovers;
+
 public:
 	explicit LibraryItemDelegate(LibraryTreeView *libraryTreeView, QSortFilterProxyModel *proxy);
 
@@ -38,6 +41,9 @@ public:
 	/** Redefined to always display the same height for albums, even for those without one. */
 	virtual QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const override;
 
+	/** Decodes covers of albums which are just above or below the viewport. */
+	void prefetchCovers(const QModelIndex &top, const QModelIndex &bottom, int rows) const;
+
 protected:
 	/** Albums have covers usually. */
 	virtual void drawAlbum(QPainter *painter, QStyleOptionViewItem &option, QStandardItem *item) const override;
@@ -9,7 +9,6 @@
 
 #include <functional>
 
-#include <QRegularExpression>
 #include <QSqlQuery>
 #include <QSqlRecord>
 
@@ -22,268 +21,463 @@ LibraryItemModel::LibraryItemModel(QObject *parent)
 	setColumnCount(1);
 	_proxy->setSourceModel(this);
 	_proxy->setTopLevelItems(this->topLevelItems());
+
+	connect(this, &MiamItemModel::loaded, _proxy, &LibraryFilterProxyModel::refreshFilter);
 }
 
 LibraryItemModel::~LibraryItemModel()
 {}
 
-/** Read all tracks entries in the database and send them to connected views. */
-void LibraryItemModel::load(const QString &)
-{
-	this->reset();
-
-	SqlDatabase db;
+namespace {
+	/** Columns of each query, in the same order as in the query. */
+	enum ArtistColumn : int { AR_Id, AR_Name, AR_Normalized };
+	enum AlbumColumn : int { AL_Id, AL_Name, AL_Normalized, AL_Year, AL_Icon, AL_Host, AL_Artist, AL_ArtistNormalized, AL_Cover,
+							 AL_InternalCover };
+	enum TrackColumn : int { TR_Uri, TR_TrackNumber, TR_Title, TR_Artist, TR_Album, TR_Length, TR_Rating, TR_Disc, TR_Host, TR_ArtistId,
+							 TR_AlbumId, TR_Year };
+
+	const QString selectArtists = "SELECT id, name, normalizedName FROM artists";
+
+	/** Covers are taken from the first track which has one, tracks of an album are found with index on column albumId. */
+	const QString selectAlbums = "SELECT al.id, al.name, al.normalizedName, al.year, al.icon, al.host, ar.name, ar.normalizedName, " \
+								 "(SELECT cover FROM cache WHERE albumId = al.id AND cover IS NOT NULL LIMIT 1), " \
+								 "(SELECT internalCover FROM cache WHERE albumId = al.id AND internalCover IS NOT NULL LIMIT 1) " \
+								 "FROM albums al INNER JOIN artists ar ON ar.id = al.artistId";
+
+	const QString selectTracks = "SELECT uri, trackNumber, trackTitle, artist, album, trackLength, rating, disc, host, artistId, albumId, " \
+								 "IFNULL(albumYear, '') FROM cache";
+
+	/** Same as matching [\w], without running a regular expression for each item. */
+	inline bool hasWordCharacter(const QString &text)
+	{
+		for (const QChar &c : text) {
+			if (c.isLetterOrNumber() || c == '_') {
+				return true;
+			}
+		}
+		return false;
+	}
 
-	QSqlQuery q("SELECT uri, trackNumber, trackTitle, artist, artistNormalized, album, albumNormalized, artistAlbum, " \
-				"albumYear, trackLength, rating, disc, internalCover, cover, host, icon FROM cache ORDER BY uri, internalCover", db);
-	q.setForwardOnly(true);
-	if (!q.exec()) {
-		return;
+	/** Albums are read with their tracks later. */
+	ItemNode albumNode(const QSqlRecord &r, SettingsPrivate::InsertPolicy policy)
+	{
+		QString artistNormalized = r.value(AL_ArtistNormalized).toString();
+		QString albumNormalized = r.value(AL_Normalized).toString();
+
+		ItemNode album(Miam::IT_Album);
+		switch (policy) {
+		case SettingsPrivate::IP_Artists:
+		case SettingsPrivate::IP_Albums:
+			album.text = r.value(AL_Name).toString();
+			album.setData(hasWordCharacter(albumNormalized) ? albumNormalized : QString("0"), Miam::DF_NormalizedString);
+			break;
+		case SettingsPrivate::IP_ArtistsAlbums:
+		case SettingsPrivate::IP_Years:
+			album.text = r.value(AL_Artist).toString() + " – " + r.value(AL_Name).toString();
+			album.setData(artistNormalized + "|" + albumNormalized, Miam::DF_NormalizedString);
+			break;
+		}
+		album.setData(r.value(AL_Id).toUInt(), Miam::DF_ID);
+		album.setData(artistNormalized, Miam::DF_NormArtist);
+		album.setData(albumNormalized, Miam::DF_NormAlbum);
+		album.setData(r.value(AL_Year).toString(), Miam::DF_Year);
+		album.setData(r.value(AL_InternalCover).toString(), Miam::DF_InternalCover);
+		album.setData(r.value(AL_Cover).toString(), Miam::DF_CoverPath);
+		album.setData(r.value(AL_Icon).toString(), Miam::DF_IconPath);
+		album.setData(!r.value(AL_Host).toString().isEmpty(), Miam::DF_IsRemote);
+		album.setData(true, Miam::DF_ChildrenToFetch);
+		return album;
 	}
-	const int uri = 0, trackNumber = 1, trackTitle = 2, artist = 3, artistNorm = 4, album = 5, albumNorm = 6, artistAlbum = 7,
-			year = 8, trackLength = 9, rating = 10, disc = 11, internalCover = 12, cover = 13, host = 14, icon = 15;
-
-	// Lambda function to reduce duplicate code which is relevant in this method only
-	auto loadTrack = [=] (QSqlRecord& r) -> TrackItem* {
-		TrackItem *trackItem = new TrackItem;
-		trackItem->setText(r.value(trackTitle).toString());
-		trackItem->setData(r.value(uri).toString(), Miam::DF_URI);
-		trackItem->setData(r.value(trackNumber).toString(), Miam::DF_TrackNumber);
-		trackItem->setData(r.value(disc).toString(), Miam::DF_DiscNumber);
-		trackItem->setData(r.value(trackLength).toUInt(), Miam::DF_TrackLength);
-		if (r.value(rating).toInt() != -1) {
-			trackItem->setData(r.value(rating).toInt(), Miam::DF_Rating);
+
+	/** Artists are read with their albums later. */
+	ItemNode artistNode(const QSqlRecord &r, const QStringList &articles)
+	{
+		QString name = r.value(AR_Name).toString();
+		QString artistNormalized = r.value(AR_Normalized).toString();
+
+		ItemNode artist(Miam::IT_Artist);
+		artist.text = name;
+		for (QString filter : articles) {
+			if (name.startsWith(filter + " ", Qt::CaseInsensitive)) {
+				artist.setData(name.mid(filter.length() + 1) + ", " + filter, Miam::DF_CustomDisplayText);
+				break;
+			}
 		}
-		trackItem->setData(r.value(artist).toString(), Miam::DF_Artist);
-		trackItem->setData(r.value(album).toString(), Miam::DF_Album);
-		trackItem->setData(!r.value(host).toString().isEmpty(), Miam::DF_IsRemote);
-		return trackItem;
-	};
+		artist.setData(hasWordCharacter(artistNormalized) ? artistNormalized : QString("0"), Miam::DF_NormalizedString);
+		artist.setData(r.value(AR_Id).toUInt(), Miam::DF_ID);
+		artist.setData(true, Miam::DF_ChildrenToFetch);
+		return artist;
+	}
 
-	auto s = SettingsPrivate::instance();
-	switch (s->insertPolicy()) {
-	case SettingsPrivate::IP_Artists: {
-		QStringList filters;
-		if (s->isLibraryFilteredByArticles() && !s->libraryFilteredByArticles().isEmpty()) {
-			filters = s->libraryFilteredByArticles();
+	ItemNode trackNode(const QSqlRecord &r)
+	{
+		ItemNode track(Miam::IT_Track);
+		track.text = r.value(TR_Title).toString();
+		track.setData(r.value(TR_Uri).toString(), Miam::DF_URI);
+		track.setData(r.value(TR_TrackNumber).toString(), Miam::DF_TrackNumber);
+		track.setData(r.value(TR_Disc).toString(), Miam::DF_DiscNumber);
+		track.setData(r.value(TR_Length).toUInt(), Miam::DF_TrackLength);
+		if (r.value(TR_Rating).toInt() != -1) {
+			track.setData(r.value(TR_Rating).toInt(), Miam::DF_Rating);
 		}
+		track.setData(r.value(TR_Artist).toString(), Miam::DF_Artist);
+		track.setData(r.value(TR_Album).toString(), Miam::DF_Album);
+		track.setData(!r.value(TR_Host).toString().isEmpty(), Miam::DF_IsRemote);
+		return track;
+	}
 
-		QHash<uint, ArtistItem*> _artists;
-		QHash<uint, AlbumItem*> _albums;
+	/** Years are read with their albums later. */
+	ItemNode yearNode(const QString &year)
+	{
+		ItemNode node(Miam::IT_Year);
+		node.text = year;
+		node.setData(true, Miam::DF_ChildrenToFetch);
+		return node;
+	}
 
-		while (q.next()) {
-			QSqlRecord r = q.record();
-
-			ArtistItem *artistItem = new ArtistItem;
-			QString artistNormalized = r.value(artistNorm).toString();
-			QString albumNormalized = r.value(albumNorm).toString();
-			QString artist = r.value(3).toString();
-			QString aa = r.value(artistAlbum).toString();
-			artistItem->setText(aa);
-			for (QString filter : filters) {
-				if (artist.startsWith(filter + " ", Qt::CaseInsensitive)) {
-					artist = artist.mid(filter.length() + 1);
-					artistItem->setData(artist + ", " + filter, Miam::DF_CustomDisplayText);
-					break;
+	/** Builds top level items in a worker thread, with a copy of settings. */
+	void readTopLevelItems(SettingsPrivate::InsertPolicy policy, const QStringList &articles, QList<QList<QStandardItem*>> &rows)
+	{
+		SqlDatabase &db = *SqlDatabase::reader();
+		QSqlQuery q(db);
+		q.setForwardOnly(true);
+
+		switch (policy) {
+		case SettingsPrivate::IP_Artists:
+			if (q.exec(selectArtists)) {
+				while (q.next()) {
+					rows.append({ MiamItemModel::createItem(artistNode(q.record(), articles)) });
 				}
 			}
-
-			if (artistNormalized.isEmpty() || !artistNormalized.contains(QRegularExpression("[\\w]"))) {
-				artistItem->setData("0", Miam::DF_NormalizedString);
-			} else {
-				artistItem->setData(artistNormalized, Miam::DF_NormalizedString);
+			break;
+		case SettingsPrivate::IP_Albums:
+		case SettingsPrivate::IP_ArtistsAlbums:
+			if (q.exec(selectAlbums)) {
+				while (q.next()) {
+					rows.append({ MiamItemModel::createItem(albumNode(q.record(), policy)) });
+				}
 			}
-
-			// Add artist
-			if (_artists.contains(artistItem->hash())) {
-				auto it = _artists.find(artistItem->hash());
-				delete artistItem;
-				artistItem = (*it);
-			} else {
-				_artists.insert(artistItem->hash(), artistItem);
-				invisibleRootItem()->appendRow(artistItem);
-
-				// Also check if newly inserted artist needs to insert a separator
-				if (SeparatorItem *separator = this->insertSeparator(artistItem)) {
-					_topLevelItems.insert(separator, artistItem->index());
+			break;
+		case SettingsPrivate::IP_Years:
+			if (q.exec("SELECT DISTINCT year FROM albums")) {
+				while (q.next()) {
+					rows.append({ MiamItemModel::createItem(yearNode(q.value(0).toString())) });
 				}
 			}
+			break;
+		}
+	}
+}
 
-			AlbumItem *albumItem = new AlbumItem;
-			if (r.value(albumNorm).toString().isEmpty() || !r.value(albumNorm).toString().contains(QRegularExpression("[\\w]"))) {
-				albumItem->setData("0", Miam::DF_NormalizedString);
-			} else {
-				albumItem->setData(r.value(albumNorm).toString(), Miam::DF_NormalizedString);
-			}
-			albumItem->setData(artistNormalized, Miam::DF_NormArtist);
-			albumItem->setData(albumNormalized, Miam::DF_NormAlbum);
-			albumItem->setData(r.value(year).toString(), Miam::DF_Year);
-
-			QString internalCoverPath = r.value(internalCover).toString();
-			QString coverPath = r.value(cover).toString();
-
-			// Add album
-			if (_albums.contains(albumItem->hash())) {
-				auto it = _albums.find(albumItem->hash());
-				delete albumItem;
-				albumItem = *it;
-				if (albumItem->data(Miam::DF_InternalCover).toString().isEmpty() && !internalCoverPath.isEmpty()) {
-					albumItem->setData(internalCoverPath, Miam::DF_InternalCover);
-				}
-				if (albumItem->data(Miam::DF_CoverPath).toString().isEmpty() && !coverPath.isEmpty()) {
-					albumItem->setData(coverPath, Miam::DF_CoverPath);
-				}
-			} else {
+/** Redefined: items which were not expanded yet have their children in the database. */
+bool LibraryItemModel::canFetchMore(const QModelIndex &parent) const
+{
+	return parent.isValid() && parent.data(Miam::DF_ChildrenToFetch).toBool();
+}
 
-				albumItem->setText(r.value(album).toString());
-				albumItem->setData(internalCoverPath, Miam::DF_InternalCover);
-				albumItem->setData(coverPath, Miam::DF_CoverPath);
-				albumItem->setData(r.value(icon).toString(), Miam::DF_IconPath);
-				albumItem->setData(!r.value(host).toString().isEmpty(), Miam::DF_IsRemote);
+/** Redefined to read children of an artist, an album or a year from the database. */
+void LibraryItemModel::fetchMore(const QModelIndex &parent)
+{
+	QStandardItem *item = itemFromIndex(parent);
+	if (item == nullptr || !item->data(Miam::DF_ChildrenToFetch).toBool()) {
+		return;
+	}
+	item->setData(false, Miam::DF_ChildrenToFetch);
 
-				_albums.insert(albumItem->hash(), albumItem);
-				artistItem->appendRow(albumItem);
-			}
+	SqlDatabase &db = *SqlDatabase::reader();
+	QSqlQuery q(db);
+	q.setForwardOnly(true);
+	switch (item->type()) {
+	case Miam::IT_Artist:
+		q.prepare(selectAlbums + " WHERE al.artistId = ?");
+		q.addBindValue(item->data(Miam::DF_ID));
+		break;
+	case Miam::IT_Year:
+		q.prepare(selectAlbums + " WHERE al.year = ?");
+		q.addBindValue(item->data(Miam::DF_NormalizedString));
+		break;
+	case Miam::IT_Album:
+		q.prepare(selectTracks + " WHERE albumId = ?");
+		q.addBindValue(item->data(Miam::DF_ID));
+		break;
+	default:
+		return;
+	}
+	if (!q.exec()) {
+		return;
+	}
 
-			// Add tracks
-			albumItem->appendRow(loadTrack(r));
+	// Children are inserted all at once, views and proxy are notified only one time
+	SettingsPrivate::InsertPolicy policy = SettingsPrivate::instance()->insertPolicy();
+	QList<QStandardItem*> children;
+	while (q.next()) {
+		if (item->type() == Miam::IT_Album) {
+			children.append(this->cacheItem(trackNode(q.record())));
+		} else {
+			children.append(this->cacheItem(albumNode(q.record(), policy)));
 		}
-		break;
 	}
-	case SettingsPrivate::IP_Albums: {
+	item->appendRows(children);
+}
 
-		QHash<uint, AlbumItem*> _albums;
-		while (q.next()) {
-			QSqlRecord r = q.record();
-			QString artistNormalized = r.value(artistNorm).toString();
-			QString albumNormalized = r.value(albumNorm).toString();
-
-			AlbumItem *albumItem = new AlbumItem;
-			albumItem->setText(r.value(album).toString());
-			if (r.value(albumNorm).toString().isEmpty() || !r.value(albumNorm).toString().contains(QRegularExpression("[\\w]"))) {
-				albumItem->setData("0", Miam::DF_NormalizedString);
-			} else {
-				albumItem->setData(r.value(albumNorm).toString(), Miam::DF_NormalizedString);
-			}
-			albumItem->setData(artistNormalized, Miam::DF_NormArtist);
-			albumItem->setData(albumNormalized, Miam::DF_NormAlbum);
-			albumItem->setData(r.value(year).toString(), Miam::DF_Year);
-			if (!r.value(internalCover).toString().isEmpty()) {
-				albumItem->setData(r.value(internalCover).toString(), Miam::DF_InternalCover);
-			}
-			albumItem->setData(r.value(cover).toString(), Miam::DF_CoverPath);
-			albumItem->setData(r.value(icon).toString(), Miam::DF_IconPath);
-			albumItem->setData(!r.value(host).toString().isEmpty(), Miam::DF_IsRemote);
-
-			// Add album
-			if (_albums.contains(albumItem->hash())) {
-				auto it = _albums.find(albumItem->hash());
-				delete albumItem;
-				albumItem = (*it);
-			} else {
-				_albums.insert(albumItem->hash(), albumItem);
-				invisibleRootItem()->appendRow(albumItem);
-				// Also check if newly inserted artist needs to insert a separator
-				if (SeparatorItem *separator = this->insertSeparator(albumItem)) {
-					_topLevelItems.insert(separator, albumItem->index());
-				}
-			}
+/** Redefined to display an expand button next to items whose children were not read yet. */
+bool LibraryItemModel::hasChildren(const QModelIndex &parent) const
+{
+	return this->canFetchMore(parent) || MiamItemModel::hasChildren(parent);
+}
 
-			// Add tracks
-			albumItem->appendRow(loadTrack(r));
+/** Reads top level items in background, their children are read from the database when they're expanded. */
+void LibraryItemModel::load(const QString &)
+{
+	// Articles are read once, not for every inserted artist
+	auto s = SettingsPrivate::instance();
+	_articles.clear();
+	if (s->isLibraryFilteredByArticles() && !s->libraryFilteredByArticles().isEmpty()) {
+		_articles = s->libraryFilteredByArticles();
+	}
+
+	// Settings aren't read from worker threads, they get a copy of them
+	SettingsPrivate::InsertPolicy policy = s->insertPolicy();
+	QStringList articles = _articles;
+	this->readItemRows([policy, articles](QList<QList<QStandardItem*>> &rows) {
+		readTopLevelItems(policy, articles, rows);
+	});
+}
+
+/** Inserts tracks which were added or modified in the library, and removes deleted ones, without reloading everything. */
+void LibraryItemModel::updateTracks(const QStringList &updatedTracks, const QStringList &removedTracks)
+{
+	// Tags of modified tracks may have changed, so their parents can be different too
+	for (QString track : removedTracks + updatedTracks) {
+		if (TrackItem *trackItem = _tracks.value(track)) {
+			this->removeItem(trackItem);
 		}
-		break;
 	}
-	case SettingsPrivate::IP_ArtistsAlbums: {
-		QHash<uint, AlbumItem*> _albums;
-		while (q.next()) {
-			QSqlRecord r = q.record();
-			QString artistNormalized = r.value(artistNorm).toString();
-			QString albumNormalized = r.value(albumNorm).toString();
-
-			AlbumItem *albumItem = new AlbumItem;
-			albumItem->setText(r.value(artist).toString() + " – " + r.value(album).toString());
-			albumItem->setData(artistNormalized + "|" + albumNormalized, Miam::DF_NormalizedString);
-			albumItem->setData(artistNormalized, Miam::DF_NormArtist);
-			albumItem->setData(albumNormalized, Miam::DF_NormAlbum);
-			albumItem->setData(r.value(year).toString(), Miam::DF_Year);
-			albumItem->setData(r.value(cover).toString(), Miam::DF_CoverPath);
-			albumItem->setData(r.value(icon).toString(), Miam::DF_IconPath);
-			albumItem->setData(!r.value(host).toString().isEmpty(), Miam::DF_IsRemote);
-
-			// Add album
-			if (_albums.contains(albumItem->hash())) {
-				auto it = _albums.find(albumItem->hash());
-				delete albumItem;
-				albumItem = *it;
-			} else {
-				_albums.insert(albumItem->hash(), albumItem);
-				invisibleRootItem()->appendRow(albumItem);
-				// Also check if newly inserted artist needs to insert a separator
-				if (SeparatorItem *separator = this->insertSeparator(albumItem)) {
-					_topLevelItems.insert(separator, albumItem->index());
-				}
-			}
+	if (removedTracks.isEmpty() && updatedTracks.isEmpty()) {
+		return;
+	}
+	this->removeOrphans();
+
+	SqlDatabase &db = *SqlDatabase::reader();
+	QSqlQuery q(db);
+	q.setForwardOnly(true);
+	q.prepare(selectTracks + " WHERE uri = ?");
+	for (QString track : updatedTracks) {
+		q.addBindValue(track);
+		if (q.exec() && q.next()) {
+			this->insertUpdatedTrack(q.record());
+		}
+		q.finish();
+	}
+}
 
-			// Add tracks
-			albumItem->appendRow(loadTrack(r));
+/** Appends new top level items, and attaches them to their separators. */
+void LibraryItemModel::appendTopLevel(const QList<QStandardItem*> &items)
+{
+	invisibleRootItem()->appendRows(items);
+	for (QStandardItem *item : items) {
+		if (SeparatorItem *separator = this->insertSeparator(item)) {
+			_topLevelItems.insert(separator, item->index());
 		}
+	}
+}
+
+/** Keeps an item to find where tracks have to be inserted later. */
+QStandardItem* LibraryItemModel::cacheItem(QStandardItem *item)
+{
+	switch (item->type()) {
+	case Miam::IT_Artist:
+		_artists.insert(item->data(Miam::DF_ID).toUInt(), static_cast<ArtistItem*>(item));
+		break;
+	case Miam::IT_Album:
+		_albums.insert(item->data(Miam::DF_ID).toUInt(), static_cast<AlbumItem*>(item));
+		break;
+	case Miam::IT_Track:
+		_tracks.insert(item->data(Miam::DF_URI).toString(), static_cast<TrackItem*>(item));
+		break;
+	case Miam::IT_Year:
+		_years.insert(item->data(Miam::DF_NormalizedString).toString(), static_cast<YearItem*>(item));
+		break;
+	default:
 		break;
 	}
-	case SettingsPrivate::IP_Years: {
+	return item;
+}
 
-		QHash<uint, YearItem*> _years;
-		QHash<uint, AlbumItem*> _artistAlbums;
+/** Creates an item from a node, and keeps it to find where tracks have to be inserted later. */
+QStandardItem* LibraryItemModel::cacheItem(const ItemNode &node)
+{
+	return this->cacheItem(MiamItemModel::createItem(node));
+}
 
-		while (q.next()) {
-			QSqlRecord r = q.record();
-			YearItem *yearItem = new YearItem(r.value(year).toString());
-
-			// Add year
-			if (_years.contains(yearItem->hash())) {
-				auto it = _years.find(yearItem->hash());
-				delete yearItem;
-				yearItem = (*it);
-			} else {
-				_years.insert(yearItem->hash(), yearItem);
-				invisibleRootItem()->appendRow(yearItem);
+/** Inserts a track which was added or modified, or only its parent if this one has not been read yet. */
+void LibraryItemModel::insertUpdatedTrack(const QSqlRecord &track)
+{
+	SqlDatabase &db = *SqlDatabase::reader();
+	QSqlQuery q(db);
+	q.setForwardOnly(true);
 
-				// Also check if newly inserted artist needs to insert a separator
-				if (SeparatorItem *separator = this->insertSeparator(yearItem)) {
-					_topLevelItems.insert(separator, yearItem->index());
-				}
+	// Albums are top level items, except when they are grouped by artist or by year
+	SettingsPrivate::InsertPolicy policy = SettingsPrivate::instance()->insertPolicy();
+	QStandardItem *parent = nullptr;
+	switch (policy) {
+	case SettingsPrivate::IP_Artists: {
+		uint artistId = track.value(TR_ArtistId).toUInt();
+		parent = _artists.value(artistId);
+		if (parent == nullptr) {
+			q.prepare(selectArtists + " WHERE id = ?");
+			q.addBindValue(artistId);
+			if (q.exec() && q.next()) {
+				this->appendTopLevel({ this->cacheItem(artistNode(q.record(), _articles)) });
 			}
+			return;
+		}
+		break;
+	}
+	case SettingsPrivate::IP_Years: {
+		QString year = track.value(TR_Year).toString();
+		parent = _years.value(year);
+		if (parent == nullptr) {
+			this->appendTopLevel({ this->cacheItem(yearNode(year)) });
+			return;
+		}
+		break;
+	}
+	default:
+		break;
+	}
 
-			// Add Artist - Album
-			AlbumItem *artistAlbumItem = new AlbumItem;
-			artistAlbumItem->setText(r.value(3).toString() + " – " + r.value(album).toString());
-			artistAlbumItem->setData(r.value(artistNorm).toString() + "|" + r.value(albumNorm).toString(), Miam::DF_NormalizedString);
-			artistAlbumItem->setData(r.value(artistNorm).toString(), Miam::DF_NormArtist);
-			artistAlbumItem->setData(r.value(albumNorm).toString(), Miam::DF_NormAlbum);
-			artistAlbumItem->setData(r.value(year).toString(), Miam::DF_Year);
-			artistAlbumItem->setData(r.value(cover).toString(), Miam::DF_CoverPath);
-			artistAlbumItem->setData(r.value(icon).toString(), Miam::DF_IconPath);
-			artistAlbumItem->setData(!r.value(14).toString().isEmpty(), Miam::DF_IsRemote);
-
-			if (_artistAlbums.contains(artistAlbumItem->hash())) {
-				auto it = _artistAlbums.find(artistAlbumItem->hash());
-				delete artistAlbumItem;
-				artistAlbumItem = *it;
+	// This track will be read with other ones when its parent is expanded
+	if (parent && parent->data(Miam::DF_ChildrenToFetch).toBool()) {
+		return;
+	}
+	uint albumId = track.value(TR_AlbumId).toUInt();
+	AlbumItem *albumItem = _albums.value(albumId);
+	if (albumItem == nullptr) {
+		q.prepare(selectAlbums + " WHERE al.id = ?");
+		q.addBindValue(albumId);
+		if (q.exec() && q.next()) {
+			QStandardItem *item = this->cacheItem(albumNode(q.record(), policy));
+			if (parent) {
+				parent->appendRow(item);
 			} else {
-				_artistAlbums.insert(artistAlbumItem->hash(), artistAlbumItem);
-				yearItem->appendRow(artistAlbumItem);
+				this->appendTopLevel({ item });
 			}
-
-			// Add tracks
-			artistAlbumItem->appendRow(loadTrack(r));
 		}
-		break;
+	} else if (!albumItem->data(Miam::DF_ChildrenToFetch).toBool()) {
+		albumItem->appendRow(this->cacheItem(trackNode(track)));
 	}
+}
+
+/** Replaces every item by top level items built in background. */
+void LibraryItemModel::insertItemRows(const QList<QList<QStandardItem*>> &rows)
+{
+	this->reset();
+
+	QList<QStandardItem*> items;
+	items.reserve(rows.size());
+	for (const QList<QStandardItem*> &row : rows) {
+		items.append(this->cacheItem(row.first()));
 	}
+	this->appendTopLevel(items);
 
 	this->sort(0);
 }
 
+/** Removes an item, then its parents if they have no more children. */
+void LibraryItemModel::removeItem(QStandardItem *item)
+{
+	// Children which were already read are removed from caches with their parent
+	std::function<void(QStandardItem*)> forget;
+	forget = [this, &forget](QStandardItem *node) {
+		switch (node->type()) {
+		case Miam::IT_Artist:
+			_artists.remove(node->data(Miam::DF_ID).toUInt());
+			break;
+		case Miam::IT_Album:
+			_albums.remove(node->data(Miam::DF_ID).toUInt());
+			break;
+		case Miam::IT_Year:
+			_years.remove(node->data(Miam::DF_NormalizedString).toString());
+			break;
+		case Miam::IT_Track:
+			_tracks.remove(node->data(Miam::DF_URI).toString());
+			break;
+		default:
+			break;
+		}
+		for (int i = 0; i < node->rowCount(); i++) {
+			forget(node->child(i));
+		}
+	};
+	forget(item);
+
+	QStandardItem *parent = item->parent();
+	while (parent != nullptr) {
+		parent->removeRow(item->row());
+		if (parent->hasChildren()) {
+			return;
+		}
+		forget(parent);
+		item = parent;
+		parent = item->parent();
+	}
+
+	// Item has no parent: it's a top level item
+	for (auto it = _topLevelItems.begin(); it != _topLevelItems.end(); ) {
+		if (itemFromIndex(it.value()) == item) {
+			it = _topLevelItems.erase(it);
+		} else {
+			++it;
+		}
+	}
+	this->removeRow(item->row());
+}
+
+/** Removes artists, albums and years which were not expanded, and which have no more tracks in the database. */
+void LibraryItemModel::removeOrphans()
+{
+	SqlDatabase &db = *SqlDatabase::reader();
+	QSqlQuery q(db);
+	q.setForwardOnly(true);
+
+	// Triggers on table cache remove empty albums and artists: ids which are still in use are enough
+	QSet<uint> albumIds;
+	QSet<QString> years;
+	if (q.exec("SELECT id, year FROM albums")) {
+		while (q.next()) {
+			albumIds.insert(q.value(0).toUInt());
+			years.insert(q.value(1).toString());
+		}
+	}
+	QSet<uint> artistIds;
+	if (!_artists.isEmpty() && q.exec("SELECT id FROM artists")) {
+		while (q.next()) {
+			artistIds.insert(q.value(0).toUInt());
+		}
+	}
+
+	// Removing an item can also remove its parent, items are looked up again each time
+	for (uint albumId : _albums.keys()) {
+		AlbumItem *albumItem = _albums.value(albumId);
+		if (albumItem && !albumIds.contains(albumId)) {
+			this->removeItem(albumItem);
+		}
+	}
+	for (uint artistId : _artists.keys()) {
+		ArtistItem *artistItem = _artists.value(artistId);
+		if (artistItem && !artistIds.contains(artistId)) {
+			this->removeItem(artistItem);
+		}
+	}
+	for (QString year : _years.keys()) {
+		YearItem *yearItem = _years.value(year);
+		if (yearItem && !years.contains(year)) {
+			this->removeItem(yearItem);
+		}
+	}
+}
+
 /** For every item in the library, gets the top level letter attached to it. */
 QChar LibraryItemModel::currentLetter(const QModelIndex &iTop) const
 {
@@ -316,7 +510,6 @@ LibraryFilterProxyModel* LibraryItemModel::proxy() const
 /** Rebuild the list of separators when one has changed grammatical articles in options. */
 void LibraryItemModel::rebuildSeparators()
 {
-	SqlDatabase db;
 	auto s = SettingsPrivate::instance();
 	QStringList filters;
 	if (s->isLibraryFilteredByArticles() && !s->libraryFilteredByArticles().isEmpty()) {
@@ -331,14 +524,14 @@ void LibraryItemModel::rebuildSeparators()
 			if (!i.value().data(Miam::DF_CustomDisplayText).toString().isEmpty()) {
 				item->setData(QString(), Miam::DF_CustomDisplayText);
 				// Recompute standard normalized name: "The Artist" -> "theartist"
-				item->setData(db.normalizeField(item->text()), Miam::DF_NormalizedString);
+				item->setData(SqlDatabase::normalizeField(item->text()), Miam::DF_NormalizedString);
 			} else if (!filters.isEmpty()) {
 				for (QString filter : filters) {
 					QString text = item->text();
 					if (text.startsWith(filter + " ", Qt::CaseInsensitive)) {
 						text = text.mid(filter.length() + 1);
 						item->setData(text + ", " + filter, Miam::DF_CustomDisplayText);
-						item->setData(db.normalizeField(text), Miam::DF_NormalizedString);
+						item->setData(SqlDatabase::normalizeField(text), Miam::DF_NormalizedString);
 						break;
 					}
 				}
@@ -379,6 +572,10 @@ void LibraryItemModel::rebuildSeparators()
 void LibraryItemModel::reset()
 {
 	this->deleteCache();
+	_artists.clear();
+	_albums.clear();
+	_years.clear();
+
 	switch (SettingsPrivate::instance()->insertPolicy()) {
 	case SettingsPrivate::IP_Artists:
 		horizontalHeaderItem(0)->setText(tr("  Artists / Albums"));
@@ -2,6 +2,7 @@
 #define LIBRARYITEMMODEL_H
 
 #include <QSet>
+#include <QSqlRecord>
 #include <model/genericdao.h>
 #include <filehelper.h>
 #include "miamitemmodel.h"
@@ -10,8 +11,15 @@
 
 #include "libraryfilterproxymodel.h"
 
+/// Forward declarations
+class AlbumItem;
+class ArtistItem;
+class YearItem;
+
 /**
  * \brief		The LibraryItemModel class is used to cache information from the database, in order to increase performance.
+ * \details		Only top level items are read when the library is loaded. Children of an item are read from the database when
+ *				this item is expanded for the first time, or when its tracks are needed, using indexes on artists and albums.
  * \author      Matthieu Bachelier
  * \copyright   GNU General Public License v3
  */
@@ -21,13 +29,30 @@ class MIAMLIBRARY_LIBRARY LibraryItemModel : public MiamItemModel
 private:
 	LibraryFilterProxyModel *_proxy;
 
+	/** Parent nodes by their id in the database, to find where a track has to be inserted. */
+	QHash<uint, ArtistItem*> _artists;
+	QHash<uint, AlbumItem*> _albums;
+	QHash<QString, YearItem*> _years;
+
+	/** Articles like "The" which can be moved after artists' name. */
+	QStringList _articles;
+
 public:
 	explicit LibraryItemModel(QObject *parent = nullptr);
 
 	virtual ~LibraryItemModel();
 
+	/** Redefined: items which were not expanded yet have their children in the database. */
+	virtual bool canFetchMore(const QModelIndex &parent) const override;
+
 	virtual QChar currentLetter(const QModelIndex &index) const override;
 
+	/** Redefined to read children of an artist, an album or a year from the database. */
+	virtual void fetchMore(const QModelIndex &parent) override;
+
+	/** Redefined to display an expand button next to items whose children were not read yet. */
+	virtual bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+
 	virtual LibraryFilterProxyModel* proxy() const override;
 
 	/** Rebuild the list of separators when one has changed grammatical articles in options. */
@@ -37,8 +62,34 @@ public:
 
 	inline QMultiHash<SeparatorItem*, QModelIndex> topLevelItems() const { return _topLevelItems; }
 
+private:
+	/** Appends new top level items, and attaches them to their separators. */
+	void appendTopLevel(const QList<QStandardItem*> &items);
+
+	/** Keeps an item to find where tracks have to be inserted later. */
+	QStandardItem* cacheItem(QStandardItem *item);
+
+	/** Creates an item from a node, and keeps it to find where tracks have to be inserted later. */
+	QStandardItem* cacheItem(const ItemNode &node);
+
+	/** Inserts a track which was added or modified, or only its parent if this one has not been read yet. */
+	void insertUpdatedTrack(const QSqlRecord &record);
+
+	/** Replaces every item by top level items built in background. */
+	virtual void insertItemRows(const QList<QList<QStandardItem*>> &rows) override;
+
+	/** Removes an item, then its parents if they have no more children. */
+	void removeItem(QStandardItem *item);
+
+	/** Removes artists, albums and years which were not expanded, and which have no more tracks in the database. */
+	void removeOrphans();
+
 public slots:
+	/** Reads top level items in background, their children are read from the database when they're expanded. */
 	virtual void load(const QString & = QString::null) override;
+
+	/** Inserts tracks which were added or modified in the library, and removes deleted ones, without reloading everything. */
+	void updateTracks(const QStringList &updatedTracks, const QStringList &removedTracks);
 };
 
 #endif // LIBRARYITEMMODEL_H
@@ -1,10 +1,9 @@
 #include "librarytreeview.h"
 
 #include <library/jumptowidget.h>
-#include <cover.h>
-#include <filehelper.h>
 #include <settings.h>
-#include <settingsprivate.h>
+#include <settingssnapshot.h>
+#include <thumbnailstore.h>
 
 #include <coverfetcher.h>
 
@@ -13,10 +12,16 @@
 #include "libraryscrollbar.h"
 
 #include <functional>
-#include <memory>
 
 #include <QtDebug>
 
+namespace {
+
+/** Covers below tracks are scaled to the view, a thumbnail of this size is sharp enough for most screens. */
+const int expandedCoverSize = 512;
+
+}
+
 LibraryTreeView::LibraryTreeView(QWidget *parent)
 	: TreeView(parent)
 	, _libraryModel(new LibraryItemModel(this))
@@ -63,10 +68,13 @@ LibraryTreeView::LibraryTreeView(QWidget *parent)
 	connect(this, &QTreeView::expanded, this, &LibraryTreeView::setExpandedCover);
 	connect(this, &QTreeView::collapsed, this, &LibraryTreeView::removeExpandedCover);
 
-	connect(vScrollBar, &LibraryScrollBar::aboutToDisplayItemDelegate, _delegate, &LibraryItemDelegate::displayIcon);
 	connect(vScrollBar, &QAbstractSlider::valueChanged, this, [=](int) {
 		QModelIndex iTop = indexAt(viewport()->rect().topLeft());
 		_jumpToWidget->setCurrentLetter(_libraryModel->currentLetter(iTop));
+
+		// Covers are decoded in background: prepare those which are about to be displayed
+		QModelIndex iBottom = indexAt(viewport()->rect().bottomLeft());
+		_delegate->prefetchCovers(iTop, iBottom, 20);
 	});
 	connect(_jumpToWidget, &JumpToWidget::aboutToScrollTo, this, &LibraryTreeView::scrollToLetter);
 
@@ -114,6 +122,10 @@ const QImage *LibraryTreeView::expandedCover(AlbumItem *album) const
 /** Reimplemented. */
 void LibraryTreeView::findAll(const QModelIndex &index, QList<QUrl> *tracks) const
 {
+	// Tracks of an album which was never expanded are still in the database
+	if (_proxyModel->canFetchMore(index)) {
+		_proxyModel->fetchMore(index);
+	}
 	QStandardItem *item = _libraryModel->itemFromIndex(_proxyModel->mapToSource(index));
 	if (item && item->hasChildren()) {
 		for (int i = 0; i < item->rowCount(); i++) {
@@ -151,25 +163,19 @@ void LibraryTreeView::setExpandedCover(const QModelIndex &index)
 {
 	QStandardItem *item = _libraryModel->itemFromIndex(_proxyModel->mapToSource(index));
 	if (item->type() == Miam::IT_Album && Settings::instance()->isCoverBelowTracksEnabled()) {
-		QImage *image = nullptr;
 		AlbumItem *albumItem = static_cast<AlbumItem*>(item);
-		if (albumItem->data(Miam::DF_InternalCover).toString().isEmpty()) {
-
-			QString coverPath = albumItem->data(Miam::DF_CoverPath).toString();
-			if (!coverPath.isEmpty()) {
-				image = new QImage(coverPath);
-			}
-		} else {
-			FileHelper fh(albumItem->data(Miam::DF_InternalCover).toString());
-			std::unique_ptr<Cover> cover(fh.extractCover());
-			if (cover) {
-				image = new QImage();
-				image->loadFromData(cover->byteArray(), cover->format());
-			}
+		QString coverPath = albumItem->data(Miam::DF_InternalCover).toString();
+		if (coverPath.isEmpty()) {
+			coverPath = albumItem->data(Miam::DF_CoverPath).toString();
+		}
+		if (coverPath.isEmpty()) {
+			return;
 		}
 
-		if (image) {
-			_expandedCovers.insert(albumItem, image);
+		// Cover is drawn below tracks, its size is bounded by the width of the view
+		QImage thumbnail = ThumbnailStore::thumbnail(coverPath, expandedCoverSize);
+		if (!thumbnail.isNull()) {
+			_expandedCovers.insert(albumItem, new QImage(thumbnail));
 		}
 	}
 }
@@ -237,30 +243,9 @@ void LibraryTreeView::keyboardSearch(const QString &search)
 	}
 }
 
-void LibraryTreeView::keyPressEvent(QKeyEvent *event)
-{
-	if (event->key() == Qt::Key_PageDown || event->key() == Qt::Key_PageUp) {
-		SettingsPrivate::InsertPolicy ip = SettingsPrivate::instance()->insertPolicy();
-		if (ip == SettingsPrivate::IP_Albums || ip == SettingsPrivate::IP_ArtistsAlbums) {
-			_delegate->displayIcon(false);
-		}
-	}
-	TreeView::keyPressEvent(event);
-}
-
-void LibraryTreeView::keyReleaseEvent(QKeyEvent *event)
-{
-	if (event->key() == Qt::Key_PageDown || event->key() == Qt::Key_PageUp) {
-		SettingsPrivate::InsertPolicy ip = SettingsPrivate::instance()->insertPolicy();
-		if (ip == SettingsPrivate::IP_Albums || ip == SettingsPrivate::IP_ArtistsAlbums) {
-			_delegate->displayIcon(true);
-		}
-	}
-	TreeView::keyReleaseEvent(event);
-}
-
 void LibraryTreeView::paintEvent(QPaintEvent *event)
 {
+	SettingsSnapshot::FrameCounter frameCounter(Q_FUNC_INFO);
 	int wVerticalScrollBar = 0;
 	if (verticalScrollBar()->isVisible()) {
 		wVerticalScrollBar = verticalScrollBar()->width();
@@ -283,6 +268,9 @@ void LibraryTreeView::paintEvent(QPaintEvent *event)
 /** Recursive count for leaves only. */
 int LibraryTreeView::count(const QModelIndex &index) const
 {
+	if (_proxyModel->canFetchMore(index)) {
+		_proxyModel->fetchMore(index);
+	}
 	QStandardItem *item = _libraryModel->itemFromIndex(_proxyModel->mapToSource(index));
 	if (item) {
 		int tmp = 0;
@@ -325,17 +313,12 @@ void LibraryTreeView::changeSortOrder()
 	}
 }*/
 
-/** Reimplemented. */
+/** Reimplemented: items were replaced by the model, covers of expanded albums belong to deleted ones. */
 void LibraryTreeView::reset()
 {
-	if (sender() == nullptr) {
-		return;
-	}
-	if (_libraryModel->rowCount() > 0) {
-		_proxyModel->setFilterRegExp(QString());
-		this->verticalScrollBar()->setValue(0);
-	}
-	_libraryModel->reset();
+	TreeView::reset();
+	qDeleteAll(_expandedCovers);
+	_expandedCovers.clear();
 }
 
 void LibraryTreeView::endPopulateTree()
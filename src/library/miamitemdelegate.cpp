@@ -1,7 +1,5 @@
 #include "miamitemdelegate.h"
 
-#include <settings.h>
-#include <settingsprivate.h>
 #include <QGuiApplication>
 #include <QPainter>
 
@@ -77,7 +75,6 @@ void MiamItemDelegate::paintText(QPainter *p, const QStyleOptionViewItem &opt, c
 	p->save();
 	if (text.isEmpty()) {
 		p->setPen(opt.palette.mid().color());
-		QFontMetrics fmf(SettingsPrivate::instance()->font(SettingsPrivate::FF_Library));
 		p->drawText(rectText, Qt::AlignVCenter, p->fontMetrics().elidedText(tr("(empty)"), Qt::ElideRight, rectText.width()));
 	} else {
 		if (opt.state.testFlag(QStyle::State_Selected) || opt.state.testFlag(QStyle::State_MouseOver)) {
@@ -1,12 +1,18 @@
 #include "miamitemmodel.h"
 #include "albumitem.h"
+#include "artistitem.h"
+#include "discitem.h"
+#include "yearitem.h"
 
 #include <settingsprivate.h>
 
+#include <QThreadPool>
+
 #include <QtDebug>
 
 MiamItemModel::MiamItemModel(QObject *parent)
 	: QStandardItemModel(parent)
+	, _loadGeneration(new QAtomicInt(0))
 {}
 
 MiamItemModel::~MiamItemModel()
@@ -14,15 +20,49 @@ MiamItemModel::~MiamItemModel()
 	this->deleteCache();
 }
 
+/** Creates an item from a node, and its values. It can be called from worker threads. */
+QStandardItem* MiamItemModel::createItem(const ItemNode &node)
+{
+	QStandardItem *item = nullptr;
+	switch (node.type) {
+	case Miam::IT_Artist:
+		item = new ArtistItem;
+		break;
+	case Miam::IT_Album:
+		item = new AlbumItem;
+		break;
+	case Miam::IT_Disc:
+		item = new DiscItem;
+		break;
+	case Miam::IT_Track:
+		item = new TrackItem;
+		break;
+	case Miam::IT_Year:
+		// Text is set by the item itself for unknown years
+		item = new YearItem(node.text);
+		break;
+	default:
+		item = new QStandardItem;
+		break;
+	}
+	if (node.type != Miam::IT_Year) {
+		item->setText(node.text);
+	}
+	for (const QPair<int, QVariant> &value : node.values) {
+		item->setData(value.second, value.first);
+	}
+	return item;
+}
+
 void MiamItemModel::deleteCache()
 {
 	qDeleteAll(_hash);
 	qDeleteAll(_letters);
-	qDeleteAll(_tracks);
 
 	_hash.clear();
 	_letters.clear();
 	_topLevelItems.clear();
+	// Tracks are only references, they are deleted with rows
 	_tracks.clear();
 
 	this->removeRows(0, this->rowCount());
@@ -82,3 +122,32 @@ SeparatorItem *MiamItemModel::insertSeparator(const QStandardItem *node)
 	}
 	return nullptr;
 }
+
+/** Builds rows in a thread of the global pool: current items are displayed until new ones are ready. */
+void MiamItemModel::readItemRows(const std::function<void(QList<QList<QStandardItem*>> &rows)> &read)
+{
+	int generation = _loadGeneration->fetchAndAddOrdered(1) + 1;
+	ModelReaderTask *task = new ModelReaderTask(read, generation, _loadGeneration);
+	connect(task, &ModelReaderTask::rowsRead, this, &MiamItemModel::swapItemRows, Qt::QueuedConnection);
+	QThreadPool::globalInstance()->start(task);
+}
+
+void MiamItemModel::swapItemRows(int generation, const ItemRows &rows)
+{
+	// Model was loaded again while these rows were built: they're deleted with the last reference
+	if (generation != _loadGeneration->load()) {
+		return;
+	}
+
+	// Items now belong to this model
+	QList<QList<QStandardItem*>> items;
+	items.swap(*rows);
+
+	// Views and proxies are notified once, instead of once per removed or inserted row
+	this->beginResetModel();
+	bool wasBlocked = this->blockSignals(true);
+	this->insertItemRows(items);
+	this->blockSignals(wasBlocked);
+	this->endResetModel();
+	emit loaded();
+}
@@ -3,6 +3,7 @@
 
 #include <QStandardItemModel>
 #include <QSortFilterProxyModel>
+#include "modelreadertask.h"
 #include "separatoritem.h"
 #include "trackitem.h"
 
@@ -27,8 +28,12 @@ protected:
 	/** Letter L returns all Artists (e.g.) starting with L. */
 	QMultiHash<SeparatorItem*, QModelIndex> _topLevelItems;
 
+	/** Tracks by URI, to update the model when files are modified. */
 	QHash<QString, TrackItem*> _tracks;
 
+	/** Incremented for each load, results of previous loads are discarded. Shared with running tasks. */
+	QSharedPointer<QAtomicInt> _loadGeneration;
+
 public:
 	explicit MiamItemModel(QObject *parent = nullptr);
 
@@ -42,10 +47,26 @@ public:
 
 	virtual QSortFilterProxyModel* proxy() const = 0;
 
+	/** Creates an item from a node, and its values. It can be called from worker threads. */
+	static QStandardItem* createItem(const ItemNode &node);
+
 protected:
 	void deleteCache();
 
 	SeparatorItem *insertSeparator(const QStandardItem *node);
+
+	/** Replaces every item by rows built in background, it's called while the model is reset. */
+	virtual void insertItemRows(const QList<QList<QStandardItem*>> &rows) = 0;
+
+	/** Builds rows in a thread of the global pool: current items are displayed until new ones are ready. */
+	void readItemRows(const std::function<void(QList<QList<QStandardItem*>> &rows)> &read);
+
+private slots:
+	void swapItemRows(int generation, const ItemRows &rows);
+
+signals:
+	/** Sent when items read in background have replaced previous ones. */
+	void loaded();
 };
 
 #endif // MIAMITEMMODEL_H
@@ -0,0 +1,38 @@
+#include "modelreadertask.h"
+
+namespace {
+
+/** Items which were not taken by a model are deleted with their rows. */
+void deleteRows(QList<QList<QStandardItem*>> *rows)
+{
+	for (const QList<QStandardItem*> &row : *rows) {
+		qDeleteAll(row);
+	}
+	delete rows;
+}
+
+}
+
+ModelReaderTask::ModelReaderTask(const std::function<void(QList<QList<QStandardItem*>> &rows)> &read, int generation,
+								 const QSharedPointer<QAtomicInt> &currentGeneration)
+	: QObject(nullptr)
+	, _read(read)
+	, _generation(generation)
+	, _currentGeneration(currentGeneration)
+{
+	qRegisterMetaType<ItemRows>();
+	setAutoDelete(false);
+}
+
+void ModelReaderTask::run()
+{
+	// Model was loaded again before this task has started
+	if (_currentGeneration->load() == _generation) {
+		ItemRows rows(new QList<QList<QStandardItem*>>, &deleteRows);
+		_read(*rows);
+		if (_currentGeneration->load() == _generation) {
+			emit rowsRead(_generation, rows);
+		}
+	}
+	this->deleteLater();
+}
@@ -0,0 +1,76 @@
+#ifndef MODELREADERTASK_H
+#define MODELREADERTASK_H
+
+#include <QAtomicInt>
+#include <QObject>
+#include <QPair>
+#include <QRunnable>
+#include <QSharedPointer>
+#include <QStandardItem>
+#include <QVariant>
+#include <QVector>
+
+#include <functional>
+
+/**
+ * \brief		The ItemNode struct holds values of an item which was read from the database in a worker thread.
+ * \details		Nodes are plain values, which are converted to items in the same worker thread.
+ * \author      Matthieu Bachelier
+ * \copyright   GNU General Public License v3
+ */
+struct ItemNode
+{
+	/** One of Miam::ItemType. */
+	int type;
+
+	QString text;
+
+	/** Values by role, like Miam::DF_NormalizedString. */
+	QVector<QPair<int, QVariant>> values;
+
+	explicit ItemNode(int t = 0) : type(t) {}
+
+	inline QVariant data(int role) const {
+		for (const QPair<int, QVariant> &value : values) {
+			if (value.first == role) {
+				return value.second;
+			}
+		}
+		return QVariant();
+	}
+
+	inline void setData(const QVariant &value, int role) { values.append(qMakePair(role, value)); }
+};
+
+/** Rows of items built in a worker thread, which don't belong to a model yet. Items are deleted with the last reference,
+ * unless a model has taken them. */
+typedef QSharedPointer<QList<QList<QStandardItem*>>> ItemRows;
+
+Q_DECLARE_METATYPE(ItemRows)
+
+/**
+ * \brief		The ModelReaderTask class reads items of a model in a thread of the global pool.
+ * \details		Items are created and filled by the task: the model only has to insert them. They're sent all at once, and
+ *				only if no other task was started by the model in the meantime.
+ * \author      Matthieu Bachelier
+ * \copyright   GNU General Public License v3
+ */
+class ModelReaderTask : public QObject, public QRunnable
+{
+	Q_OBJECT
+private:
+	std::function<void(QList<QList<QStandardItem*>> &rows)> _read;
+	int _generation;
+	QSharedPointer<QAtomicInt> _currentGeneration;
+
+public:
+	ModelReaderTask(const std::function<void(QList<QList<QStandardItem*>> &rows)> &read, int generation,
+					const QSharedPointer<QAtomicInt> &currentGeneration);
+
+	virtual void run() override;
+
+signals:
+	void rowsRead(int generation, const ItemRows &rows);
+};
+
+#endif // MODELREADERTASK_H
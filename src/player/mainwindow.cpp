@@ -26,6 +26,7 @@ MainWindow::MainWindow(QWidget *parent)
 	, _pluginManager(new PluginManager(this))
 	, _remoteControl(nullptr)
 	, _currentView(nullptr)
+	, _fileSystemWatcher(nullptr)
 	, _tagEditor(nullptr)
 	, _mini(nullptr)
 	, _shortcutSkipBackward(new QxtGlobalShortcut(QKeySequence(Qt::Key_MediaPrevious), this))
@@ -88,6 +89,7 @@ void MainWindow::activateLastView()
 			// If no action was triggered, despite an entry in settings, it means some plugin was activated once, but now we couldn't find it
 			actionViewPlaylists->trigger();
 		}
+		this->monitorFileSystem(settingsPrivate->isFileSystemMonitored());
 	}
 }
 
@@ -194,8 +196,9 @@ void MainWindow::setupActions()
 	connect(actionShowOptions, &QAction::triggered, this, &MainWindow::createCustomizeOptionsDialog);
 	connect(actionAboutQt, &QAction::triggered, &QApplication::aboutQt);
 	connect(actionHideMenuBar, &QAction::triggered, this, &MainWindow::toggleMenuBar);
+	// Rescanning on demand rebuilds the library: tags are read again, even if files look unchanged
 	connect(actionScanLibrary, &QAction::triggered, this, [=]() {
-		this->syncLibrary(QStringList(), settingsPrivate->musicLocations());
+		this->scanLibrary(settingsPrivate->musicLocations(), MusicSearchEngine::SM_Full);
 	});
 	connect(actionShowHelp, &QAction::triggered, this, [=]() {
         QDesktopServices::openUrl(QUrl("https://github.com/MBach/Miam-Player/wiki"));
@@ -212,20 +215,7 @@ void MainWindow::setupActions()
 
 	connect(actionMute, &QAction::triggered, _mediaPlayer, &MediaPlayer::toggleMute);
 
-	connect(settingsPrivate, &SettingsPrivate::monitorFileSystemChanged, this, [=](bool b) {
-		if (b) {
-			MusicSearchEngine *worker = new MusicSearchEngine;
-			QThread *thread = new QThread;
-			worker->moveToThread(thread);
-			connect(thread, &QThread::started, worker, &MusicSearchEngine::watchForChanges);
-			connect(thread, &QThread::finished, thread, &QThread::deleteLater);
-			thread->start();
-
-			if (_currentView && _currentView->viewProperty(Settings::VP_HasAreaForRescan)) {
-				_currentView->setMusicSearchEngine(worker);
-			}
-        }
-	});
+	connect(settingsPrivate, &SettingsPrivate::monitorFileSystemChanged, this, &MainWindow::monitorFileSystem);
 
 	connect(settingsPrivate, &SettingsPrivate::fontHasChanged, this, [=](SettingsPrivate::FontFamily ff) {
 		if (ff == SettingsPrivate::FF_Menu) {
@@ -508,6 +498,11 @@ void MainWindow::activateView(QAction *menuAction)
 	}
 	_currentView->installEventFilter(this);
 
+	// Views are updated when files are changed in music locations
+	if (_fileSystemWatcher && _currentView->viewProperty(Settings::VP_HasAreaForRescan)) {
+		_currentView->setMusicSearchEngine(_fileSystemWatcher);
+	}
+
 	if (_currentView->viewProperty(Settings::VP_CanSendTracksToEditor)) {
 		connect(_currentView, &AbstractView::aboutToSendToTagEditor, this, [=](const QList<QUrl> &tracks) {
 			actionViewTagEditor->trigger();
@@ -740,33 +735,49 @@ void MainWindow::switchToMiniPlayer()
 	}
 }
 
-void MainWindow::syncLibrary(const QStringList &oldLocations, const QStringList &newLocations)
+/** Starts or stops watching music locations. */
+void MainWindow::monitorFileSystem(bool b)
+{
+	if (b && !_fileSystemWatcher) {
+		QThread *thread = new QThread;
+		_fileSystemWatcher = new MusicSearchEngine;
+		_fileSystemWatcher->moveToThread(thread);
+		connect(thread, &QThread::started, _fileSystemWatcher, &MusicSearchEngine::watchForChanges);
+		connect(_fileSystemWatcher, &QObject::destroyed, thread, &QThread::quit);
+		connect(thread, &QThread::finished, thread, &QThread::deleteLater);
+
+		// After an overflow of events, library was scanned again
+		connect(_fileSystemWatcher, &MusicSearchEngine::searchHasEnded, this, [=]() {
+			if (_currentView) {
+				_currentView->loadModel();
+			}
+		});
+		thread->start();
+
+		if (_currentView && _currentView->viewProperty(Settings::VP_HasAreaForRescan)) {
+			_currentView->setMusicSearchEngine(_fileSystemWatcher);
+		}
+	} else if (!b && _fileSystemWatcher) {
+		// Deleted in its own thread, which is stopped right after
+		_fileSystemWatcher->deleteLater();
+		_fileSystemWatcher = nullptr;
+	}
+}
+
+/** Starts a scan of locations in a new thread. */
+void MainWindow::scanLibrary(const QStringList &locations, MusicSearchEngine::ScanMode mode)
 {
 	if (!_currentView) {
 		this->activateLastView();
 	}
-	if (newLocations.isEmpty()) {
+	if (locations.isEmpty()) {
 		this->initQuickStart();
 		return;
 	}
 
-	bool same = true;
-	if (oldLocations.size() == newLocations.size()) {
-		for (int i = 0; i < newLocations.size(); i++) {
-			same = same && QString::compare(newLocations.at(i), oldLocations.at(i)) == 0;
-		}
-
-	} else {
-		same = false;
-	}
-
-	if (!same) {
-		SqlDatabase db;
-		db.reset();
-	}
-
 	QThread *thread = new QThread;
 	MusicSearchEngine *worker = new MusicSearchEngine;
+	worker->setScanMode(mode);
 	if (_currentView->viewProperty(Settings::VP_HasAreaForRescan)) {
 		_currentView->setMusicSearchEngine(worker);
 	}
@@ -795,6 +806,15 @@ void MainWindow::syncLibrary(const QStringList &oldLocations, const QStringList
 	thread->start();
 }
 
+void MainWindow::syncLibrary(const QStringList &oldLocations, const QStringList &newLocations)
+{
+	Q_UNUSED(oldLocations)
+
+	// No need to empty the library when locations have changed: an incremental scan removes tracks which are not found
+	// anymore, and only reads tags of new or modified files
+	this->scanLibrary(newLocations, MusicSearchEngine::SM_Incremental);
+}
+
 void MainWindow::toggleMenuBar(bool checked)
 {
 	auto settings = Settings::instance();
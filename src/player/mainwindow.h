@@ -10,6 +10,7 @@
 #include <abstractview.h>
 #include <mediaplayer.h>
 #include <minimodewidget.h>
+#include <musicsearchengine.h>
 #include <uniquelibrary.h>
 
 #include <tageditor.h>
@@ -33,6 +34,8 @@ private:
 	PluginManager *_pluginManager;
 	RemoteControl *_remoteControl;
 	AbstractView *_currentView;
+	/** Search engine living in its own thread which keeps the library up-to-date. */
+	MusicSearchEngine *_fileSystemWatcher;
 	TagEditor *_tagEditor;
 	MiniModeWidget *_mini;
 	QxtGlobalShortcut *_shortcutSkipBackward;
@@ -82,6 +85,9 @@ protected:
 private:
 	void initQuickStart();
 
+	/** Starts a scan of locations in a new thread. */
+	void scanLibrary(const QStringList &locations, MusicSearchEngine::ScanMode mode);
+
 public slots:
 	void createCustomizeOptionsDialog();
 
@@ -92,6 +98,9 @@ private slots:
 
 	void bindShortcut(const QString&, const QKeySequence &keySequence);
 
+	/** Starts or stops watching music locations. */
+	void monitorFileSystem(bool b);
+
 	void showTagEditor();
 
 	void switchToMiniPlayer();
@@ -62,7 +62,7 @@ MiniModeWidget::MiniModeWidget(MainWindow *mainWindow)
 	connect(closeButton, &QPushButton::clicked, &QApplication::quit);
 
 	connect(mediaPlayerControl->mediaPlayer(), &MediaPlayer::currentMediaChanged, this, [=](const QString &uri) {
-		SqlDatabase db;
+		SqlDatabase &db = *SqlDatabase::reader();
 		TrackDAO track = db.selectTrackByURI(uri);
 		currentTrack->setText(track.trackNumber().append(" - ").append(track.title()));
 	});
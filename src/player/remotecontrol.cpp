@@ -217,7 +217,7 @@ void RemoteControl::sendAllPlaylists() const
 	QStringList args;
 	args << QString::number(CMD_AllPlaylists);
 
-	for (PlaylistDAO p : SqlDatabase().selectPlaylists()) {
+	for (PlaylistDAO p : SqlDatabase::reader()->selectPlaylists()) {
 		args << p.title();
 	}
 	_webSocket->sendTextMessage(args.join(QChar::Null));
@@ -246,7 +246,7 @@ void RemoteControl::sendTrackInfos(const QString &track)
 	QStringList args;
 	args << QString::number(CMD_Track);
 
-	SqlDatabase db;
+	SqlDatabase &db = *SqlDatabase::reader();
 	TrackDAO dao = db.selectTrackByURI(track);
 	args << dao.uri();
 	args << dao.artistAlbum();
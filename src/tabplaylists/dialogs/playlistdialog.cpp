@@ -7,6 +7,7 @@
 #include <settingsprivate.h>
 #include "starrating.h"
 #include "styling/miamstyleditemdelegate.h"
+#include <playlistfile.h>
 
 #include <QDirIterator>
 #include <QFileDialog>
@@ -236,7 +237,7 @@ void PlaylistDialog::exportSelectedPlaylist()
 
 	QStandardItem *item = _savedPlaylistModel->itemFromIndex(indexes.first());
 	uint playlistId = item->data(PlaylistID).toUInt();
-	SqlDatabase db;
+	SqlDatabase &db = *SqlDatabase::reader();
 	PlaylistDAO dao = db.selectPlaylist(playlistId);
 	QString title = this->convertNameToValidFileName(dao.title());
 
@@ -252,13 +253,11 @@ void PlaylistDialog::exportSelectedPlaylist()
 		return;
 	} else {
 		QFile f(newName);
-		if (f.open(QIODevice::ReadWrite | QIODevice::Text)) {
-			QTextStream stream(&f);
-			stream.setGenerateByteOrderMark(true);
-			stream.setCodec("UTF-8");
-			for (QString track : db.selectPlaylistTracks(playlistId, false)) {
-				stream << QDir::toNativeSeparators(track);
-				endl(stream);
+		if (f.open(QIODevice::WriteOnly | QIODevice::Text)) {
+			// Tags from the library are written too, other players don't need to read them
+			PlaylistWriter writer(&f);
+			for (const TrackDAO &track : db.selectPlaylistTracksFromLibrary(playlistId)) {
+				writer.write(track);
 			}
 		}
 		f.close();
@@ -285,7 +284,7 @@ void PlaylistDialog::populatePreviewFromSaved(const QItemSelection &, const QIte
 	this->clearPreview(!empty);
 	if (indexes.size() == 1) {
 		uint playlistId = _savedPlaylistModel->itemFromIndex(indexes.first())->data(PlaylistID).toUInt();
-		QStringList tracks = SqlDatabase().selectPlaylistTracks(playlistId);
+		QStringList tracks = SqlDatabase::reader()->selectPlaylistTracks(playlistId);
 		for (int i = 0; i < tracks.size(); i++) {
 			QString track = tracks.at(i);
 			QTreeWidgetItem *item = new QTreeWidgetItem;
@@ -382,7 +381,7 @@ void PlaylistDialog::updatePlaylists()
 		}
 	}
 
-	for (PlaylistDAO playlist : SqlDatabase().selectPlaylists()) {
+	for (PlaylistDAO playlist : SqlDatabase::reader()->selectPlaylists()) {
 		QStandardItem *item = new QStandardItem(playlist.title());
 		item->setData(playlist.id(), PlaylistID);
 		if (playlist.icon().isEmpty()) {
@@ -203,7 +203,7 @@ void SearchDialog::artistWasDoubleClicked(const QModelIndex &artistIndex)
 	const QStandardItemModel *m = qobject_cast<const QStandardItemModel*>(artistIndex.model());
 	QStandardItem *item = m->itemFromIndex(artistIndex);
 
-	SqlDatabase db;
+	SqlDatabase &db = *SqlDatabase::reader();
 
 	QSqlQuery q(db);
 	q.prepare("SELECT uri FROM cache WHERE artist = ?");
@@ -225,7 +225,7 @@ void SearchDialog::albumWasDoubleClicked(const QModelIndex &albumIndex)
 	const QStandardItemModel *m = qobject_cast<const QStandardItemModel*>(albumIndex.model());
 	QStandardItem *item = m->itemFromIndex(albumIndex);
 
-	SqlDatabase db;
+	SqlDatabase &db = *SqlDatabase::reader();
 
 	QSqlQuery q(db);
 	q.prepare("SELECT uri FROM cache WHERE album = ?");
@@ -256,12 +256,19 @@ void SearchDialog::localSearch(const QString &text)
 		return;
 	}
 
-	SqlDatabase db;
+	QString match = SqlDatabase::matchExpression(text);
+	if (match.isEmpty()) {
+		return;
+	}
+
+	SqlDatabase &db = *SqlDatabase::reader();
 
+	// Words are searched in the full-text index, shortest results are the closest ones
 	/// XXX: Factorize this, 3 times the (almost) same code
 	QSqlQuery qSearchForArtists(db);
-	qSearchForArtists.prepare("SELECT DISTINCT artist FROM cache WHERE artist LIKE :t LIMIT 5");
-	qSearchForArtists.bindValue(":t", "%" + text + "%");
+	qSearchForArtists.prepare("SELECT DISTINCT artist FROM cache WHERE rowid IN (SELECT docid FROM cacheSearch WHERE artist MATCH :t) " \
+							  "ORDER BY length(artist) LIMIT 5");
+	qSearchForArtists.bindValue(":t", match);
 	if (qSearchForArtists.exec()) {
 		QList<QStandardItem*> artistList;
 		while (qSearchForArtists.next()) {
@@ -275,8 +282,9 @@ void SearchDialog::localSearch(const QString &text)
 	}
 
 	QSqlQuery qSearchForAlbums(db);
-	qSearchForAlbums.prepare("SELECT DISTINCT album, artist FROM cache WHERE album LIKE :t LIMIT 5");
-	qSearchForAlbums.bindValue(":t", "%" + text + "%");
+	qSearchForAlbums.prepare("SELECT DISTINCT album, artist FROM cache WHERE rowid IN (SELECT docid FROM cacheSearch WHERE album MATCH :t) " \
+							 "ORDER BY length(album) LIMIT 5");
+	qSearchForAlbums.bindValue(":t", match);
 	if (qSearchForAlbums.exec()) {
 		QList<QStandardItem*> albumList;
 		while (qSearchForAlbums.next()) {
@@ -289,8 +297,9 @@ void SearchDialog::localSearch(const QString &text)
 	}
 
 	QSqlQuery qSearchForTracks(db);
-	qSearchForTracks.prepare("SELECT DISTINCT trackTitle, COALESCE(artistAlbum, artist), uri FROM cache WHERE trackTitle LIKE :t LIMIT 5");
-	qSearchForTracks.bindValue(":t", "%" + text + "%");
+	qSearchForTracks.prepare("SELECT DISTINCT trackTitle, COALESCE(artistAlbum, artist), uri FROM cache " \
+							 "WHERE rowid IN (SELECT docid FROM cacheSearch WHERE trackTitle MATCH :t) ORDER BY length(trackTitle) LIMIT 5");
+	qSearchForTracks.bindValue(":t", match);
 	if (qSearchForTracks.exec()) {
 		QList<QStandardItem*> trackList;
 		while (qSearchForTracks.next()) {
@@ -0,0 +1,68 @@
+#include "folderinsertiontask.h"
+
+#include <filehelper.h>
+#include "playlistmodel.h"
+
+#include <QDirIterator>
+#include <QElapsedTimer>
+
+namespace {
+
+/** Chunks are sent when they're full or when they're old enough, the first track is then displayed quickly. */
+const int tracksPerChunk = 500;
+const int msPerChunk = 200;
+
+}
+
+FolderInsertionTask::FolderInsertionTask(const QList<QDir> &folders)
+	: QObject(nullptr)
+	, _folders(folders)
+	, _isCancelled(0)
+{
+	qRegisterMetaType<QList<TrackDAO>>();
+	setAutoDelete(false);
+}
+
+/** Can be called from any thread. */
+void FolderInsertionTask::cancel()
+{
+	_isCancelled.store(1);
+}
+
+void FolderInsertionTask::run()
+{
+	emit progressChanged(0, 0);
+
+	QStringList absFilePaths;
+	for (QDir folder : _folders) {
+		QDirIterator it(folder.absolutePath(), FileHelper::suffixes(FileHelper::ET_Standard, true), QDir::Files | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+		while (it.hasNext() && _isCancelled.load() == 0) {
+			it.next();
+			if (it.fileInfo().isFile()) {
+				absFilePaths << it.fileInfo().absoluteFilePath();
+			}
+		}
+	}
+	absFilePaths.sort(Qt::CaseInsensitive);
+
+	QList<TrackDAO> tracks;
+	QElapsedTimer timer;
+	timer.start();
+	for (int i = 0; i < absFilePaths.size() && _isCancelled.load() == 0; i++) {
+		FileHelper fh(absFilePaths.at(i));
+		if (fh.isValid()) {
+			tracks << PlaylistModel::readTrack(fh);
+		}
+		if (tracks.size() >= tracksPerChunk || (!tracks.isEmpty() && timer.elapsed() >= msPerChunk)) {
+			emit tracksRead(tracks);
+			emit progressChanged(i + 1, absFilePaths.size());
+			tracks.clear();
+			timer.restart();
+		}
+	}
+	if (!tracks.isEmpty()) {
+		emit tracksRead(tracks);
+	}
+	emit finished();
+	this->deleteLater();
+}
@@ -0,0 +1,45 @@
+#ifndef FOLDERINSERTIONTASK_H
+#define FOLDERINSERTIONTASK_H
+
+#include <QAtomicInt>
+#include <QDir>
+#include <QObject>
+#include <QRunnable>
+
+#include <model/trackdao.h>
+
+/**
+ * \brief		The FolderInsertionTask class reads tracks of folders dropped in a playlist.
+ * \details		Folders are walked and tags are read in a thread of the global pool. Tracks are sorted by path then sent by
+ *				chunks, so that the playlist can display and play first tracks while other ones are read. The task can be
+ *				cancelled at any time: tracks which were already sent stay in the playlist.
+ * \author      Matthieu Bachelier
+ * \copyright   GNU General Public License v3
+ */
+class FolderInsertionTask : public QObject, public QRunnable
+{
+	Q_OBJECT
+private:
+	QList<QDir> _folders;
+
+	QAtomicInt _isCancelled;
+
+public:
+	explicit FolderInsertionTask(const QList<QDir> &folders);
+
+	/** Can be called from any thread. */
+	void cancel();
+
+	virtual void run() override;
+
+signals:
+	/** The number of tracks is 0 while folders are walked. */
+	void progressChanged(int tracksRead, int trackCount);
+
+	void tracksRead(const QList<TrackDAO> &tracks);
+
+	/** Sent when every track was read, or when the task was cancelled. */
+	void finished();
+};
+
+#endif // FOLDERINSERTIONTASK_H
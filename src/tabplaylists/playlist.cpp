@@ -2,12 +2,15 @@
 
 #include <QApplication>
 #include <QDropEvent>
+#include <QHBoxLayout>
 #include <QHeaderView>
+#include <QThreadPool>
+#include <QToolButton>
 
 #include <scrollbar.h>
 #include "playlistheaderview.h"
 #include "playlistitemdelegate.h"
-#include <settingsprivate.h>
+#include <settingssnapshot.h>
 
 #include <QMimeData>
 #include <QDrag>
@@ -23,6 +26,8 @@ Playlist::Playlist(MediaPlayer *mediaPlayer, QWidget *parent)
 	, _isDragging(false)
 	, _hash(0)
 	, _id(0)
+	, _insertionBar(new QWidget(this))
+	, _insertionProgress(new QProgressBar(_insertionBar))
 {
 	this->setModel(_playlistModel);
 
@@ -122,26 +127,44 @@ Playlist::Playlist(MediaPlayer *mediaPlayer, QWidget *parent)
 	connect(hScrollBar, &QScrollBar::sliderMoved, this, [=]() {	horizontalHeader()->viewport()->update(); });
 
 	this->hideColumn(COL_TRACK_DAO);
+
+	// Progress of folders which are read in background
+	QHBoxLayout *insertionLayout = new QHBoxLayout(_insertionBar);
+	insertionLayout->setContentsMargins(2, 2, 2, 2);
+	_insertionProgress->setFormat(tr("Adding tracks... %v / %m"));
+	QToolButton *cancelInsertion = new QToolButton(_insertionBar);
+	cancelInsertion->setText(tr("Cancel"));
+	cancelInsertion->setAutoRaise(true);
+	insertionLayout->addWidget(_insertionProgress);
+	insertionLayout->addWidget(cancelInsertion);
+	_insertionBar->setAutoFillBackground(true);
+	_insertionBar->hide();
+	connect(cancelInsertion, &QToolButton::clicked, this, [=]() {
+		_pendingFolders.clear();
+		if (_insertionTask) {
+			_insertionTask->cancel();
+		}
+	});
 }
 
 Playlist::~Playlist()
 {
+	if (_insertionTask) {
+		_insertionTask->cancel();
+	}
 	if (_mediaPlayer->playlist() == this->mediaPlaylist()) {
 		_mediaPlayer->setPlaylist(nullptr);
 	}
 	_mediaPlayer = nullptr;
 }
 
-uint Playlist::generateNewHash() const
+/** Checksum of tracks in their current order, kept up to date by the model. */
+quint64 Playlist::generateNewHash() const
 {
 	if (_playlistModel->mediaPlaylist()->mediaCount() == 0) {
 		return 0;
 	} else {
-		QString hash("");
-		for (int i = 0; i < _playlistModel->mediaPlaylist()->mediaCount(); i++) {
-			hash += _playlistModel->mediaPlaylist()->media(i).canonicalUrl().toString();
-		}
-		return qHash(hash);
+		return _playlistModel->checksum();
 	}
 }
 
@@ -186,6 +209,59 @@ void Playlist::insertMedias(int rowIndex, const QList<TrackDAO> &tracks)
 	this->autoResize();
 }
 
+/** Insert local tracks of a saved playlist, with tags from the library. */
+void Playlist::insertLocalTracks(int rowIndex, const QList<TrackDAO> &tracks, const QList<qint64> &positions)
+{
+	if (rowIndex == -1) {
+		rowIndex = _playlistModel->rowCount();
+	}
+	if (_playlistModel->insertLocalTracks(rowIndex, tracks, positions)) {
+		this->autoResize();
+	}
+}
+
+/** Appends tracks of folders while their tags are read in background. Folders dropped meanwhile are read next. */
+void Playlist::insertFolders(const QList<QDir> &folders)
+{
+	if (_insertionTask) {
+		_pendingFolders.append(folders);
+		return;
+	}
+
+	bool isEmpty = _playlistModel->rowCount() == 0;
+	FolderInsertionTask *task = new FolderInsertionTask(folders);
+	_insertionTask = task;
+	connect(task, &FolderInsertionTask::progressChanged, this, [=](int tracksRead, int trackCount) {
+		_insertionProgress->setRange(0, trackCount);
+		_insertionProgress->setValue(tracksRead);
+	}, Qt::QueuedConnection);
+	connect(task, &FolderInsertionTask::tracksRead, this, [=](const QList<TrackDAO> &tracks) mutable {
+		if (_playlistModel->insertReadTracks(_playlistModel->rowCount(), tracks)) {
+			// Columns are resized once, with the first chunk
+			if (isEmpty) {
+				isEmpty = false;
+				this->autoResize();
+				emit firstTracksInserted();
+			}
+			emit contentHasChanged();
+		}
+	}, Qt::QueuedConnection);
+	connect(task, &FolderInsertionTask::finished, this, [=]() {
+		_insertionTask = nullptr;
+		_insertionBar->hide();
+		if (!_pendingFolders.isEmpty()) {
+			QList<QDir> pendingFolders = _pendingFolders;
+			_pendingFolders.clear();
+			this->insertFolders(pendingFolders);
+		}
+	}, Qt::QueuedConnection);
+
+	_insertionProgress->setRange(0, 0);
+	this->updateInsertionBarGeometry();
+	_insertionBar->show();
+	QThreadPool::globalInstance()->start(task);
+}
+
 QSize Playlist::minimumSizeHint() const
 {
 	QFontMetrics fm(SettingsPrivate::instance()->font(SettingsPrivate::FF_Playlist));
@@ -202,8 +278,7 @@ QSize Playlist::minimumSizeHint() const
 void Playlist::contextMenuEvent(QContextMenuEvent *event)
 {
 	QModelIndex index = this->indexAt(event->pos());
-	QStandardItem *item = _playlistModel->itemFromIndex(index);
-	if (item != nullptr) {
+	if (index.isValid()) {
 		for (QAction *action : _trackProperties->actions()) {
 			action->setText(tr(action->text().toStdString().data()));
 		}
@@ -298,11 +373,11 @@ void Playlist::dropEvent(QDropEvent *event)
 			if (_mediaPlayer->state() == QMediaPlayer::PlayingState) {
 				c = _mediaPlayer->playlist()->currentIndex();
 			}
-			QList<QStandardItem*> rowsToHighlight = _playlistModel->internalMove(indexAt(event->pos()), selectionModel()->selectedRows());
+			QList<int> rowsToHighlight = _playlistModel->internalMove(indexAt(event->pos()), selectionModel()->selectedRows());
 			// Highlight rows that were just moved
-			for (QStandardItem *item : rowsToHighlight) {
+			for (int rowToHighlight : rowsToHighlight) {
 				for (int c = 0; c < _playlistModel->columnCount(); c++) {
-					QModelIndex index = _playlistModel->index(item->row(), c);
+					QModelIndex index = _playlistModel->index(rowToHighlight, c);
 					selectionModel()->select(index, QItemSelectionModel::Select);
 				}
 			}
@@ -405,6 +480,7 @@ void Playlist::mousePressEvent(QMouseEvent *event)
 /** Redefined to display a thin line to help user for dropping tracks. */
 void Playlist::paintEvent(QPaintEvent *event)
 {
+	SettingsSnapshot::FrameCounter frameCounter(Q_FUNC_INFO);
 	QPainter p(viewport());
 
 	if (_playlistModel && _playlistModel->rowCount() == 0) {
@@ -514,17 +590,24 @@ void Playlist::paintEvent(QPaintEvent *event)
 	}
 }
 
+void Playlist::resizeEvent(QResizeEvent *event)
+{
+	QTableView::resizeEvent(event);
+	this->updateInsertionBarGeometry();
+}
+
 int Playlist::sizeHintForColumn(int column) const
 {
 	if (column == COL_RATINGS) {
 		return rowHeight(COL_RATINGS) * 5;
-	} else if (QStandardItem *item = _playlistModel->item(0, column)) {
-		int w = fontMetrics().width(item->text());
+	} else if (_playlistModel->rowCount() > 0) {
+		QString text = _playlistModel->index(0, column).data().toString();
+		int w = fontMetrics().width(text);
 		if (w > 0) {
 			QFont f = font();
 			f.setBold(true);
 			f.setItalic(true);
-			double ratio = QFontMetrics(f).width(item->text()) / (double) w;
+			double ratio = QFontMetrics(f).width(text) / (double) w;
 			return QTableView::sizeHintForColumn(column) * qMax(1.10, ratio);
 		}
 	}
@@ -559,6 +642,13 @@ void Playlist::autoResize()
 	}
 }
 
+void Playlist::updateInsertionBarGeometry()
+{
+	QRect vp = viewport()->geometry();
+	int h = _insertionBar->sizeHint().height();
+	_insertionBar->setGeometry(vp.left(), vp.bottom() - h + 1, vp.width(), h);
+}
+
 /** Move selected tracks downward. */
 void Playlist::moveTracksDown()
 {
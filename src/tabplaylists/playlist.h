@@ -1,10 +1,14 @@
 #ifndef PLAYLIST_H
 #define PLAYLIST_H
 
+#include <QDir>
 #include <QMediaPlaylist>
 #include <QMenu>
+#include <QPointer>
+#include <QProgressBar>
 #include <QTableView>
 
+#include "folderinsertiontask.h"
 #include "playlistmodel.h"
 #include "model/trackdao.h"
 
@@ -39,10 +43,16 @@ private:
 	/** Drag & drop events: when moving tracks, displays a thin line under the cursor. */
 	bool _isDragging;
 
-	uint _hash;
+	quint64 _hash;
 
 	uint _id;
 
+	/** Folders dropped in this playlist are read in background, a small bar shows progress over the last rows. */
+	QPointer<FolderInsertionTask> _insertionTask;
+	QList<QDir> _pendingFolders;
+	QWidget *_insertionBar;
+	QProgressBar *_insertionProgress;
+
 	Q_ENUMS(Columns)
 
 public:
@@ -64,7 +74,8 @@ public:
 
 	inline MediaPlaylist *mediaPlaylist() const { return _playlistModel->mediaPlaylist(); }
 
-	uint generateNewHash() const;
+	/** Checksum of tracks in their current order, kept up to date by the model. */
+	quint64 generateNewHash() const;
 
 	inline uint id() const { return _id; }
 	bool isModified() const;
@@ -74,12 +85,18 @@ public:
 	/** Insert remote medias to playlist. */
 	void insertMedias(int rowIndex, const QList<TrackDAO> &tracks);
 
+	/** Insert local tracks of a saved playlist, with tags from the library. */
+	void insertLocalTracks(int rowIndex, const QList<TrackDAO> &tracks, const QList<qint64> &positions = QList<qint64>());
+
+	/** Appends tracks of folders while their tags are read in background. Folders dropped meanwhile are read next. */
+	void insertFolders(const QList<QDir> &folders);
+
 	virtual QSize minimumSizeHint() const override;
 
 	inline void forceDrop(QDropEvent *e) { this->dropEvent(e); }
 
-	inline uint hash() const { return _hash; }
-	inline void setHash(uint hash) { _hash = hash; }
+	inline quint64 hash() const { return _hash; }
+	inline void setHash(quint64 hash) { _hash = hash; }
 	inline void setId(uint id) { _id = id; }
 
 	inline PlaylistModel *model() const { return _playlistModel; }
@@ -108,6 +125,8 @@ protected:
 	/** Redefined to display a thin line to help user for dropping tracks. */
 	virtual void paintEvent(QPaintEvent *e) override;
 
+	virtual void resizeEvent(QResizeEvent *event) override;
+
 	virtual int sizeHintForColumn(int column) const override;
 
 	virtual void showEvent(QShowEvent *event) override;
@@ -117,6 +136,8 @@ protected:
 private:
 	void autoResize();
 
+	void updateInsertionBarGeometry();
+
 public slots:
 	/** Move selected tracks downward. */
 	void moveTracksDown();
@@ -132,6 +153,9 @@ signals:
 
 	void contentHasChanged();
 
+	/** Sent when first tracks of folders dropped in an empty playlist are ready, to play them without waiting for others. */
+	void firstTracksInserted();
+
 	void selectionHasChanged(bool isEmpty);
 };
 
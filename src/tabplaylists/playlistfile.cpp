@@ -0,0 +1,221 @@
+#include "playlistfile.h"
+
+#include <QtDebug>
+
+PlaylistReader::PlaylistReader(QIODevice *device, Format format, const QDir &baseDir)
+	: _device(device)
+	, _format(format)
+	, _baseDir(baseDir)
+	, _plsNumber(-1)
+{
+	if (_format == XSPF) {
+		_xml.setDevice(_device);
+	} else {
+		_text.setDevice(_device);
+		// Other files use the encoding of the system, unless they start with a byte order mark
+		if (_format == M3U8) {
+			_text.setCodec("UTF-8");
+		}
+	}
+}
+
+/** Guesses the format from the suffix of the file. */
+PlaylistReader::Format PlaylistReader::format(const QFileInfo &fileInfo)
+{
+	QString suffix = fileInfo.suffix().toLower();
+	if (suffix == "m3u") {
+		return M3U;
+	} else if (suffix == "m3u8") {
+		return M3U8;
+	} else if (suffix == "pls") {
+		return PLS;
+	} else {
+		return XSPF;
+	}
+}
+
+/** Reads the next track, returns false at the end of the device. */
+bool PlaylistReader::readNext(PlaylistEntry &entry)
+{
+	switch (_format) {
+	case M3U:
+	case M3U8:
+		return this->readM3U(entry);
+	case PLS:
+		return this->readPLS(entry);
+	case XSPF:
+		return this->readXSPF(entry);
+	}
+	return false;
+}
+
+bool PlaylistReader::readM3U(PlaylistEntry &entry)
+{
+	PlaylistEntry hints;
+	while (!_text.atEnd()) {
+		QString line = _text.readLine().trimmed();
+		if (line.isEmpty()) {
+			continue;
+		}
+		if (line.startsWith("#EXTINF:", Qt::CaseInsensitive)) {
+			// #EXTINF:duration [attributes],Artist - Title
+			int comma = line.indexOf(',');
+			QString duration = line.mid(8, comma < 0 ? -1 : comma - 8).section(' ', 0, 0);
+			bool ok = false;
+			int length = duration.toInt(&ok);
+			hints.length = (ok && length >= 0) ? length : -1;
+
+			QString display = comma < 0 ? QString() : line.mid(comma + 1).trimmed();
+			int separator = display.indexOf(" - ");
+			if (separator > 0) {
+				hints.artist = display.left(separator);
+				hints.title = display.mid(separator + 3);
+			} else {
+				hints.title = display;
+			}
+		} else if (!line.startsWith('#')) {
+			entry = hints;
+			entry.url = this->resolve(line);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool PlaylistReader::readPLS(PlaylistEntry &entry)
+{
+	while (!_text.atEnd()) {
+		// File1=..., Title1=..., Length1=...
+		QString line = _text.readLine().trimmed();
+		int equal = line.indexOf('=');
+		if (equal <= 0) {
+			continue;
+		}
+		QString key = line.left(equal).toLower();
+		int i = 0;
+		while (i < key.size() && key.at(i).isLetter()) {
+			i++;
+		}
+		bool ok = false;
+		int number = key.mid(i).toInt(&ok);
+		if (!ok) {
+			continue;
+		}
+
+		bool hasEntry = false;
+		if (number != _plsNumber) {
+			if (!_plsEntry.url.isEmpty()) {
+				entry = _plsEntry;
+				hasEntry = true;
+			}
+			_plsEntry = PlaylistEntry();
+			_plsNumber = number;
+		}
+
+		QString field = key.left(i);
+		QString value = line.mid(equal + 1).trimmed();
+		if (field == "file") {
+			_plsEntry.url = this->resolve(value);
+		} else if (field == "title") {
+			_plsEntry.title = value;
+		} else if (field == "length") {
+			int length = value.toInt(&ok);
+			_plsEntry.length = (ok && length >= 0) ? length : -1;
+		}
+		if (hasEntry) {
+			return true;
+		}
+	}
+
+	// Last entry
+	if (!_plsEntry.url.isEmpty()) {
+		entry = _plsEntry;
+		_plsEntry = PlaylistEntry();
+		return true;
+	}
+	return false;
+}
+
+bool PlaylistReader::readXSPF(PlaylistEntry &entry)
+{
+	bool isInTrack = false;
+	PlaylistEntry track;
+	while (!_xml.atEnd()) {
+		QXmlStreamReader::TokenType token = _xml.readNext();
+		if (token == QXmlStreamReader::StartElement) {
+			if (_xml.name() == "track") {
+				isInTrack = true;
+				track = PlaylistEntry();
+			} else if (isInTrack) {
+				if (_xml.name() == "location" && track.url.isEmpty()) {
+					track.url = this->resolve(_xml.readElementText().trimmed());
+				} else if (_xml.name() == "title") {
+					track.title = _xml.readElementText();
+				} else if (_xml.name() == "creator") {
+					track.artist = _xml.readElementText();
+				} else if (_xml.name() == "album") {
+					track.album = _xml.readElementText();
+				} else if (_xml.name() == "duration") {
+					// Milliseconds
+					bool ok = false;
+					int duration = _xml.readElementText().toInt(&ok);
+					track.length = (ok && duration >= 0) ? duration / 1000 : -1;
+				}
+			} else if (_xml.name() == "title" && _title.isEmpty()) {
+				_title = _xml.readElementText();
+			}
+		} else if (token == QXmlStreamReader::EndElement && _xml.name() == "track") {
+			isInTrack = false;
+			if (!track.url.isEmpty()) {
+				entry = track;
+				return true;
+			}
+		}
+	}
+	if (_xml.hasError()) {
+		qDebug() << Q_FUNC_INFO << _xml.errorString();
+	}
+	return false;
+}
+
+/** Urls are kept, paths are relative to the folder of the playlist. */
+QUrl PlaylistReader::resolve(const QString &location) const
+{
+	// A drive letter on Windows isn't a scheme, nor is "Artist: Title.mp3"
+	static const QStringList knownSchemes = { "file", "ftp", "http", "https", "mms", "rtmp", "rtsp" };
+	QUrl url(location);
+	if (location.contains("://") || knownSchemes.contains(url.scheme())) {
+		return url;
+	}
+	QString path = QDir::fromNativeSeparators(location);
+	if (_format == XSPF) {
+		// Locations are URIs, even when they're relative
+		path = QUrl::fromPercentEncoding(path.toUtf8());
+	}
+	return QUrl::fromLocalFile(QDir::cleanPath(_baseDir.absoluteFilePath(path)));
+}
+
+PlaylistWriter::PlaylistWriter(QIODevice *device)
+	: _stream(device)
+{
+	// No byte order mark: some players only recognize extended playlists when the first bytes are #EXTM3U
+	_stream.setCodec("UTF-8");
+	_stream << "#EXTM3U";
+	endl(_stream);
+}
+
+void PlaylistWriter::write(const TrackDAO &track)
+{
+	// Tracks which aren't in the library don't have tags
+	if (!track.title().isEmpty()) {
+		QString length = track.length().isEmpty() ? QString::number(-1) : track.length();
+		_stream << "#EXTINF:" << length << ",";
+		if (!track.artist().isEmpty()) {
+			_stream << track.artist() << " - ";
+		}
+		_stream << track.title();
+		endl(_stream);
+	}
+	_stream << QDir::toNativeSeparators(track.uri());
+	endl(_stream);
+}
@@ -0,0 +1,96 @@
+#ifndef PLAYLISTFILE_H
+#define PLAYLISTFILE_H
+
+#include <QDir>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QUrl>
+#include <QXmlStreamReader>
+
+#include <model/trackdao.h>
+#include "miamtabplaylists_global.hpp"
+
+/** A track read in a playlist file, with tags given by the file. They're only hints, tags of the library are preferred. */
+struct PlaylistEntry
+{
+	QUrl url;
+	QString title;
+	QString artist;
+	QString album;
+
+	/** In seconds, or -1 if unknown. */
+	int length;
+
+	PlaylistEntry() : length(-1) {}
+};
+
+/**
+ * \brief		The PlaylistReader class reads M3U, M3U8, PLS and XSPF playlists entry by entry.
+ * \details		Files are parsed while they're read from the device, so that large playlists are never loaded in memory
+ *				at once. Relative paths are resolved against the folder of the playlist. Durations and titles of extended
+ *				M3U (#EXTINF), PLS and XSPF are kept, so tracks which aren't in the library can be displayed without reading
+ *				their tags.
+ * \author      Matthieu Bachelier
+ * \copyright   GNU General Public License v3
+ */
+class MIAMTABPLAYLISTS_LIBRARY PlaylistReader
+{
+public:
+	enum Format { M3U, M3U8, PLS, XSPF };
+
+private:
+	QIODevice *_device;
+	Format _format;
+	QDir _baseDir;
+
+	QTextStream _text;
+	QXmlStreamReader _xml;
+
+	/** Title of the playlist itself, only XSPF files have one. */
+	QString _title;
+
+	/** PLS entries are spread over many lines, and only end when the next one starts. */
+	PlaylistEntry _plsEntry;
+	int _plsNumber;
+
+public:
+	PlaylistReader(QIODevice *device, Format format, const QDir &baseDir);
+
+	/** Guesses the format from the suffix of the file. */
+	static Format format(const QFileInfo &fileInfo);
+
+	/** Reads the next track, returns false at the end of the device. */
+	bool readNext(PlaylistEntry &entry);
+
+	/** Title of the playlist, empty if the file has none. Known once every entry was read. */
+	inline QString title() const { return _title; }
+
+private:
+	bool readM3U(PlaylistEntry &entry);
+
+	bool readPLS(PlaylistEntry &entry);
+
+	bool readXSPF(PlaylistEntry &entry);
+
+	/** Urls are kept, paths are relative to the folder of the playlist. */
+	QUrl resolve(const QString &location) const;
+};
+
+/**
+ * \brief		The PlaylistWriter class writes an extended M3U8 playlist, track by track.
+ * \details		Each track is preceded by its duration and its title, so that other players don't need to read tags.
+ * \author      Matthieu Bachelier
+ * \copyright   GNU General Public License v3
+ */
+class MIAMTABPLAYLISTS_LIBRARY PlaylistWriter
+{
+private:
+	QTextStream _stream;
+
+public:
+	explicit PlaylistWriter(QIODevice *device);
+
+	void write(const TrackDAO &track);
+};
+
+#endif // PLAYLISTFILE_H
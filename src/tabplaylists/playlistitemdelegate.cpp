@@ -2,7 +2,7 @@
 
 #include <model/sqldatabase.h>
 #include <filehelper.h>
-#include <settingsprivate.h>
+#include <settingssnapshot.h>
 #include "playlist.h"
 #include "stareditor.h"
 
@@ -96,7 +96,7 @@ void PlaylistItemDelegate::paint(QPainter *p, const QStyleOptionViewItem &opt, c
 	MiamStyledItemDelegate::paint(p, o, index);
 
 	// Highlight the current playing item
-	QFont font = SettingsPrivate::instance()->font(SettingsPrivate::FF_Playlist);
+	QFont font = SettingsPrivate::instance()->snapshot()->playlistFont;
 	if (_playlist->mediaPlaylist()->currentIndex() == index.row() && _playlist->mediaPlayer()->state() != QMediaPlayer::StoppedState) {
 		font.setBold(true);
 		font.setItalic(true);
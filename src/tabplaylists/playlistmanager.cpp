@@ -5,56 +5,45 @@
 #include <settingsprivate.h>
 #include "playlist.h"
 #include "tabplaylist.h"
-#include <QXmlStreamReader>
 
 PlaylistManager::PlaylistManager(TabPlaylist *parent)
 	: QObject(parent)
 	, _tabPlaylists(parent)
 {}
 
+/** Reads a playlist file entry by entry, and inserts its tracks by batches. */
 bool PlaylistManager::loadPlaylist(Playlist *p, const QFileInfo &fileInfo)
 {
-	QList<QMediaContent> tracks;
+	static const int entriesPerBatch = 256;
 
 	QFile file(fileInfo.absoluteFilePath());
-	file.open(QFile::ReadOnly);
-
-	// M3U or M3U8 file format
-	if (fileInfo.suffix().startsWith("m3u")) {
-		QTextStream in(&file);
-		while (!in.atEnd()) {
-			QString line = in.readLine();
-			tracks << QMediaContent(QUrl(line));
-		}
-		if (!tracks.isEmpty()) {
-			p->mediaPlaylist()->setTitle(fileInfo.baseName());
-		}
-	} else {
-		// XSPF file format
-		QXmlStreamReader xml(file.readAll());
-		QString title;
-		while (!xml.atEnd() && !xml.hasError()) {
-			xml.readNext();
-			if (xml.tokenType() == QXmlStreamReader::StartElement) {
-				if (xml.name() == "title" && title.isEmpty()) {
-					title = xml.readElementText();
-				} else if (xml.name() == "location") {
-					tracks << QMediaContent(QUrl(xml.readElementText()));
-				}
-			}
-		}
-		if (!tracks.isEmpty()) {
-			if (title.isEmpty()) {
-				p->mediaPlaylist()->setTitle(fileInfo.baseName());
-			} else {
-				p->mediaPlaylist()->setTitle(title);
-			}
+	if (!file.open(QFile::ReadOnly)) {
+		return false;
+	}
+
+	PlaylistReader reader(&file, PlaylistReader::format(fileInfo), fileInfo.absoluteDir());
+	QList<PlaylistEntry> entries;
+	PlaylistEntry entry;
+	int entryCount = 0;
+	while (reader.readNext(entry)) {
+		entries << entry;
+		entryCount++;
+		if (entries.size() == entriesPerBatch) {
+			this->insertEntries(p, entries);
+			entries.clear();
 		}
 	}
+	this->insertEntries(p, entries);
 	file.close();
 
-	p->insertMedias(-1, tracks);
-	return !tracks.isEmpty();
+	if (entryCount > 0) {
+		if (reader.title().isEmpty()) {
+			p->mediaPlaylist()->setTitle(fileInfo.baseName());
+		} else {
+			p->mediaPlaylist()->setTitle(reader.title());
+		}
+	}
+	return entryCount > 0;
 }
 
 bool PlaylistManager::deletePlaylist(uint playlistId)
@@ -76,16 +65,10 @@ uint PlaylistManager::savePlaylist(Playlist *p, bool isOverwriting, bool isExiti
 
 	if (p && !p->mediaPlaylist()->isEmpty()) {
 
-		uint generateNewHash = p->generateNewHash();
-		PlaylistDAO playlist;
+		quint64 generateNewHash = p->generateNewHash();
 
 		// Check first if one has the same playlist in database
-		for (PlaylistDAO dao : db.selectPlaylists()) {
-			if (dao.checksum().toUInt() == generateNewHash) {
-				playlist = dao;
-				break;
-			}
-		}
+		PlaylistDAO playlist = db.selectPlaylistByChecksum(generateNewHash, p->model()->uris());
 
 		// No playlists with this checksum were found -> it's possible to write/overwrite this one
 		if (playlist.id().isEmpty()) {
@@ -121,20 +104,70 @@ uint PlaylistManager::savePlaylist(Playlist *p, bool isOverwriting, bool isExiti
 		playlist.setTitle(p->mediaPlaylist()->title());
 		playlist.setChecksum(QString::number(generateNewHash));
 
-		QStringList tracks;
-		for (int j = 0; j < p->mediaPlaylist()->mediaCount(); j++) {
-			// Eeach track has been saved in a hidden column into the playlist
-			tracks << p->model()->index(j, p->COL_TRACK_DAO).data().toString();
-		}
+		// Only changes are written when the same playlist is overwritten
+		bool isSaved = isOverwriting && p->id() > 0 && playlist.id().toUInt() == p->id();
+		PlaylistTracksDelta tracks = p->model()->tracksDelta(isSaved);
 
 		id = db.insertIntoTablePlaylists(playlist, tracks, isOverwriting);
-
-		p->setId(id);
-		p->setHash(generateNewHash);
+		// Nothing was written if the save has failed: the playlist is still modified
+		if (id != 0) {
+			p->model()->setTracksSaved(tracks);
+			p->setId(id);
+			p->setHash(generateNewHash);
+		}
 	}
 	return id;
 }
 
+/** Consecutive local tracks are inserted at once: tags come from the library, or from the playlist file if they're not. */
+void PlaylistManager::insertEntries(Playlist *p, const QList<PlaylistEntry> &entries)
+{
+	QStringList uris;
+	QList<PlaylistEntry> localEntries;
+	QList<QMediaContent> remoteMedias;
+
+	auto insertLocalTracks = [&]() {
+		if (localEntries.isEmpty()) {
+			return;
+		}
+		QList<TrackDAO> tracks = SqlDatabase::reader()->selectTracksFromLibrary(uris);
+		for (int i = 0; i < tracks.size(); i++) {
+			TrackDAO &track = tracks[i];
+			const PlaylistEntry &localEntry = localEntries.at(i);
+			if (track.id().isEmpty()) {
+				track.setTitle(localEntry.title);
+				track.setArtist(localEntry.artist);
+				track.setAlbum(localEntry.album);
+				if (localEntry.length >= 0) {
+					track.setLength(QString::number(localEntry.length));
+				}
+			}
+		}
+		p->insertLocalTracks(-1, tracks);
+		uris.clear();
+		localEntries.clear();
+	};
+	auto insertRemoteMedias = [&]() {
+		if (!remoteMedias.isEmpty()) {
+			p->insertMedias(-1, remoteMedias);
+			remoteMedias.clear();
+		}
+	};
+
+	for (const PlaylistEntry &entry : entries) {
+		if (entry.url.isLocalFile()) {
+			insertRemoteMedias();
+			uris << entry.url.toLocalFile();
+			localEntries << entry;
+		} else {
+			insertLocalTracks();
+			remoteMedias << QMediaContent(entry.url);
+		}
+	}
+	insertLocalTracks();
+	insertRemoteMedias();
+}
+
 void PlaylistManager::saveAndRemovePlaylist(Playlist *p, int index, bool isOverwriting)
 {
 	if (this->savePlaylist(p, isOverwriting, false) != 0) {
@@ -3,6 +3,8 @@
 
 #include <QObject>
 #include <QFileInfo>
+
+#include "playlistfile.h"
 #include "miamtabplaylists_global.hpp"
 
 /// Forward declarations
@@ -23,8 +25,13 @@ private:
 public:
 	explicit PlaylistManager(TabPlaylist *parent);
 
+	/** Reads a playlist file entry by entry, and inserts its tracks by batches. */
 	bool loadPlaylist(Playlist *p, const QFileInfo &fileInfo);
 
+private:
+	/** Consecutive local tracks are inserted at once: tags come from the library, or from the playlist file if they're not. */
+	void insertEntries(Playlist *p, const QList<PlaylistEntry> &entries);
+
 public slots:
 	bool deletePlaylist(uint playlistId);
 
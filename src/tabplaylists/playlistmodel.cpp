@@ -2,24 +2,143 @@
 
 #include "model/sqldatabase.h"
 #include "filehelper.h"
-#include "settingsprivate.h"
+#include "settingssnapshot.h"
 #include "starrating.h"
 
 #include <QFile>
+#include <QThreadPool>
 #include <QTime>
 #include <QUrl>
 
 #include <algorithm>
-#include <functional>
+#include <limits>
+#include <memory>
 
 #include <QtDebug>
 
 #include "playlistheaderview.h"
 
+namespace {
+
+/** Tracks which weren't saved yet don't have a position, new positions may be negative. */
+const qint64 noPosition = std::numeric_limits<qint64>::min();
+
+template <typename T>
+void insertColumn(QVector<T> &column, int row, const QVector<T> &values)
+{
+	if (row == column.size()) {
+		column += values;
+	} else {
+		column.insert(row, values.size(), T());
+		std::copy(values.constBegin(), values.constEnd(), column.begin() + row);
+	}
+}
+
+}
+
+MissingTracksTask::MissingTracksTask(const QStringList &absFilePaths)
+	: QObject(nullptr)
+	, _absFilePaths(absFilePaths)
+{
+	setAutoDelete(false);
+}
+
+void MissingTracksTask::run()
+{
+	QStringList missingTracks;
+	for (QString absFilePath : _absFilePaths) {
+		if (!QFile::exists(absFilePath)) {
+			missingTracks << absFilePath;
+		}
+	}
+	if (!missingTracks.isEmpty()) {
+		emit missingTracksFound(missingTracks);
+	}
+	this->deleteLater();
+}
+
+void PlaylistModel::Tracks::append(const Tracks &tracks, int row)
+{
+	uris.append(tracks.uris.at(row));
+	titles.append(tracks.titles.at(row));
+	artists.append(tracks.artists.at(row));
+	albums.append(tracks.albums.at(row));
+	icons.append(tracks.icons.at(row));
+	sources.append(tracks.sources.at(row));
+	savedPositions.append(tracks.savedPositions.at(row));
+	lengths.append(tracks.lengths.at(row));
+	trackNumbers.append(tracks.trackNumbers.at(row));
+	years.append(tracks.years.at(row));
+	ratings.append(tracks.ratings.at(row));
+	remotes.append(tracks.remotes.at(row));
+}
+
+void PlaylistModel::Tracks::insert(int row, const Tracks &tracks)
+{
+	insertColumn(uris, row, tracks.uris);
+	insertColumn(titles, row, tracks.titles);
+	insertColumn(artists, row, tracks.artists);
+	insertColumn(albums, row, tracks.albums);
+	insertColumn(icons, row, tracks.icons);
+	insertColumn(sources, row, tracks.sources);
+	insertColumn(savedPositions, row, tracks.savedPositions);
+	insertColumn(lengths, row, tracks.lengths);
+	insertColumn(trackNumbers, row, tracks.trackNumbers);
+	insertColumn(years, row, tracks.years);
+	insertColumn(ratings, row, tracks.ratings);
+	insertColumn(remotes, row, tracks.remotes);
+}
+
+void PlaylistModel::Tracks::remove(int row, int count)
+{
+	uris.remove(row, count);
+	titles.remove(row, count);
+	artists.remove(row, count);
+	albums.remove(row, count);
+	icons.remove(row, count);
+	sources.remove(row, count);
+	savedPositions.remove(row, count);
+	lengths.remove(row, count);
+	trackNumbers.remove(row, count);
+	years.remove(row, count);
+	ratings.remove(row, count);
+	remotes.remove(row, count);
+}
+
+void PlaylistModel::Tracks::reserve(int size)
+{
+	uris.reserve(size);
+	titles.reserve(size);
+	artists.reserve(size);
+	albums.reserve(size);
+	icons.reserve(size);
+	sources.reserve(size);
+	savedPositions.reserve(size);
+	lengths.reserve(size);
+	trackNumbers.reserve(size);
+	years.reserve(size);
+	ratings.reserve(size);
+	remotes.reserve(size);
+}
+
 PlaylistModel::PlaylistModel(QObject *parent)
-	: QStandardItemModel(0, PlaylistHeaderView::labels.count(), parent)
+	: QAbstractTableModel(parent)
+	, _strings(QString())
+	, _font(SettingsPrivate::instance()->snapshot()->playlistFont)
+	, _headerData(PlaylistHeaderView::labels.count())
 	, _mediaPlaylist(new MediaPlaylist(this))
-{}
+{
+	_stringIds.insert(QString(), 0);
+
+	connect(SettingsPrivate::instance(), &SettingsPrivate::fontHasChanged, this, [=](SettingsPrivate::FontFamily ff, const QFont &font) {
+		if (ff == SettingsPrivate::FF_Playlist) {
+			_font = font;
+			if (rowCount() > 0) {
+				emit dataChanged(index(0, 0), index(rowCount() - 1, columnCount() - 1), { Qt::FontRole });
+			}
+		}
+	});
+}
 
 PlaylistModel::~PlaylistModel()
 {}
@@ -32,153 +151,243 @@ void PlaylistModel::clear()
 	}
 }
 
-bool PlaylistModel::insertMedias(int rowIndex, const QList<QMediaContent> &tracks)
+int PlaylistModel::columnCount(const QModelIndex &parent) const
+{
+	return parent.isValid() ? 0 : _headerData.size();
+}
+
+QVariant PlaylistModel::data(const QModelIndex &index, int role) const
 {
-	int c = this->rowCount();
-	SqlDatabase db;
-	if (_mediaPlaylist->insertMedia(rowIndex, tracks)) {
-		for (QMediaContent track : tracks) {
-			if (track.canonicalUrl().isLocalFile()) {
-				FileHelper f(track);
-				if (f.isValid()) {
-					this->insertMedia(rowIndex++, f);
-				}
-			} else {
-				TrackDAO t = db.selectTrackByURI(track.canonicalUrl().toString());
-				this->createLine(rowIndex++, t);
+	if (!index.isValid() || index.row() >= _tracks.size()) {
+		return QVariant();
+	}
+
+	int row = index.row();
+	bool isRemote = _tracks.remotes.at(row);
+	switch (role) {
+	case Qt::DisplayRole:
+	case Qt::EditRole:
+		switch (index.column()) {
+		case Playlist::COL_TRACK_NUMBER:
+			if (_tracks.trackNumbers.at(row) > 0) {
+				return QString("%1").arg(_tracks.trackNumbers.at(row), 2, 10, QChar('0'));
+			}
+			break;
+		case Playlist::COL_TITLE:
+			return _tracks.titles.at(row);
+		case Playlist::COL_ALBUM:
+			return _strings.at(_tracks.albums.at(row));
+		case Playlist::COL_LENGTH:
+			return _tracks.lengths.at(row);
+		case Playlist::COL_ARTIST:
+			return _strings.at(_tracks.artists.at(row));
+		case Playlist::COL_RATINGS:
+			// Empty local ratings can be edited without drawing empty stars
+			if (isRemote || _tracks.ratings.at(row) > 0) {
+				return QVariant::fromValue(StarRating(_tracks.ratings.at(row)));
 			}
+			break;
+		case Playlist::COL_YEAR:
+			if (_tracks.years.at(row) > 0) {
+				return QString::number(_tracks.years.at(row));
+			}
+			break;
+		case Playlist::COL_ICON:
+			if (_tracks.icons.at(row) == 0) {
+				return tr("Local");
+			}
+			break;
+		case Playlist::COL_TRACK_DAO:
+			return _tracks.uris.at(row);
+		}
+		break;
+	case Qt::DecorationRole:
+		if (index.column() == Playlist::COL_ICON) {
+			int icon = _tracks.icons.at(row);
+			if (!_icons.contains(icon)) {
+				_icons.insert(icon, QIcon(icon == 0 ? QString(":/icons/computer") : _strings.at(icon)));
+			}
+			return _icons.value(icon);
+		}
+		break;
+	case Qt::ToolTipRole:
+		if (index.column() == Playlist::COL_ICON) {
+			return _tracks.icons.at(row) == 0 ? tr("Local file") : _strings.at(_tracks.sources.at(row));
+		} else if (index.column() == Playlist::COL_RATINGS && isRemote) {
+			return tr("You cannot modify remote medias");
+		}
+		break;
+	case Qt::TextAlignmentRole:
+		switch (index.column()) {
+		case Playlist::COL_TRACK_NUMBER:
+		case Playlist::COL_LENGTH:
+		case Playlist::COL_RATINGS:
+		case Playlist::COL_YEAR:
+			return static_cast<int>(Qt::AlignCenter);
 		}
+		break;
+	case Qt::FontRole:
+		return _font;
+	case RemoteMedia:
+		return isRemote;
+	case SavedPosition:
+		if (index.column() == Playlist::COL_TRACK_DAO && _tracks.savedPositions.at(row) != noPosition) {
+			return _tracks.savedPositions.at(row);
+		}
+		break;
 	}
-	return c < this->rowCount();
+	return QVariant();
 }
 
-bool PlaylistModel::insertMedias(int rowIndex, const QList<TrackDAO> &tracks)
+Qt::ItemFlags PlaylistModel::flags(const QModelIndex &index) const
 {
-	int c = this->rowCount();
-	for (int i = 0; i < tracks.size(); i++) {
-		TrackDAO track = tracks.at(i);
-		QMediaContent mc(QUrl(track.uri()));
-		if (_mediaPlaylist->insertMedia(rowIndex + i, mc)) {
-			this->createLine(rowIndex + i, track);
-		}
+	if (!index.isValid()) {
+		return Qt::NoItemFlags;
 	}
-	return c < this->rowCount();
+	return Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsDragEnabled;
 }
 
-void PlaylistModel::createLine(int row, const TrackDAO &track)
+QVariant PlaylistModel::headerData(int section, Qt::Orientation orientation, int role) const
 {
-	QStandardItem *trackItem = new QStandardItem;
-	if (!track.trackNumber().isEmpty()) {
-		trackItem->setText(QString("%1").arg(track.trackNumber().toInt(), 2, 10, QChar('0')));
+	if (orientation == Qt::Horizontal && section >= 0 && section < _headerData.size() && _headerData.at(section).contains(role)) {
+		return _headerData.at(section).value(role);
 	}
-	QStandardItem *titleItem = new QStandardItem(track.title());
-	QStandardItem *albumItem = new QStandardItem(track.album());
-	QStandardItem *lengthItem = new QStandardItem(track.length());
-	QStandardItem *artistItem = new QStandardItem(track.artist());
-	QStandardItem *ratingItem = new QStandardItem;
-	StarRating r(track.rating());
-	ratingItem->setData(QVariant::fromValue(r), Qt::DisplayRole);
-	ratingItem->setData(true, RemoteMedia);
-	ratingItem->setToolTip(tr("You cannot modify remote medias"));
+	return QAbstractTableModel::headerData(section, orientation, role);
+}
 
-	QStandardItem *yearItem = new QStandardItem(track.year());
-	QStandardItem *iconItem = new QStandardItem;
-	if (track.icon().isEmpty()) {
-		iconItem->setText(tr("Local"));
-		iconItem->setIcon(QIcon(":/icons/computer"));
-		iconItem->setToolTip(tr("Local file"));
-	} else {
-		iconItem->setIcon(QIcon(track.icon()));
-		iconItem->setToolTip(track.source());
+bool PlaylistModel::insertMedias(int rowIndex, const QList<QMediaContent> &tracks)
+{
+	if (!_mediaPlaylist->insertMedia(rowIndex, tracks)) {
+		return false;
 	}
 
-	QStandardItem *trackDAO = new QStandardItem;
-	trackDAO->setData(QVariant::fromValue(track), Qt::DisplayRole);
-
-	trackItem->setTextAlignment(Qt::AlignCenter);
-	lengthItem->setTextAlignment(Qt::AlignCenter);
-	ratingItem->setTextAlignment(Qt::AlignCenter);
-	yearItem->setTextAlignment(Qt::AlignCenter);
-
-	QList<QStandardItem *> items;
-	items << trackItem << titleItem << albumItem << lengthItem << artistItem << ratingItem \
-		  << yearItem << iconItem << trackDAO;
+	SqlDatabase &db = *SqlDatabase::reader();
+	Tracks rows;
+	rows.reserve(tracks.size());
+	for (QMediaContent track : tracks) {
+		if (track.canonicalUrl().isLocalFile()) {
+			FileHelper f(track);
+			if (f.isValid()) {
+				this->appendTrack(rows, readTrack(f), false);
+			}
+		} else {
+			TrackDAO t = db.selectTrackByURI(track.canonicalUrl().toString());
+			this->appendTrack(rows, t, true);
+		}
+	}
+	this->insertTracks(rowIndex, rows);
+	return rows.size() > 0;
+}
 
-	this->insertRow(row, items);
+bool PlaylistModel::insertMedias(int rowIndex, const QList<TrackDAO> &tracks)
+{
+	QList<QMediaContent> medias;
+	Tracks rows;
+	rows.reserve(tracks.size());
+	for (const TrackDAO &track : tracks) {
+		medias << QMediaContent(QUrl(track.uri()));
+		this->appendTrack(rows, track, true);
+	}
+	if (!_mediaPlaylist->insertMedia(rowIndex, medias)) {
+		return false;
+	}
+	this->insertTracks(rowIndex, rows);
+	return rows.size() > 0;
 }
 
-void PlaylistModel::insertMedia(int rowIndex, const FileHelper &fileHelper)
+/** Inserts local tracks of a saved playlist. Tags come from the library, only files which aren't in the library are read. */
+bool PlaylistModel::insertLocalTracks(int rowIndex, const QList<TrackDAO> &tracks, const QList<qint64> &positions)
 {
-	QList<QStandardItem *> items;
+	bool hasPositions = positions.size() == tracks.size();
+	if (hasPositions) {
+		// Playlist is restored: positions of previous tracks were related to another playlist
+		_removedPositions.clear();
+	}
+	QList<QMediaContent> medias;
+	for (const TrackDAO &track : tracks) {
+		medias << QMediaContent(QUrl::fromLocalFile(track.uri()));
+	}
+	if (!_mediaPlaylist->insertMedia(rowIndex, medias)) {
+		return false;
+	}
 
-	QStandardItem *trackItem, *titleItem, *albumItem, *lengthItem, *artistItem, *ratingItem, *yearItem;
-	QStandardItem *trackDAO = new QStandardItem;
-	QStandardItem *iconItem = new QStandardItem(tr("Local"));
-	iconItem->setIcon(QIcon(":/icons/computer"));
-	iconItem->setToolTip(tr("Local file"));
-	if (FileHelper::suffixes(FileHelper::ET_Standard).contains(fileHelper.fileInfo().suffix())) {
-		QString title;
-		if (fileHelper.title().isEmpty()) {
-			title = fileHelper.fileInfo().baseName();
+	QStringList absFilePaths;
+	Tracks rows;
+	rows.reserve(tracks.size());
+	for (int i = 0; i < tracks.size(); i++) {
+		const TrackDAO &track = tracks.at(i);
+		absFilePaths << track.uri();
+		// Tags can also come from the playlist file the track was imported from
+		std::unique_ptr<FileHelper> f;
+		if (track.id().isEmpty() && track.title().isEmpty()) {
+			f.reset(new FileHelper(track.uri()));
+		}
+		if (f && f->isValid()) {
+			this->appendTrack(rows, readTrack(*f), false);
 		} else {
-			title = fileHelper.title();
-		}
-
-		// Then, construct a new row with correct informations
-		trackItem = new QStandardItem(fileHelper.trackNumber());
-		titleItem = new QStandardItem(title);
-		albumItem = new QStandardItem(fileHelper.album());
-		lengthItem = new QStandardItem(fileHelper.length());
-		artistItem = new QStandardItem(fileHelper.artist());
-		ratingItem = new QStandardItem;
-		int rating = fileHelper.rating();
-		if (rating > 0) {
-			StarRating r(rating);
-			ratingItem->setData(QVariant::fromValue(r), Qt::DisplayRole);
-			ratingItem->setData(false, RemoteMedia);
-		}
-		yearItem = new QStandardItem(fileHelper.year());
-		trackDAO->setData(fileHelper.fileInfo().absoluteFilePath(), Qt::DisplayRole);
-
-		trackItem->setTextAlignment(Qt::AlignCenter);
-		lengthItem->setTextAlignment(Qt::AlignCenter);
-		ratingItem->setTextAlignment(Qt::AlignCenter);
-		yearItem->setTextAlignment(Qt::AlignCenter);
+			// Each media needs a row, even if the file is missing: it will be removed after the check below
+			this->appendTrack(rows, track, false);
+		}
+		if (hasPositions) {
+			rows.savedPositions.last() = positions.at(i);
+		}
+	}
+	this->insertTracks(rowIndex, rows);
 
-	} else {
-		trackItem = new QStandardItem;
-		titleItem = new QStandardItem(fileHelper.fileInfo().baseName());
-		albumItem = new QStandardItem;
-		lengthItem = new QStandardItem(QString::number(-1));
-		artistItem = new QStandardItem;
-		ratingItem = new QStandardItem;
-		yearItem = new QStandardItem;
+	// Tracks are displayed without waiting for the filesystem
+	MissingTracksTask *task = new MissingTracksTask(absFilePaths);
+	connect(task, &MissingTracksTask::missingTracksFound, this, &PlaylistModel::removeMissingTracks, Qt::QueuedConnection);
+	QThreadPool::globalInstance()->start(task);
+
+	return rows.size() > 0;
+}
+
+/** Inserts local tracks which tags were read in another thread. */
+bool PlaylistModel::insertReadTracks(int rowIndex, const QList<TrackDAO> &tracks)
+{
+	QList<QMediaContent> medias;
+	Tracks rows;
+	rows.reserve(tracks.size());
+	for (const TrackDAO &track : tracks) {
+		medias << QMediaContent(QUrl::fromLocalFile(track.uri()));
+		this->appendTrack(rows, track, false);
+	}
+	if (!_mediaPlaylist->insertMedia(rowIndex, medias)) {
+		return false;
 	}
-	items << trackItem << titleItem << albumItem << lengthItem << artistItem << ratingItem \
-		  << yearItem << iconItem << trackDAO;
-	this->insertRow(rowIndex, items);
+	this->insertTracks(rowIndex, rows);
+	return rows.size() > 0;
 }
 
-/** Moves rows from various positions to a new one (discontiguous rows are grouped). */
-QList<QStandardItem*> PlaylistModel::internalMove(QModelIndex dest, QModelIndexList selectedIndexes)
+/** Moves rows from various positions to a new one (discontiguous rows are grouped). Returns rows which were moved. */
+QList<int> PlaylistModel::internalMove(QModelIndex dest, QModelIndexList selectedIndexes)
 {
-	// After moving rows, selection is lost. We need to keep a track on previously selected indexes
-	QList<QStandardItem*> rowsToHiglight;
+	QList<int> selectedRows;
+	for (QModelIndex selectedIndex : selectedIndexes) {
+		selectedRows << selectedIndex.row();
+	}
+	std::sort(selectedRows.begin(), selectedRows.end());
+	selectedRows.erase(std::unique(selectedRows.begin(), selectedRows.end()), selectedRows.end());
+
+	Tracks tracksToMove;
+	tracksToMove.reserve(selectedRows.size());
 	QList<QMediaContent> mediasToMove;
+	for (int row : selectedRows) {
+		this->forgetSavedPosition(row);
+		tracksToMove.append(_tracks, row);
+		mediasToMove << _mediaPlaylist->media(row);
+	}
 
-	// Sort in reverse lexical order for correctly taking rows
-	std::sort(selectedIndexes.begin(), selectedIndexes.end(), [](const QModelIndex &a, const QModelIndex &b) { return b < a; });
-	QList<QList<QStandardItem*>> removedRows;
+	// Remove contiguous rows at once, from the bottom so that next rows keep their index
 	_mediaPlaylist->blockSignals(true);
-	int currentPlayingTrack = _mediaPlaylist->currentIndex();
-	for (QModelIndex selectedIndex : selectedIndexes) {
-		int rowNumber = selectedIndex.row();
-		QList<QStandardItem*> row = this->takeRow(rowNumber);
-		rowsToHiglight << row.at(0);
-		removedRows.append(row);
-		mediasToMove.prepend(_mediaPlaylist->media(rowNumber));
-		_mediaPlaylist->removeMedia(rowNumber);
-		currentPlayingTrack--;
+	for (int i = selectedRows.size() - 1; i >= 0; i--) {
+		int last = selectedRows.at(i);
+		int first = last;
+		while (i > 0 && selectedRows.at(i - 1) == first - 1) {
+			first = selectedRows.at(--i);
+		}
+		this->removeTracks(first, last - first + 1);
+		_mediaPlaylist->removeMedia(first, last);
 	}
 
 	// Dest equals -1 when rows are dropped at the bottom of the playlist
@@ -186,62 +395,272 @@ QList<QStandardItem*> PlaylistModel::internalMove(QModelIndex dest, QModelIndexL
 	if (insertPoint > rowCount()) {
 		insertPoint = rowCount();
 	}
-	for (int i = 0; i < removedRows.count(); i++) {
-		this->insertRow(insertPoint, removedRows.at(i));
-	}
+	this->insertTracks(insertPoint, tracksToMove);
 
 	// Finally, reorder the inner QMediaPlaylist
 	_mediaPlaylist->insertMedia(insertPoint, mediasToMove);
-	currentPlayingTrack += mediasToMove.size();
-    _mediaPlaylist->blockSignals(false);
-    return rowsToHiglight;
-}
+	_mediaPlaylist->blockSignals(false);
 
-void PlaylistModel::insertRow(int row, const QList<QStandardItem*> &items)
-{
-	QFont font = SettingsPrivate::instance()->font(SettingsPrivate::FF_Playlist);
-	for (int i = 0; i < items.length(); i++) {
-		QStandardItem *item = items.at(i);
-		item->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsDragEnabled);
-		item->setFont(font);
+	QList<int> rowsToHighlight;
+	for (int row = insertPoint; row < insertPoint + tracksToMove.size(); row++) {
+		rowsToHighlight << row;
 	}
-	QStandardItemModel::insertRow(row, items);
+	return rowsToHighlight;
 }
 
 void PlaylistModel::reload()
 {
 	for (int row = 0; row < rowCount(); row++) {
-		QStandardItem *currentTrackItem = item(row, Playlist::COL_TRACK_DAO);
-		FileHelper fileHelper(currentTrackItem->data(Qt::DisplayRole).toString());
-
-		QString title;
-		if (fileHelper.title().isEmpty()) {
-			title = fileHelper.fileInfo().baseName();
-		} else {
-			title = fileHelper.title();
+		if (_tracks.remotes.at(row)) {
+			continue;
 		}
+		// Tags were edited but the audio stream wasn't: lengths are kept, and audio properties aren't read
+		FileHelper fileHelper(_tracks.uris.at(row), FileHelper::OM_TagsOnly);
+		TrackDAO track = readTrack(fileHelper);
+		_tracks.titles[row] = track.title().isEmpty() ? fileHelper.fileInfo().baseName() : track.title();
+		_tracks.artists[row] = this->intern(track.artist());
+		_tracks.albums[row] = this->intern(track.album());
+		_tracks.trackNumbers[row] = track.trackNumber().toInt();
+		_tracks.years[row] = track.year().toInt();
+		_tracks.ratings[row] = track.rating();
+	}
+	if (rowCount() > 0) {
+		emit dataChanged(index(0, 0), index(rowCount() - 1, columnCount() - 1));
+	}
+}
 
-		// Then, construct a new row with correct informations
-		item(row, Playlist::COL_TRACK_NUMBER)->setData(fileHelper.trackNumber(), Qt::DisplayRole);
-		item(row, Playlist::COL_TITLE)->setData(title, Qt::DisplayRole);
-		item(row, Playlist::COL_ALBUM)->setData(fileHelper.album(), Qt::DisplayRole);
-		item(row, Playlist::COL_LENGTH)->setData(fileHelper.length(), Qt::DisplayRole);
-		item(row, Playlist::COL_ARTIST)->setData(fileHelper.artist(), Qt::DisplayRole);
-		int rating = fileHelper.rating();
-		if (rating > 0) {
-			StarRating r(rating);
-			item(row, Playlist::COL_RATINGS)->setData(QVariant::fromValue(r), Qt::DisplayRole);
-			item(row, Playlist::COL_RATINGS)->setData(false, RemoteMedia);
+/** Removes tracks which were restored but don't exist anymore. */
+void PlaylistModel::removeMissingTracks(const QStringList &absFilePaths)
+{
+	QSet<QString> missingTracks = absFilePaths.toSet();
+	for (int row = rowCount() - 1; row >= 0; row--) {
+		if (!_tracks.remotes.at(row) && missingTracks.contains(_tracks.uris.at(row))) {
+			this->removeTrack(row);
 		}
-		item(row, Playlist::COL_YEAR)->setData(fileHelper.year(), Qt::DisplayRole);
 	}
 }
 
+/** Redefined to remember positions of removed tracks, they will be deleted from the database with the next save. */
+bool PlaylistModel::removeRows(int row, int count, const QModelIndex &parent)
+{
+	if (parent.isValid() || row < 0 || count <= 0 || row + count > rowCount()) {
+		return false;
+	}
+	for (int i = row; i < row + count; i++) {
+		this->forgetSavedPosition(i);
+	}
+	this->removeTracks(row, count);
+	if (_tracks.size() == 0) {
+		// Nothing refers to shared strings anymore
+		_strings = QStringList(QString());
+		_stringIds.clear();
+		_stringIds.insert(QString(), 0);
+		_icons.clear();
+	}
+	return true;
+}
+
 void PlaylistModel::removeTrack(int row)
 {
-	QStandardItemModel::removeRow(row);
+	this->removeRow(row);
 	_mediaPlaylist->removeMedia(row);
 	if (_mediaPlaylist->playbackMode() == QMediaPlaylist::Random) {
 		_mediaPlaylist->shuffle(-1);
 	}
 }
+
+int PlaylistModel::rowCount(const QModelIndex &parent) const
+{
+	return parent.isValid() ? 0 : _tracks.size();
+}
+
+/** Redefined to save ratings modified by the star editor. */
+bool PlaylistModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+	if (!index.isValid() || index.column() != Playlist::COL_RATINGS || !value.canConvert<StarRating>()) {
+		return false;
+	}
+	if (role != Qt::EditRole && role != Qt::DisplayRole) {
+		return false;
+	}
+	_tracks.ratings[index.row()] = value.value<StarRating>().starCount();
+	emit dataChanged(index, index);
+	return true;
+}
+
+bool PlaylistModel::setHeaderData(int section, Qt::Orientation orientation, const QVariant &value, int role)
+{
+	if (orientation != Qt::Horizontal || section < 0 || section >= _headerData.size()) {
+		return false;
+	}
+	_headerData[section].insert(role == Qt::EditRole ? Qt::DisplayRole : role, value);
+	emit headerDataChanged(orientation, section, section);
+	return true;
+}
+
+/** Uris of every row, in their order. */
+QStringList PlaylistModel::uris() const
+{
+	return QStringList(_tracks.uris.toList());
+}
+
+/** Stores positions written by the last save, which becomes the reference for next changes. */
+void PlaylistModel::setTracksSaved(const PlaylistTracksDelta &tracks)
+{
+	_removedPositions.clear();
+
+	// Inserted tracks are in the same order as rows without a position, or as every row if the playlist was written again
+	int i = 0;
+	for (int row = 0; row < rowCount() && i < tracks.insertedTracks.size(); row++) {
+		if (tracks.isComplete || _tracks.savedPositions.at(row) == noPosition) {
+			_tracks.savedPositions[row] = tracks.insertedTracks.at(i++).first;
+		}
+	}
+}
+
+/**
+ * Returns changes since the last save. New tracks get a position between their neighbours. Every track is written again
+ * if the playlist wasn't saved yet, or if there's no room left between two positions.
+ */
+PlaylistTracksDelta PlaylistModel::tracksDelta(bool isSaved) const
+{
+	static const qint64 positionGap = 1024;
+
+	PlaylistTracksDelta delta;
+	delta.isComplete = !isSaved;
+	if (isSaved) {
+		delta.removedPositions = _removedPositions;
+		bool hasPrevious = false;
+		qint64 previous = 0;
+		int row = 0;
+		while (row < rowCount() && !delta.isComplete) {
+			// New tracks between two saved tracks
+			int first = row;
+			while (row < rowCount() && _tracks.savedPositions.at(row) == noPosition) {
+				row++;
+			}
+			bool hasNext = row < rowCount();
+			qint64 next = hasNext ? _tracks.savedPositions.at(row) : 0;
+			int count = row - first;
+
+			qint64 start = 0;
+			qint64 step = positionGap;
+			if (hasPrevious && hasNext) {
+				step = (next - previous) / (count + 1);
+				start = previous + step;
+				// No room left between positions
+				delta.isComplete = (step <= 0);
+			} else if (hasPrevious) {
+				start = previous + positionGap;
+			} else if (hasNext) {
+				start = next - count * positionGap;
+			}
+			for (int i = 0; i < count && !delta.isComplete; i++) {
+				delta.insertedTracks.append(qMakePair(start + i * step, _tracks.uris.at(first + i)));
+			}
+			if (hasNext) {
+				previous = next;
+				hasPrevious = true;
+				row++;
+			}
+		}
+	}
+
+	if (delta.isComplete) {
+		delta.removedPositions.clear();
+		delta.insertedTracks.clear();
+		for (int row = 0; row < rowCount(); row++) {
+			delta.insertedTracks.append(qMakePair((row + 1) * positionGap, _tracks.uris.at(row)));
+		}
+	}
+	return delta;
+}
+
+/** Appends a track to a block of rows which will be inserted at once. */
+void PlaylistModel::appendTrack(Tracks &tracks, const TrackDAO &track, bool isRemote)
+{
+	QString title = track.title();
+	if (title.isEmpty() && !isRemote) {
+		title = QFileInfo(track.uri()).baseName();
+	}
+	tracks.uris.append(track.uri());
+	tracks.titles.append(title);
+	tracks.artists.append(this->intern(track.artist()));
+	tracks.albums.append(this->intern(track.album()));
+	tracks.icons.append(isRemote ? this->intern(track.icon()) : 0);
+	tracks.sources.append(isRemote ? this->intern(track.source()) : 0);
+	tracks.savedPositions.append(noPosition);
+	// Tracks which aren't in the library may have no length in the playlist file: it stays unknown instead of 0:00
+	tracks.lengths.append(track.length().isEmpty() ? -1 : track.length().toInt());
+	tracks.trackNumbers.append(track.trackNumber().toInt());
+	tracks.years.append(track.year().toInt());
+	tracks.ratings.append(track.rating());
+	tracks.remotes.append(isRemote);
+}
+
+void PlaylistModel::insertTracks(int row, const Tracks &tracks)
+{
+	if (tracks.size() == 0) {
+		return;
+	}
+	if (row < 0 || row > rowCount()) {
+		row = rowCount();
+	}
+
+	_checksum.insert(row, tracks.uris);
+
+	beginInsertRows(QModelIndex(), row, row + tracks.size() - 1);
+	_tracks.insert(row, tracks);
+	endInsertRows();
+}
+
+int PlaylistModel::intern(const QString &string)
+{
+	auto it = _stringIds.constFind(string);
+	if (it != _stringIds.constEnd()) {
+		return it.value();
+	}
+	int id = _strings.size();
+	_strings.append(string);
+	_stringIds.insert(string, id);
+	return id;
+}
+
+void PlaylistModel::removeTracks(int row, int count)
+{
+	_checksum.remove(row, count);
+
+	beginRemoveRows(QModelIndex(), row, row + count - 1);
+	_tracks.remove(row, count);
+	endRemoveRows();
+}
+
+/** Converts tags of a local file, files which aren't standard audio files only have a title. Can be called from any thread. */
+TrackDAO PlaylistModel::readTrack(const FileHelper &fileHelper)
+{
+	TrackDAO track;
+	track.setUri(fileHelper.fileInfo().absoluteFilePath());
+	if (FileHelper::suffixes(FileHelper::ET_Standard).contains(fileHelper.fileInfo().suffix())) {
+		TrackMetadata metadata = fileHelper.readAll();
+		track.setTrackNumber(QString("%1").arg(metadata.trackNumber, 2, 10, QChar('0')));
+		track.setTitle(metadata.title);
+		track.setAlbum(metadata.album);
+		track.setLength(QString::number(metadata.length));
+		track.setArtist(metadata.artist);
+		track.setRating(metadata.rating);
+		track.setYear(metadata.year);
+	} else {
+		track.setTitle(fileHelper.fileInfo().baseName());
+		track.setLength(QString::number(-1));
+	}
+	return track;
+}
+
+/** Track was removed or moved: its row in the database will be deleted with the next save. */
+void PlaylistModel::forgetSavedPosition(int row)
+{
+	if (row >= 0 && row < rowCount() && _tracks.savedPositions.at(row) != noPosition) {
+		_removedPositions.append(_tracks.savedPositions.at(row));
+		_tracks.savedPositions[row] = noPosition;
+	}
+}
@@ -1,60 +1,189 @@
 #ifndef PLAYLISTMODEL_H
 #define PLAYLISTMODEL_H
 
+#include <QAbstractTableModel>
+#include <QFont>
+#include <QHash>
+#include <QIcon>
 #include <QMediaContent>
 #include <QMediaPlaylist>
 #include <QMenu>
-#include <QStandardItemModel>
+#include <QRunnable>
+#include <QVector>
 
+#include <model/sqldatabase.h>
 #include <model/trackdao.h>
 #include <filehelper.h>
 #include <mediaplaylist.h>
+#include <playlistchecksum.h>
 #include "miamtabplaylists_global.hpp"
 
+/**
+ * \brief		The MissingTracksTask class checks that tracks restored from the database still exist on the filesystem.
+ * \details		It runs in a thread of the global pool, so that a saved playlist is displayed before every file has been checked.
+ * \author      Matthieu Bachelier
+ * \copyright   GNU General Public License v3
+ */
+class MissingTracksTask : public QObject, public QRunnable
+{
+	Q_OBJECT
+private:
+	QStringList _absFilePaths;
+
+public:
+	explicit MissingTracksTask(const QStringList &absFilePaths);
+
+	virtual void run() override;
+
+signals:
+	void missingTracksFound(const QStringList &absFilePaths);
+};
+
 /**
  * \brief		The PlaylistModel class is the underlying class for Playlist class.
- * \details		This class add tracks in a table
+ * \details		Tracks are stored by column in compact arrays instead of one item per cell: artists, albums and icons are
+ *				stored once in a pool of strings, numbers are stored as integers, and data for the view is created on demand
+ *				in data(). A playlist with hundred thousands tracks then only costs a few bytes per row, besides its title and
+ *				its uri.
  * \author      Matthieu Bachelier
  * \copyright   GNU General Public License v3
  */
-class MIAMTABPLAYLISTS_LIBRARY PlaylistModel : public QStandardItemModel
+class MIAMTABPLAYLISTS_LIBRARY PlaylistModel : public QAbstractTableModel
 {
 	Q_OBJECT
 	Q_ENUMS(Origin)
+public:
+	enum Origin { RemoteMedia = Qt::UserRole + 1 };
+
+	/** Position of a track in the database, stored in column COL_TRACK_DAO. Tracks which weren't saved yet don't have one. */
+	enum SavedState { SavedPosition = Qt::UserRole + 2 };
+
 private:
+	/** One entry per row for each column. Strings which are shared by many tracks are indexes in _strings. */
+	struct Tracks
+	{
+		QVector<QString> uris;
+		QVector<QString> titles;
+		QVector<int> artists;
+		QVector<int> albums;
+		QVector<int> icons;
+		QVector<int> sources;
+		QVector<qint64> savedPositions;
+		QVector<qint32> lengths;
+		QVector<qint16> trackNumbers;
+		QVector<qint16> years;
+		QVector<qint8> ratings;
+		QVector<bool> remotes;
+
+		void append(const Tracks &tracks, int row);
+		void insert(int row, const Tracks &tracks);
+		void remove(int row, int count);
+		void reserve(int size);
+		inline int size() const { return uris.size(); }
+	};
+
+	Tracks _tracks;
+
+	/** Pool of strings shared by rows, the first one is always empty. */
+	QStringList _strings;
+	QHash<QString, int> _stringIds;
+
+	/** Icons of remote sources are loaded once. */
+	mutable QHash<int, QIcon> _icons;
+
+	QFont _font;
+
+	/** Labels and fonts of the horizontal header, set by views. */
+	QVector<QHash<int, QVariant>> _headerData;
+
 	/** Each instance of PlaylistModel has its own MediaPlaylist. */
 	MediaPlaylist *_mediaPlaylist;
 
+	/** Positions in the database of tracks which were removed or moved since the last save. */
+	QList<qint64> _removedPositions;
+
+	/** Updated each time rows are inserted, moved or removed. */
+	PlaylistChecksum _checksum;
+
 public:
 	explicit PlaylistModel(QObject *parent);
 
 	virtual ~PlaylistModel();
 
-	enum Origin { RemoteMedia = Qt::UserRole + 1 };
-
 	/** Clear the content of playlist. */
 	void clear();
 
+	/** Identifies uris of this playlist and their order, without reading every row. */
+	inline quint64 checksum() const { return _checksum.value(); }
+
+	virtual int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+
+	virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+	virtual Qt::ItemFlags flags(const QModelIndex &index) const override;
+
+	virtual QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
 	bool insertMedias(int rowIndex, const QList<QMediaContent> &tracks);
 
 	bool insertMedias(int rowIndex, const QList<TrackDAO> &tracks);
 
-	/** Moves rows from various positions to a new one (discontiguous rows are grouped). */
-	QList<QStandardItem *> internalMove(QModelIndex dest, QModelIndexList selectedIndexes);
+	/** Inserts local tracks of a saved playlist. Tags come from the library, only files which aren't in the library are read. */
+	bool insertLocalTracks(int rowIndex, const QList<TrackDAO> &tracks, const QList<qint64> &positions = QList<qint64>());
+
+	/** Inserts local tracks which tags were read in another thread. */
+	bool insertReadTracks(int rowIndex, const QList<TrackDAO> &tracks);
 
-	/** Redefined. XXX: warning this method is not marked as Virtual in QStandardItemModel. */
-	void insertRow(int row, const QList<QStandardItem *> & items);
+	/** Moves rows from various positions to a new one (discontiguous rows are grouped). Returns rows which were moved. */
+	QList<int> internalMove(QModelIndex dest, QModelIndexList selectedIndexes);
 
 	inline MediaPlaylist* mediaPlaylist() const { return _mediaPlaylist; }
 
+	/** Converts tags of a local file, files which aren't standard audio files only have a title. Can be called from any thread. */
+	static TrackDAO readTrack(const FileHelper &fileHelper);
+
 	void reload();
 
+	/** Redefined to remember positions of removed tracks, they will be deleted from the database with the next save. */
+	virtual bool removeRows(int row, int count, const QModelIndex &parent = QModelIndex()) override;
+
 	void removeTrack(int row);
 
+	virtual int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+
+	/** Redefined to save ratings modified by the star editor. */
+	virtual bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+
+	virtual bool setHeaderData(int section, Qt::Orientation orientation, const QVariant &value, int role = Qt::EditRole) override;
+
+	/** Uris of every row, in their order. */
+	QStringList uris() const;
+
+	/** Stores positions written by the last save, which becomes the reference for next changes. */
+	void setTracksSaved(const PlaylistTracksDelta &tracks);
+
+	/**
+	 * Returns changes since the last save. New tracks get a position between their neighbours. Every track is written again
+	 * if the playlist wasn't saved yet, or if there's no room left between two positions.
+	 */
+	PlaylistTracksDelta tracksDelta(bool isSaved) const;
+
 private:
-	void createLine(int row, const TrackDAO &track);
+	/** Appends a track to a block of rows which will be inserted at once. */
+	void appendTrack(Tracks &tracks, const TrackDAO &track, bool isRemote);
+
+	void insertTracks(int row, const Tracks &tracks);
+
+	int intern(const QString &string);
+
+	void removeTracks(int row, int count);
+
+	/** Track was removed or moved: its row in the database will be deleted with the next save. */
+	void forgetSavedPosition(int row);
 
-	void insertMedia(int rowIndex, const FileHelper &fileHelper);
+private slots:
+	/** Removes tracks which were restored but don't exist anymore. */
+	void removeMissingTracks(const QStringList &absFilePaths);
 };
 
 #endif // PLAYLISTMODEL_H
@@ -8,7 +8,6 @@
 #include "tabbar.h"
 #include "cornerwidget.h"
 
-#include <QDirIterator>
 #include <QHeaderView>
 
 /** Default constructor. */
@@ -172,7 +171,7 @@ void TabPlaylist::init(MediaPlayer *mediaPlayer)
 void TabPlaylist::loadPlaylist(uint playlistId)
 {
 	Playlist *playlist = nullptr;
-	SqlDatabase db;
+	SqlDatabase &db = *SqlDatabase::reader();
 	PlaylistDAO playlistDao = db.selectPlaylist(playlistId);
 
 	/// TODO: Do not load the playlist if it's already displayed
@@ -190,15 +189,13 @@ void TabPlaylist::loadPlaylist(uint playlistId)
 		playlist = addPlaylist();
 		this->tabBar()->setTabText(count() - 1, playlistDao.title());
 	}
-	playlist->setHash(playlistDao.checksum().toUInt());
+	playlist->setHash(playlistDao.checksum().toULongLong());
 
-	/// Reload tracks from filesystem
+	/// Tags are read from the library, files are only parsed when they're not in the library
 	/// TODO: remote files!
-	QList<QMediaContent> tracks;
-	for (QString track : db.selectPlaylistTracks(playlistId)) {
-		tracks << QMediaContent(QUrl::fromLocalFile(track));
-	}
-	playlist->insertMedias(-1, tracks);
+	QList<qint64> positions;
+	QList<TrackDAO> tracks = db.selectPlaylistTracksFromLibrary(playlistId, &positions);
+	playlist->insertLocalTracks(-1, tracks, positions);
 	playlist->setId(playlistId);
 	playlist->mediaPlaylist()->setTitle(playlistDao.title());
 
@@ -275,6 +272,15 @@ Playlist* TabPlaylist::addPlaylist()
 	connect(p, &Playlist::aboutToSendToTagEditor, this, &TabPlaylist::aboutToSendToTagEditor);
 	connect(p, &Playlist::selectionHasChanged, this, &TabPlaylist::selectionChanged);
 
+	// Automatically plays the first track of folders dropped in an empty playlist
+	connect(p, &Playlist::firstTracksInserted, this, [=]() {
+		if (p->mediaPlaylist()->currentIndex() == -1) {
+			p->mediaPlaylist()->setCurrentIndex(0);
+		}
+		_mediaPlayer->setPlaylist(p->mediaPlaylist());
+		_mediaPlayer->play();
+	});
+
 	// Check if tab icon should indicate that playlist has changed or not
 	connect(p, &Playlist::contentHasChanged, this, [=]() {
 		int playlistTabIndex = -1;
@@ -299,30 +305,8 @@ Playlist* TabPlaylist::addPlaylist()
 /** Add external folders (from a drag and drop) to the current playlist. */
 void TabPlaylist::addExtFolders(const QList<QDir> &folders)
 {
-	bool isEmpty = this->currentPlayList()->mediaPlaylist()->isEmpty();
-
-	QStringList tracks;
-	for (QDir folder : folders) {
-		QDirIterator it(folder.absolutePath(), FileHelper::suffixes(FileHelper::ET_Standard, true), QDir::Files | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
-		while (it.hasNext()) {
-			it.next();
-			if (it.fileInfo().isFile()) {
-				tracks << it.fileInfo().absoluteFilePath();
-			}
-		}
-	}
-	tracks.sort(Qt::CaseInsensitive);
-	QList<QUrl> urls;
-	for (QString t : tracks) {
-		urls << QUrl::fromLocalFile(t);
-	}
-	this->insertItemsToPlaylist(-1, urls);
-
-	// Automatically plays the first track
-	if (isEmpty) {
-		_mediaPlayer->setPlaylist(this->currentPlayList()->mediaPlaylist());
-		_mediaPlayer->play();
-	}
+	// Tags are read in background, rows are appended by chunks
+	this->currentPlayList()->insertFolders(folders);
 }
 
 /** Insert multiple tracks chosen by one from the library or the filesystem into a playlist. */
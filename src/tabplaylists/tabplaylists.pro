@@ -16,9 +16,11 @@ SOURCES += dialogs/closeplaylistpopup.cpp \
     changehierarchybutton.cpp \
     cornerwidget.cpp \
     extendedtabbar.cpp \
+    folderinsertiontask.cpp \
     playlist.cpp \
     playlistheaderview.cpp \
     playlistitemdelegate.cpp \
+    playlistfile.cpp \
     playlistmanager.cpp \
     playlistmodel.cpp \
     stareditor.cpp \
@@ -41,11 +43,13 @@ HEADERS += dialogs/closeplaylistpopup.h \
     cornerwidget.h \
     extendedtabbar.h \
     extendedtabwidget.h \
+    folderinsertiontask.h \
     miamtabPlaylists_global.hpp \
     nofocusitemdelegate.h \
     playlist.h \
     playlistheaderview.h \
     playlistitemdelegate.h \
+    playlistfile.h \
     playlistmanager.h \
     playlistmodel.h \
     stareditor.h \
@@ -288,6 +288,9 @@ void ViewPlaylists::setMusicSearchEngine(MusicSearchEngine *musicSearchEngine)
 			w->deleteLater();
 		}
 	});
+
+	// Files modified while the player is running are updated in place
+	connect(musicSearchEngine, &MusicSearchEngine::libraryChanged, library->model(), &LibraryItemModel::updateTracks);
 }
 
 bool ViewPlaylists::viewProperty(Settings::ViewProperty vp) const
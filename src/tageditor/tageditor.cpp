@@ -309,7 +309,10 @@ void TagEditor::applyCoverToAll(bool isForAll, Cover *cover)
 					qDebug() << Q_FUNC_INFO << "but there's already a cover waiting to be saved, deleting it and replacing it";
 					delete current;
 				}
-				_unsavedCovers.insert(row, new Cover(cover->byteArray(), QString::fromUtf8(cover->mimeType().c_str())));
+				// A copy shares the picture of the caller, which may have been extracted from a track
+				Cover *copy = new Cover(*cover);
+				copy->setChanged(false);
+				_unsavedCovers.insert(row, copy);
 			} else {
 				// Do not replace the cover for the caller
 				if (c != cover) {
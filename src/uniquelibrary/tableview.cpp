@@ -1,9 +1,10 @@
 #include "tableview.h"
 
 #include <model/sqldatabase.h>
+#include <covercache.h>
 #include <libraryfilterproxymodel.h>
 #include <libraryscrollbar.h>
-#include <settingsprivate.h>
+#include <settingssnapshot.h>
 
 #include <QGuiApplication>
 #include <QHeaderView>
@@ -28,6 +29,7 @@ TableView::TableView(QWidget *parent)
 {
 	_model->proxy()->setDynamicSortFilter(false);
 	this->setModel(_model->proxy());
+	connect(_model, &MiamItemModel::loaded, this, &TableView::adjust);
 	this->setVerticalScrollMode(ScrollPerPixel);
 	LibraryScrollBar *vScrollBar = new LibraryScrollBar(this);
 	this->setVerticalScrollBar(vScrollBar);
@@ -56,6 +58,10 @@ TableView::TableView(QWidget *parent)
 			}
 		}
 		_jumpToWidget->setCurrentLetter(_model->currentLetter(iTop));
+
+		// Covers are decoded in background: prepare those which are about to be displayed
+		QModelIndex iBottom = indexAt(viewport()->rect().bottomLeft());
+		this->prefetchCovers(iTop.row(), iBottom.isValid() ? iBottom.row() : _model->proxy()->rowCount() - 1, 40);
 	});
 	horizontalHeader()->resizeSection(0, Settings::instance()->coverSizeUniqueLibrary());
 
@@ -178,7 +184,7 @@ QList<QUrl> TableView::selectedTracks()
 			}
 		}
 	}
-	SqlDatabase db;
+	SqlDatabase &db = *SqlDatabase::reader();
 	QSqlQuery q(db);
 	if (q.exec("SELECT uri FROM cache WHERE artistNormalized IN (" + artists.join(",") + ")")) {
 		while (q.next()) {
@@ -243,6 +249,7 @@ void TableView::mousePressEvent(QMouseEvent *event)
 
 void TableView::paintEvent(QPaintEvent *event)
 {
+	SettingsSnapshot::FrameCounter frameCounter(Q_FUNC_INFO);
 	int wVerticalScrollBar = 0;
 	if (verticalScrollBar()->isVisible()) {
 		wVerticalScrollBar = verticalScrollBar()->width();
@@ -262,11 +269,38 @@ void TableView::paintEvent(QPaintEvent *event)
 	}
 }
 
+/** Decodes covers of albums which are just above or below the viewport. */
+void TableView::prefetchCovers(int firstRow, int lastRow, int rows)
+{
+	if (firstRow < 0) {
+		return;
+	}
+	int coverSize = SettingsPrivate::instance()->snapshot()->coverSizeUniqueLibrary;
+	CoverCache *coverCache = CoverCache::instance();
+	auto prefetch = [=](int row) {
+		QModelIndex index = _model->proxy()->index(row, 0);
+		QString coverPath = index.data(Miam::DF_InternalCover).toString();
+		if (coverPath.isEmpty()) {
+			coverPath = index.data(Miam::DF_CoverPath).toString();
+		}
+		if (!coverPath.isEmpty()) {
+			coverCache->prefetch(coverPath, coverSize);
+		}
+	};
+	for (int row = qMax(0, firstRow - rows); row < firstRow; row++) {
+		prefetch(row);
+	}
+	int rowCount = _model->proxy()->rowCount();
+	for (int row = lastRow + 1; row < qMin(rowCount, lastRow + 1 + rows); row++) {
+		prefetch(row);
+	}
+}
+
 void TableView::jumpTo(const QString &letter)
 {
-	SqlDatabase db;
+	SqlDatabase &db = *SqlDatabase::reader();
 	QSqlQuery firstArtist(db);
-	firstArtist.prepare("SELECT DISTINCT artistAlbum FROM cache WHERE artistAlbum LIKE ? ORDER BY artistAlbum COLLATE NOCASE LIMIT ?");
+	firstArtist.prepare("SELECT name FROM artists WHERE name LIKE ? ORDER BY name COLLATE NOCASE LIMIT ?");
 	firstArtist.addBindValue(letter + "%");
 	firstArtist.addBindValue(_skipCount);
 	if (firstArtist.exec() && firstArtist.last()) {
@@ -62,6 +62,10 @@ protected:
 
 	virtual void paintEvent(QPaintEvent *event) override;
 
+private:
+	/** Decodes covers of albums which are just above or below the viewport. */
+	void prefetchCovers(int firstRow, int lastRow, int rows);
+
 public slots:
 	void jumpTo(const QString &letter);
 
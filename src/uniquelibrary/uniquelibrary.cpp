@@ -56,15 +56,16 @@ UniqueLibrary::UniqueLibrary(MediaPlayer *mediaPlayer, QWidget *parent)
 	connect(uniqueTable, &TableView::sendToTagEditor, this, &UniqueLibrary::aboutToSendToTagEditor);
 	_proxy = uniqueTable->model()->proxy();
 
+	// Every item is deleted when rows read in background replace current ones
+	connect(uniqueTable->model(), &QAbstractItemModel::modelAboutToBeReset, this, [=]() {
+		_currentTrack = nullptr;
+		_randomHistoryList->clear();
+	});
+
 	// Filter the library when user is typing some text to find artist, album or tracks
 	connect(searchBar, &SearchBar::aboutToStartSearch, this, [=](const QString &text) {
 		//uniqueTable->model()->proxy()->findMusic(text);
-		if (_currentTrack) {
-			delete _currentTrack;
-			_currentTrack = nullptr;
-		}
 		uniqueTable->model()->load(text);
-		uniqueTable->adjust();
 
 		uniqueTable->scrollToTop();
 		uniqueTable->verticalScrollBar()->setValue(0);
@@ -144,23 +145,26 @@ UniqueLibrary::~UniqueLibrary()
 
 void UniqueLibrary::loadModel()
 {
-	uniqueTable->model()->load();
-	uniqueTable->adjust();
-
-	auto settingsPrivate = SettingsPrivate::instance();
-	if (!settingsPrivate->value("uniqueLibraryLastPlayed").isNull()) {
-		int track = settingsPrivate->value("uniqueLibraryLastPlayed").toInt();
-		QModelIndex lastPlayed = uniqueTable->model()->index(track, 1);
-		if (lastPlayed.isValid()) {
-			QModelIndex p = uniqueTable->model()->proxy()->mapFromSource(lastPlayed);
-			QStandardItem *trackItem = uniqueTable->model()->itemFromIndex(lastPlayed);
-			if (p.isValid() && trackItem != nullptr) {
-				_currentTrack = trackItem;
-				uniqueTable->setCurrentIndex(p);
-				uniqueTable->scrollTo(p, QAbstractItemView::PositionAtCenter);
+	// Tracks are read in background, the last played one is selected once they're displayed
+	auto connection = QSharedPointer<QMetaObject::Connection>::create();
+	*connection = connect(uniqueTable->model(), &MiamItemModel::loaded, this, [=]() {
+		QObject::disconnect(*connection);
+		auto settingsPrivate = SettingsPrivate::instance();
+		if (!settingsPrivate->value("uniqueLibraryLastPlayed").isNull()) {
+			int track = settingsPrivate->value("uniqueLibraryLastPlayed").toInt();
+			QModelIndex lastPlayed = uniqueTable->model()->index(track, 1);
+			if (lastPlayed.isValid()) {
+				QModelIndex p = uniqueTable->model()->proxy()->mapFromSource(lastPlayed);
+				QStandardItem *trackItem = uniqueTable->model()->itemFromIndex(lastPlayed);
+				if (p.isValid() && trackItem != nullptr) {
+					_currentTrack = trackItem;
+					uniqueTable->setCurrentIndex(p);
+					uniqueTable->scrollTo(p, QAbstractItemView::PositionAtCenter);
+				}
 			}
 		}
-	}
+	});
+	uniqueTable->model()->load();
 }
 
 bool UniqueLibrary::viewProperty(Settings::ViewProperty vp) const
@@ -259,6 +263,10 @@ void UniqueLibrary::setMusicSearchEngine(MusicSearchEngine *musicSearchEngine)
 			w->deleteLater();
 		}
 	});
+
+	connect(musicSearchEngine, &MusicSearchEngine::libraryChanged, this, [=]() {
+		uniqueTable->model()->load();
+	});
 }
 
 void UniqueLibrary::setViewProperty(Settings::ViewProperty vp, QVariant value)
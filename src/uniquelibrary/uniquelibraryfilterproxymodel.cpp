@@ -4,12 +4,58 @@
 #include <separatoritem.h>
 #include <model/sqldatabase.h>
 #include <QSqlQuery>
+#include <QThreadPool>
 
 #include <QtDebug>
 
+MatchingTracksTask::MatchingTracksTask(const QString &match, int generation, const QSharedPointer<QAtomicInt> &currentGeneration)
+	: QObject(nullptr)
+	, _match(match)
+	, _generation(generation)
+	, _currentGeneration(currentGeneration)
+{
+	setAutoDelete(false);
+}
+
+void MatchingTracksTask::run()
+{
+	// A connection can only be used by the thread which has opened it
+	SqlDatabase &db = *SqlDatabase::reader();
+	QSqlQuery query(db);
+	query.setForwardOnly(true);
+	query.prepare("SELECT DISTINCT IFNULL(artistNormalized, ''), albumYear, IFNULL(albumNormalized, ''), disc FROM cache " \
+				  "WHERE rowid IN (SELECT docid FROM cacheSearch WHERE trackTitle MATCH ?)");
+	query.addBindValue(_match);
+
+	// Same keys as the ones built by UniqueLibraryItemModel: artist, artist|year|album and artist|year|album|disc
+	QSet<QString> keys;
+	int rows = 0;
+	bool isCanceled = false;
+	if (query.exec()) {
+		while (query.next()) {
+			if (++rows % 256 == 0 && _currentGeneration->load() != _generation) {
+				isCanceled = true;
+				break;
+			}
+			QString artist = query.value(0).toString();
+			QString album = artist + "|" + query.value(1).toString() + "|" + query.value(2).toString();
+			keys << artist << album;
+			int disc = query.value(3).toInt();
+			if (disc > 0) {
+				keys << album + "|" + ("0" + QString::number(disc)).right(1);
+			}
+		}
+	}
+	if (!isCanceled) {
+		emit matchesFound(_generation, keys.toList());
+	}
+	this->deleteLater();
+}
+
 UniqueLibraryFilterProxyModel::UniqueLibraryFilterProxyModel(QObject *parent)
 	: MiamSortFilterProxyModel(parent)
 	, _model(nullptr)
+	, _filterGeneration(new QAtomicInt(0))
 {}
 
 /** Redefined from QSortFilterProxyModel. */
@@ -29,40 +75,16 @@ bool UniqueLibraryFilterProxyModel::filterAcceptsRow(int sourceRow, const QModel
 	bool result = false;
 	switch (item->type()) {
 	case Miam::IT_Artist:
-		if (MiamSortFilterProxyModel::filterAcceptsRow(sourceRow, sourceParent)) {
-			result = true;
-		} else {
-			SqlDatabase db;
-			QSqlQuery getArtist(db);
-			getArtist.setForwardOnly(true);
-			getArtist.prepare("SELECT * FROM cache WHERE trackTitle LIKE ?");
-			getArtist.addBindValue("%" + filterRegExp().pattern() + "%");
-			result = getArtist.exec() && getArtist.next();
-		}
+		result = MiamSortFilterProxyModel::filterAcceptsRow(sourceRow, sourceParent) ||
+				_matchingKeys.contains(item->data(Miam::DF_NormalizedString).toString());
 		break;
 	case Miam::IT_Album:
-		if (item->text().contains(filterRegExp().pattern(), Qt::CaseInsensitive)) {
-			result = true;
-		} else {
-			SqlDatabase db;
-			QSqlQuery getAlbum(db);
-			getAlbum.setForwardOnly(true);
-			getAlbum.prepare("SELECT * FROM cache WHERE trackTitle LIKE ?");
-			getAlbum.addBindValue("%" + filterRegExp().pattern() + "%");
-			result = getAlbum.exec() && getAlbum.next();
-		}
+		result = item->text().contains(filterRegExp().pattern(), Qt::CaseInsensitive) ||
+				_matchingKeys.contains(item->data(Miam::DF_NormalizedString).toString());
 		break;
 	case Miam::IT_Disc:
-		if (filterRegExp().indexIn(item->data(Miam::DF_Artist).toString()) != -1) {
-			result = true;
-		} else {
-			SqlDatabase db;
-			QSqlQuery getDiscAlbum(db);
-			getDiscAlbum.setForwardOnly(true);
-			getDiscAlbum.prepare("SELECT * FROM cache WHERE disc > 0 AND trackTitle LIKE ?");
-			getDiscAlbum.addBindValue("%" + filterRegExp().pattern() + "%");
-			result = getDiscAlbum.exec() && getDiscAlbum.next();
-		}
+		result = filterRegExp().indexIn(item->data(Miam::DF_Artist).toString()) != -1 ||
+				_matchingKeys.contains(item->data(Miam::DF_NormalizedString).toString());
 		break;
 	case Miam::IT_Track:
 		/*if (MiamSortFilterProxyModel::filterAcceptsRow(sourceRow, sourceParent)) {
@@ -85,3 +107,29 @@ bool UniqueLibraryFilterProxyModel::filterAcceptsRow(int sourceRow, const QModel
 	}
 	return result;
 }
+
+/** Redefined from MiamSortFilterProxyModel to search matching tracks in background. */
+void UniqueLibraryFilterProxyModel::filterLibrary(const QString &filter)
+{
+	int generation = _filterGeneration->fetchAndAddOrdered(1) + 1;
+	_matchingKeys.clear();
+	MiamSortFilterProxyModel::filterLibrary(filter);
+
+	QString match = SqlDatabase::matchExpression(filter);
+	if (match.isEmpty()) {
+		return;
+	}
+	MatchingTracksTask *task = new MatchingTracksTask(match, generation, _filterGeneration);
+	connect(task, &MatchingTracksTask::matchesFound, this, &UniqueLibraryFilterProxyModel::setMatchingKeys, Qt::QueuedConnection);
+	QThreadPool::globalInstance()->start(task);
+}
+
+void UniqueLibraryFilterProxyModel::setMatchingKeys(int generation, const QStringList &keys)
+{
+	// User has typed something else in the meantime
+	if (generation != _filterGeneration->load()) {
+		return;
+	}
+	_matchingKeys = keys.toSet();
+	this->invalidateFilter();
+}
@@ -4,8 +4,35 @@
 #include "miamsortfilterproxymodel.h"
 #include "miamuniquelibrary_global.hpp"
 
+#include <QAtomicInt>
+#include <QRunnable>
+#include <QSet>
+#include <QSharedPointer>
 #include <QStandardItemModel>
 
+/**
+ * \brief		The MatchingTracksTask class searches tracks matching a filter, then returns keys of their artists, albums and discs.
+ * \details		It runs in a thread of the global pool, and stops early if another filter was typed in the meantime.
+ * \author      Matthieu Bachelier
+ * \copyright   GNU General Public License v3
+ */
+class MatchingTracksTask : public QObject, public QRunnable
+{
+	Q_OBJECT
+private:
+	QString _match;
+	int _generation;
+	QSharedPointer<QAtomicInt> _currentGeneration;
+
+public:
+	MatchingTracksTask(const QString &match, int generation, const QSharedPointer<QAtomicInt> &currentGeneration);
+
+	virtual void run() override;
+
+signals:
+	void matchesFound(int generation, const QStringList &keys);
+};
+
 /**
  * \brief		The UniqueLibraryFilterProxyModel class
  * \details
@@ -18,6 +45,12 @@ class MIAMUNIQUELIBRARY_LIBRARY UniqueLibraryFilterProxyModel : public MiamSortF
 private:
 	QStandardItemModel *_model;
 
+	/** Keys of artists, albums and discs which have at least one track matching the filter. */
+	QSet<QString> _matchingKeys;
+
+	/** Incremented for each new filter, results of previous searches are discarded. Shared with running tasks. */
+	QSharedPointer<QAtomicInt> _filterGeneration;
+
 public:
 	UniqueLibraryFilterProxyModel(QObject *parent = nullptr);
 
@@ -29,6 +62,12 @@ public:
 protected:
 	/** Redefined from MiamSortFilterProxyModel. */
 	virtual bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+
+	/** Redefined from MiamSortFilterProxyModel to search matching tracks in background. */
+	virtual void filterLibrary(const QString &filter) override;
+
+private slots:
+	void setMatchingKeys(int generation, const QStringList &keys);
 };
 
 #endif // UNIQUELIBRARYFILTERPROXYMODEL_H
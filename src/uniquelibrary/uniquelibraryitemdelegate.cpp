@@ -1,25 +1,32 @@
 #include "uniquelibraryitemdelegate.h"
 
-#include <settings.h>
-#include <settingsprivate.h>
+#include <covercache.h>
+#include <settingssnapshot.h>
 #include <discitem.h>
 #include <QApplication>
 #include <QDateTime>
-#include <QImageReader>
 #include <QPainter>
 #include <QStandardItem>
 
-#include <memory>
-#include <cover.h>
-#include <QDir>
-
 #include <QtDebug>
 
 UniqueLibraryItemDelegate::UniqueLibraryItemDelegate(TableView *tableView)
 	: MiamItemDelegate(tableView->model()->proxy())
 	, _tableView(tableView)
 	, _jumpTo(tableView->jumpToWidget())
-{}
+{
+	// Covers can be taller than their row: repaint the whole area below the top left corner
+	connect(CoverCache::instance(), &CoverCache::coverLoaded, this, [=](const QString &coverPath) {
+		int coverSize = SettingsPrivate::instance()->snapshot()->coverSizeUniqueLibrary;
+		for (const QPersistentModelIndex &index : _pendingCovers.values(coverPath)) {
+			if (index.isValid()) {
+				QRect r = _tableView->visualRect(index);
+				_tableView->viewport()->update(QRect(r.topLeft(), QSize(coverSize, coverSize)));
+			}
+		}
+		_pendingCovers.remove(coverPath);
+	});
+}
 
 #include <QHeaderView>
 
@@ -30,14 +37,15 @@ void UniqueLibraryItemDelegate::paint(QPainter *painter, const QStyleOptionViewI
 	if (index.column() == 0) {
 		QString internalCover = index.data(Miam::DF_InternalCover).toString();
 		QString cover = index.data(Miam::DF_CoverPath).toString();
-		if (!internalCover.isEmpty()) {
-			this->drawCover(painter, option, internalCover);
+		// A picture which couldn't be extracted won't be read again: the one next to tracks is drawn instead, if any
+		if (!internalCover.isEmpty() && !(CoverCache::instance()->hasFailed(internalCover) && !cover.isEmpty())) {
+			this->drawCover(painter, option, index, internalCover);
 		} else if (!cover.isEmpty()) {
-			this->drawCover(painter, option, cover);
+			this->drawCover(painter, option, index, cover);
 		}
 		return;
 	}
-	painter->setFont(SettingsPrivate::instance()->font(SettingsPrivate::FF_Library));
+	painter->setFont(SettingsPrivate::instance()->snapshot()->libraryFont);
 	QStandardItem *item = _libraryModel->itemFromIndex(_proxy->mapToSource(index));
 	QStyleOptionViewItem o = option;
 	initStyleOption(&o, index);
@@ -124,28 +132,24 @@ void UniqueLibraryItemDelegate::drawArtist(QPainter *painter, QStyleOptionViewIt
 	painter->drawLine(option.rect.x() + textWidth + 5, c.y(), option.rect.right() - 5, c.y());
 }
 
-void UniqueLibraryItemDelegate::drawCover(QPainter *painter, const QStyleOptionViewItem &option, const QString &coverPath) const
+void UniqueLibraryItemDelegate::drawCover(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index, const QString &coverPath) const
 {
-	static QImageReader imageReader;
-	int coverSize = Settings::instance()->coverSizeUniqueLibrary();
-
+	int coverSize = SettingsPrivate::instance()->snapshot()->coverSizeUniqueLibrary;
 	QRect r(option.rect.x(), option.rect.y(), coverSize, coverSize);
 
-	FileHelper fh(coverPath);
-	// If it's an inner cover, load it
-	if (FileHelper::suffixes().contains(fh.fileInfo().suffix())) {
-		std::unique_ptr<Cover> cover(fh.extractCover());
-		if (cover) {
-			QPixmap p;
-			if (p.loadFromData(cover->byteArray(), cover->format()) && !p.isNull()) {
-				painter->drawPixmap(r, p);
-			}
+	// Thumbnails are decoded in background, a placeholder is drawn meanwhile
+	QPixmap pixmap = CoverCache::instance()->cover(coverPath, coverSize);
+	if (pixmap.isNull()) {
+		if (!_pendingCovers.contains(coverPath, index)) {
+			_pendingCovers.insert(coverPath, index);
 		}
+		painter->save();
+		painter->setOpacity(0.25);
+		painter->drawPixmap(r, QPixmap(":/icons/disc"));
+		painter->restore();
 	} else {
-		imageReader.setFileName(QDir::fromNativeSeparators(coverPath));
-		imageReader.setScaledSize(QSize(coverSize, coverSize));
+		painter->drawPixmap(r, pixmap);
 	}
-	painter->drawImage(r, imageReader.read());
 }
 
 void UniqueLibraryItemDelegate::drawDisc(QPainter *painter, QStyleOptionViewItem &option, QStandardItem *item) const
@@ -172,7 +176,7 @@ void UniqueLibraryItemDelegate::drawTrack(QPainter *p, QStyleOptionViewItem &opt
 	option.textElideMode = Qt::ElideRight;
 	QString trackLength = QDateTime::fromTime_t(track->data(Miam::DF_TrackLength).toUInt()).toString("m:ss");
 
-	QFont f = SettingsPrivate::instance()->font(SettingsPrivate::FF_Library);
+	QFont f = SettingsPrivate::instance()->snapshot()->libraryFont;
 	// Current track is being played
 	if (track->data(Miam::DF_Highlighted).toBool()) {
 		uint currentPos = track->data(Miam::DF_CurrentPosition).toUInt();
@@ -225,7 +229,7 @@ QPalette::ColorRole UniqueLibraryItemDelegate::getColorRole(QStyleOptionViewItem
 	QPalette::ColorRole cr;
 	if (option.state.testFlag(QStyle::State_Selected)) {
 		if (qAbs(option.palette.highlight().color().lighter(lighterValue).value() - option.palette.highlightedText().color().value()) < 128) {
-			if (SettingsPrivate::instance()->isCustomTextColorOverriden()) {
+			if (SettingsPrivate::instance()->snapshot()->isCustomTextColorOverriden) {
 				cr = QPalette::HighlightedText;
 			} else {
 				cr = QPalette::Text;
@@ -21,6 +21,9 @@ private:
 	TableView *_tableView;
 	JumpToWidget *_jumpTo;
 
+	/** Albums which are displayed with a placeholder until their cover is decoded. */
+	mutable QMultiHash<QString, QPersistentModelIndex> _pendingCovers;
+
 public:
 	explicit UniqueLibraryItemDelegate(TableView *tableView);
 
@@ -32,7 +35,7 @@ protected:
 
 	virtual void drawArtist(QPainter *painter, QStyleOptionViewItem &option, QStandardItem *item) const override;
 
-	void drawCover(QPainter *painter, const QStyleOptionViewItem &option, const QString &coverPath) const;
+	void drawCover(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index, const QString &coverPath) const;
 
 	virtual void drawDisc(QPainter *painter, QStyleOptionViewItem &option, QStandardItem *item) const override;
 
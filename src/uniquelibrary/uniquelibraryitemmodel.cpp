@@ -1,10 +1,6 @@
 #include "uniquelibraryitemmodel.h"
 
 #include <model/sqldatabase.h>
-#include <albumitem.h>
-#include <artistitem.h>
-#include <discitem.h>
-#include <trackitem.h>
 #include "coveritem.h"
 
 #include <QSqlQuery>
@@ -18,6 +14,10 @@ UniqueLibraryItemModel::UniqueLibraryItemModel(QObject *parent)
 {
 	setColumnCount(2);
 	_proxy->setSourceModel(this);
+	connect(this, &MiamItemModel::loaded, this, [=]() {
+		_proxy->sort(_proxy->defaultSortColumn());
+		_proxy->setDynamicSortFilter(false);
+	});
 	this->load();
 }
 
@@ -43,65 +43,82 @@ UniqueLibraryFilterProxyModel *UniqueLibraryItemModel::proxy() const
 	return _proxy;
 }
 
-void UniqueLibraryItemModel::load(const QString &filter)
+namespace {
+
+/** Builds every row of the table in a worker thread: artists, albums with their covers, discs and tracks. */
+void readRows(const QString &filter, QList<QList<QStandardItem*>> &rows)
 {
-	this->deleteCache();
+	SqlDatabase &db = *SqlDatabase::reader();
 
-	SqlDatabase db;
+	// Artists and albums are read from their own table, only tracks need a full scan of table "cache"
+	// Titles, artists and albums are searched in the full-text index
+	QString match = SqlDatabase::matchExpression(filter);
+	QString tracksFilter = "rowid IN (SELECT docid FROM cacheSearch WHERE cacheSearch MATCH :match)";
+	auto bindFilter = [&match](QSqlQuery &query) {
+		if (!match.isEmpty()) {
+			query.bindValue(":match", match);
+		}
+	};
 
 	QSqlQuery query(db);
 	query.setForwardOnly(true);
-	if (filter.isEmpty()) {
-		query.prepare("SELECT DISTINCT artistAlbum, artistNormalized, icon, host FROM cache");
+	if (match.isEmpty()) {
+		query.prepare("SELECT name, normalizedName, icon, host FROM artists");
 	} else {
-		query.prepare("SELECT DISTINCT artistAlbum, artistNormalized, icon, host FROM cache " \
-					  "WHERE trackTitle LIKE :t OR artist LIKE :ar OR album LIKE :al");
-		query.bindValue(":t", "%" + filter + "%");
-		query.bindValue(":ar", "%" + filter + "%");
-		query.bindValue(":al", "%" + filter + "%");
+		query.prepare("SELECT name, normalizedName, icon, host FROM artists WHERE id IN (SELECT artistId FROM cache WHERE " + tracksFilter + ")");
 	}
+	bindFilter(query);
 	if (query.exec()) {
 		while (query.next()) {
-			ArtistItem *artist = new ArtistItem;
+			ItemNode artist(Miam::IT_Artist);
 			int i = -1;
-			artist->setText(query.record().value(++i).toString());
-			artist->setData(query.record().value(++i).toString(), Miam::DF_NormalizedString);
-			artist->setData(query.record().value(++i).toString(), Miam::DF_IconPath);
-			artist->setData(!query.record().value(++i).toString().isEmpty(), Miam::DF_IsRemote);
-			appendRow({ nullptr, artist });
+			artist.text = query.value(++i).toString();
+			artist.setData(query.value(++i).toString(), Miam::DF_NormalizedString);
+			artist.setData(query.value(++i).toString(), Miam::DF_IconPath);
+			artist.setData(!query.value(++i).toString().isEmpty(), Miam::DF_IsRemote);
+			rows.append({ nullptr, MiamItemModel::createItem(artist) });
 		}
 	}
 
-	if (filter.isEmpty()) {
-		query.prepare("SELECT DISTINCT artistNormalized || '|' || albumYear  || '|' || albumNormalized, albumNormalized, album, artistAlbum, " \
-					  "albumYear, icon, internalCover, cover FROM cache ORDER BY uri, internalCover");
+	// Sort keys of albums are reused to build keys of their discs and tracks
+	QHash<int, QString> albumKeys;
+	QString selectAlbums = "SELECT al.id, ar.normalizedName, al.normalizedName, al.name, ar.name, al.year, al.icon, " \
+						   "(SELECT internalCover FROM cache WHERE albumId = al.id AND internalCover IS NOT NULL LIMIT 1), " \
+						   "(SELECT cover FROM cache WHERE albumId = al.id AND cover IS NOT NULL LIMIT 1) " \
+						   "FROM albums al INNER JOIN artists ar ON al.artistId = ar.id";
+	if (match.isEmpty()) {
+		query.prepare(selectAlbums);
 	} else {
-		query.prepare("SELECT DISTINCT artistNormalized || '|' || albumYear  || '|' || albumNormalized, albumNormalized, album, artistAlbum, " \
-					  "albumYear, icon, internalCover, cover FROM cache WHERE trackTitle LIKE :t OR artist LIKE :ar OR album LIKE :al ORDER BY uri, internalCover");
-		query.bindValue(":t", "%" + filter + "%");
-		query.bindValue(":ar", "%" + filter + "%");
-		query.bindValue(":al", "%" + filter + "%");
+		query.prepare(selectAlbums + " WHERE al.id IN (SELECT albumId FROM cache WHERE " + tracksFilter + ")");
 	}
+	bindFilter(query);
 	if (query.exec()) {
-		QString normalizedStringPrevious;
 		while (query.next()) {
+			QSqlRecord r = query.record();
 			int i = -1;
-			QString normalizedString = query.record().value(++i).toString();
-			if (normalizedStringPrevious == normalizedString) {
-				continue;
-			} else {
-				normalizedStringPrevious = normalizedString;
-			}
-			AlbumItem *album = new AlbumItem;
-			album->setData(normalizedString, Miam::DF_NormalizedString);
-			album->setData(query.record().value(++i).toString(), Miam::DF_NormAlbum);
-			album->setText(query.record().value(++i).toString());
-			album->setData(query.record().value(++i).toString(), Miam::DF_Artist);
-			album->setData(query.record().value(++i).toString(), Miam::DF_Year);
-			album->setData(query.record().value(++i).toString(), Miam::DF_IconPath);
-			QString internalCover = query.record().value(++i).toString();
-			QString coverPath = query.record().value(++i).toString();
+			int albumId = r.value(++i).toInt();
+			QString artistNormalized = r.value(++i).toString();
+			QString albumNormalized = r.value(++i).toString();
+			QString album = r.value(++i).toString();
+			QString artist = r.value(++i).toString();
+			QString year = r.value(++i).toString();
+			QString normalizedString = artistNormalized + "|" + year + "|" + albumNormalized;
+			albumKeys.insert(albumId, normalizedString);
+
+			ItemNode albumNode(Miam::IT_Album);
+			albumNode.setData(normalizedString, Miam::DF_NormalizedString);
+			albumNode.setData(albumNormalized, Miam::DF_NormAlbum);
+			albumNode.text = album;
+			albumNode.setData(artist, Miam::DF_Artist);
+			albumNode.setData(year, Miam::DF_Year);
+			albumNode.setData(r.value(++i).toString(), Miam::DF_IconPath);
+			albumNode.setData(r.value(++i).toString(), Miam::DF_InternalCover);
+			albumNode.setData(r.value(++i).toString(), Miam::DF_CoverPath);
+
+			// Covers are displayed in the first column, by an item created with the album
 			CoverItem *cover = nullptr;
+			QString internalCover = albumNode.data(Miam::DF_InternalCover).toString();
+			QString coverPath = albumNode.data(Miam::DF_CoverPath).toString();
 			if (!internalCover.isEmpty() || !coverPath.isEmpty()) {
 				cover = new CoverItem;
 				if (internalCover.isEmpty()) {
@@ -110,59 +127,80 @@ void UniqueLibraryItemModel::load(const QString &filter)
 					cover->setData(internalCover, Miam::DF_InternalCover);
 				}
 			}
-			appendRow({ cover, album });
+			rows.append({ cover, MiamItemModel::createItem(albumNode) });
 		}
 	}
 
-	if (filter.isEmpty()) {
-		query.prepare("SELECT DISTINCT artistNormalized || '|' || albumYear  || '|' || albumNormalized || '|' || substr('0' || disc, -1, 1)" \
-					  ", artistAlbum, disc FROM cache WHERE disc > 0");
+	// Same as substr('0' || disc, -1, 1) and substr('00' || trackNumber, -2, 2)
+	auto discKey = [](const QString &disc) -> QString { return ("0" + disc).right(1); };
+	auto trackKey = [](const QString &trackNumber) -> QString { return ("00" + trackNumber).right(2); };
+
+	if (match.isEmpty()) {
+		query.prepare("SELECT DISTINCT albumId, disc, artistAlbum FROM cache WHERE disc > 0");
 	} else {
-		query.prepare("SELECT DISTINCT artistNormalized || '|' || albumYear  || '|' || albumNormalized || '|' || substr('0' || disc, -1, 1)" \
-					  ", artistAlbum, disc FROM cache WHERE (disc > 0) AND (trackTitle LIKE :t OR artist LIKE :ar OR album LIKE :al)");
-		query.bindValue(":t", "%" + filter + "%");
-		query.bindValue(":ar", "%" + filter + "%");
-		query.bindValue(":al", "%" + filter + "%");
+		query.prepare("SELECT DISTINCT albumId, disc, artistAlbum FROM cache WHERE (disc > 0) AND " + tracksFilter);
 	}
+	bindFilter(query);
 	if (query.exec()) {
 		while (query.next()) {
-			DiscItem *disc = new DiscItem;
+			ItemNode disc(Miam::IT_Disc);
 			int i = -1;
-			disc->setData(query.record().value(++i).toString(), Miam::DF_NormalizedString);
-			disc->setData(query.record().value(++i).toString(), Miam::DF_Artist);
-			disc->setText(query.record().value(++i).toString());
-			appendRow({ nullptr, disc });
+			QString albumKey = albumKeys.value(query.value(++i).toInt());
+			QString discNumber = query.value(++i).toString();
+			disc.setData(albumKey + "|" + discKey(discNumber), Miam::DF_NormalizedString);
+			disc.setData(query.value(++i).toString(), Miam::DF_Artist);
+			disc.text = discNumber;
+			rows.append({ nullptr, MiamItemModel::createItem(disc) });
 		}
 	}
 
-	if (filter.isEmpty()) {
-		query.prepare("SELECT artistNormalized || '|' || albumYear  || '|' || albumNormalized || '|' || substr('0' || disc, -1, 1) || '|' || substr('00' || trackNumber, -2, 2)  || '|' || trackTitle, " \
-					  "trackTitle, uri, trackNumber, artistAlbum, album, trackLength, rating, disc, host FROM cache");
+	QString selectTracks = "SELECT albumId, disc, trackNumber, trackTitle, uri, artistAlbum, album, trackLength, rating, host FROM cache";
+	if (match.isEmpty()) {
+		query.prepare(selectTracks);
 	} else {
-		query.prepare("SELECT artistNormalized || '|' || albumYear  || '|' || albumNormalized || '|' || substr('0' || disc, -1, 1) || '|' || substr('00' || trackNumber, -2, 2)  || '|' || trackTitle, " \
-					  "trackTitle, uri, trackNumber, artistAlbum, album, trackLength, rating, disc, host FROM cache WHERE trackTitle LIKE :t OR artist LIKE :ar OR album LIKE :al");
-		query.bindValue(":t", "%" + filter + "%");
-		query.bindValue(":ar", "%" + filter + "%");
-		query.bindValue(":al", "%" + filter + "%");
+		query.prepare(selectTracks + " WHERE " + tracksFilter);
 	}
+	bindFilter(query);
 	if (query.exec()) {
 		while (query.next()) {
-			TrackItem *track = new TrackItem;
+			QSqlRecord r = query.record();
+			ItemNode track(Miam::IT_Track);
 			int i = -1;
-			track->setData(query.record().value(++i).toString(), Miam::DF_NormalizedString);
-			track->setText(query.record().value(++i).toString());
-			track->setData(query.record().value(++i).toString(), Miam::DF_URI);
-			track->setData(query.record().value(++i).toString(), Miam::DF_TrackNumber);
-			track->setData(query.record().value(++i).toString(), Miam::DF_Artist);
-			track->setData(query.record().value(++i).toString(), Miam::DF_Album);
-			track->setData(query.record().value(++i).toUInt(), Miam::DF_TrackLength);
-			track->setData(query.record().value(++i).toInt(), Miam::DF_Rating);
-			track->setData(query.record().value(++i).toString(), Miam::DF_DiscNumber);
-			track->setData(!query.record().value(++i).toString().isEmpty(), Miam::DF_IsRemote);
-			appendRow({ nullptr, track });
+			QString albumKey = albumKeys.value(r.value(++i).toInt());
+			QString discNumber = r.value(++i).toString();
+			QString trackNumber = r.value(++i).toString();
+			QString title = r.value(++i).toString();
+			track.setData(albumKey + "|" + discKey(discNumber) + "|" + trackKey(trackNumber) + "|" + title, Miam::DF_NormalizedString);
+			track.text = title;
+			track.setData(r.value(++i).toString(), Miam::DF_URI);
+			track.setData(trackNumber, Miam::DF_TrackNumber);
+			track.setData(r.value(++i).toString(), Miam::DF_Artist);
+			track.setData(r.value(++i).toString(), Miam::DF_Album);
+			track.setData(r.value(++i).toUInt(), Miam::DF_TrackLength);
+			track.setData(r.value(++i).toInt(), Miam::DF_Rating);
+			track.setData(discNumber, Miam::DF_DiscNumber);
+			track.setData(!r.value(++i).toString().isEmpty(), Miam::DF_IsRemote);
+			rows.append({ nullptr, MiamItemModel::createItem(track) });
 		}
+	}
+}
+
+}
+
+/** Builds rows matching the filter in background, current rows are displayed until new ones are ready. */
+void UniqueLibraryItemModel::load(const QString &filter)
+{
+	this->readItemRows([filter](QList<QList<QStandardItem*>> &rows) {
+		readRows(filter, rows);
+	});
+}
+
+/** Replaces every row by rows built in background. */
+void UniqueLibraryItemModel::insertItemRows(const QList<QList<QStandardItem*>> &rows)
+{
+	this->deleteCache();
 
+	for (const QList<QStandardItem*> &row : rows) {
+		appendRow(row);
 	}
-	this->proxy()->sort(this->proxy()->defaultSortColumn());
-	this->proxy()->setDynamicSortFilter(false);
 }
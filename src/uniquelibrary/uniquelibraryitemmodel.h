@@ -26,7 +26,12 @@ public:
 
 	virtual UniqueLibraryFilterProxyModel* proxy() const override;
 
+protected:
+	/** Replaces every row by rows built in background. */
+	virtual void insertItemRows(const QList<QList<QStandardItem*>> &rows) override;
+
 public slots:
+	/** Builds rows matching the filter in background, current rows are displayed until new ones are ready. */
 	virtual void load(const QString & filter = QString::null) override;
 };
 